@@ -0,0 +1,93 @@
+#include "AhoCorasick.h"
+
+namespace {
+
+const uint32_t kNone = UINT32_MAX;
+
+} // namespace
+
+void AhoCorasick::Build(const std::vector<std::vector<uint8_t>>& patterns, const uint8_t* fold)
+{
+    auto folded = [&](uint8_t b) { return fold ? fold[b] : b; };
+
+    // One class per distinct (folded) pattern byte; every raw byte folding to it shares it
+    uint16_t classOfFolded[256] = {};
+    m_classCount = 1;
+    for (const auto& pattern : patterns) {
+        for (uint8_t b : pattern) {
+            if (classOfFolded[folded(b)] == 0) classOfFolded[folded(b)] = (uint16_t)m_classCount++;
+        }
+    }
+    for (int b = 0; b < 256; ++b) m_classOf[b] = classOfFolded[folded((uint8_t)b)];
+
+    // Trie
+    m_next.assign(m_classCount, kNone);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        if (patterns[p].empty()) continue;
+        uint32_t s = 0;
+        for (uint8_t b : patterns[p]) {
+            uint32_t& next = m_next[(size_t)s * m_classCount + m_classOf[b]];
+            if (next == kNone) {
+                next = (uint32_t)outputs.size();
+                outputs.emplace_back();
+                m_next.resize(m_next.size() + m_classCount, kNone);
+            }
+            s = m_next[(size_t)s * m_classCount + m_classOf[b]];
+        }
+        outputs[s].push_back((uint32_t)p);
+    }
+    const size_t states = outputs.size();
+
+    // Failure links in breadth-first order, completing the table into a DFA as they go:
+    // a missing transition is the one the failure state takes
+    std::vector<uint32_t> fail(states, 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(states);
+    for (size_t c = 0; c < m_classCount; ++c) {
+        uint32_t& next = m_next[c];
+        if (next == kNone) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t s = queue[head];
+        // Shallower states are done, so the failure state's outputs are complete
+        const auto& inherited = outputs[fail[s]];
+        outputs[s].insert(outputs[s].end(), inherited.begin(), inherited.end());
+        for (size_t c = 0; c < m_classCount; ++c) {
+            uint32_t& next = m_next[(size_t)s * m_classCount + c];
+            uint32_t viaFail = m_next[(size_t)fail[s] * m_classCount + c];
+            if (next == kNone) {
+                next = viaFail;
+            } else {
+                fail[next] = viaFail;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    m_outputStart.assign(1, 0);
+    m_outputs.clear();
+    for (const auto& list : outputs) {
+        m_outputs.insert(m_outputs.end(), list.begin(), list.end());
+        m_outputStart.push_back((uint32_t)m_outputs.size());
+    }
+
+    // Bytes that leave the root state
+    m_skipCount = 0;
+    for (int b = 0; b < 256; ++b) {
+        m_startByte[b] = m_classOf[b] != 0 && m_next[m_classOf[b]] != 0;
+        if (m_startByte[b]) {
+            if (m_skipCount < 3) m_skip[m_skipCount] = (uint8_t)b;
+            m_skipCount++;
+        }
+    }
+    if (m_skipCount > 3) {
+        m_skipCount = 0;
+    } else {
+        for (size_t i = m_skipCount; i < 3; ++i) m_skip[i] = m_skip[0];
+    }
+}
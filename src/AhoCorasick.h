@@ -0,0 +1,54 @@
+#pragma once
+
+#include "SimdScan.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Finds every occurrence of many byte strings in one pass over the text (Aho-Corasick).
+// Bytes are mapped to the classes the patterns use, so the transition table holds one row of
+// (distinct pattern bytes + 1) entries per state and the scan is one lookup per byte.
+// Outside any partial match the scan skips to the next byte that can begin a pattern: with at
+// most three such bytes through SimdScan::FindAny, otherwise through a table.
+class AhoCorasick {
+public:
+    // 'fold' maps every byte of the patterns and of the text before matching (nullptr: exact bytes).
+    // Empty patterns never match.
+    void Build(const std::vector<std::vector<uint8_t>>& patterns, const uint8_t* fold = nullptr);
+    size_t GetStateCount() const { return m_outputStart.empty() ? 0 : m_outputStart.size() - 1; }
+
+    // Feeds data[0, length) on from 'state' (0 at the start of a text) and calls
+    // onHit(end, pattern) for each occurrence, which ends just before data[end]. Occurrences
+    // that began in earlier calls are reported too: 'state' carries them over.
+    template <typename OnHit>
+    void Scan(const uint8_t* data, size_t length, uint32_t& state, OnHit&& onHit) const
+    {
+        if (m_outputStart.empty()) return;
+        uint32_t s = state;
+        size_t i = 0;
+        while (i < length) {
+            if (s == 0) {
+                if (m_skipCount > 0) {
+                    i += SimdScan::FindAny(data + i, length - i, m_skip[0], m_skip[1], m_skip[2]);
+                } else {
+                    while (i < length && !m_startByte[data[i]]) ++i;
+                }
+                if (i == length) break;
+            }
+            s = m_next[(size_t)s * m_classCount + m_classOf[data[i]]];
+            ++i;
+            for (uint32_t k = m_outputStart[s]; k < m_outputStart[s + 1]; ++k) onHit(i, m_outputs[k]);
+        }
+        state = s;
+    }
+
+private:
+    uint16_t m_classOf[256] = {}; // 0: a byte no pattern contains
+    size_t m_classCount = 1;
+    std::vector<uint32_t> m_next;        // [state * m_classCount + class]
+    std::vector<uint32_t> m_outputStart; // Patterns ending at state s: m_outputs[m_outputStart[s], m_outputStart[s + 1])
+    std::vector<uint32_t> m_outputs;
+    bool m_startByte[256] = {};
+    uint8_t m_skip[3] = {};
+    size_t m_skipCount = 0; // Distinct start bytes when there are at most three, else 0
+};
@@ -0,0 +1,75 @@
+#include "BufferedWriter.h"
+#include <cstring>
+
+BufferedWriter::BufferedWriter(size_t bufferSize)
+    : m_buffer(bufferSize ? bufferSize : 1)
+{
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    Close();
+}
+
+bool BufferedWriter::Open(const std::wstring& filePath)
+{
+    Close();
+    m_hFile = CreateFileW(
+        filePath.c_str(),
+        GENERIC_WRITE,
+        0, NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    m_used = 0;
+    m_failed = false;
+    return m_hFile != INVALID_HANDLE_VALUE;
+}
+
+bool BufferedWriter::Write(const uint8_t* data, uint64_t length)
+{
+    if (!IsOpen() || m_failed) return false;
+    if (length < m_buffer.size() - m_used) {
+        memcpy(m_buffer.data() + m_used, data, (size_t)length);
+        m_used += (size_t)length;
+        return true;
+    }
+    // Fill the buffer up and flush it; a remainder of a buffer or more is not copied at all
+    uint64_t fill = m_buffer.size() - m_used;
+    memcpy(m_buffer.data() + m_used, data, (size_t)fill);
+    m_used = 0;
+    if (!WriteThrough(m_buffer.data(), m_buffer.size())) return false;
+    data += fill;
+    length -= fill;
+    if (length >= m_buffer.size()) return WriteThrough(data, length);
+    memcpy(m_buffer.data(), data, (size_t)length);
+    m_used = (size_t)length;
+    return true;
+}
+
+bool BufferedWriter::Close()
+{
+    if (!IsOpen()) return !m_failed;
+    if (m_used > 0 && !m_failed) WriteThrough(m_buffer.data(), m_used);
+    m_used = 0;
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    return !m_failed;
+}
+
+bool BufferedWriter::WriteThrough(const uint8_t* data, uint64_t length)
+{
+    // WriteFile takes 32-bit lengths
+    while (length > 0) {
+        DWORD toWrite = (length > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD)length;
+        DWORD written = 0;
+        if (!WriteFile(m_hFile, data, toWrite, &written, NULL) || written == 0) {
+            m_failed = true;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Sequential file output through one fixed buffer: many small writes cost one WriteFile
+// per buffer, and writes at least a buffer long go straight to the file.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(size_t bufferSize = 1 << 20);
+    ~BufferedWriter(); // Closes the file (flushing) if still open
+
+    // Creates the file, replacing any existing one
+    bool Open(const std::wstring& filePath);
+    bool Write(const uint8_t* data, uint64_t length);
+    // Flushes and closes. False if any write failed.
+    bool Close();
+    bool IsOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+
+private:
+    bool WriteThrough(const uint8_t* data, uint64_t length);
+
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    std::vector<uint8_t> m_buffer;
+    size_t m_used = 0;
+    bool m_failed = false;
+};
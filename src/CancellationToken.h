@@ -0,0 +1,17 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Shared cancellation flag for long-running background work (loading, indexing).
+// Copies share the same flag, so the caller keeps one copy and hands another to the worker.
+class CancellationToken {
+public:
+    CancellationToken() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() { m_flag->store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return m_flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// Unicode simple case folding (CaseFolding.txt statuses C and S, Unicode 14) for case-insensitive
+// find and replace. Each UTF-16 code unit folds to one code unit, so folded text keeps the offsets
+// of the original and matches are found with the ordinary substring searches: the query is folded
+// once, cell text through a 64K-entry table built on first use, ASCII runs several units per SSE2 step.
+// Code points outside the BMP are left as they are.
+class CaseFold {
+public:
+    static wchar_t Fold(wchar_t ch);
+    static void FoldInPlace(wchar_t* text, size_t length);
+    static void FoldInPlace(std::wstring& text) { FoldInPlace(&text[0], text.size()); }
+    static std::wstring Folded(std::wstring_view text);
+
+    // Whether other characters fold to the same value as ch
+    static bool HasVariants(wchar_t ch);
+    // Whether ch and all of its case variants are ASCII ('k' is not: KELVIN SIGN folds to it)
+    static bool HasOnlyAsciiVariants(wchar_t ch);
+};
@@ -0,0 +1,163 @@
+#include "CsvDialect.h"
+#include "CsvDocument.h"
+#include "SimdScan.h"
+
+namespace {
+
+const uint16_t kQuote = L'\"';
+const uint16_t kNewline = L'\n';
+
+template <FileEncoding Enc>
+constexpr size_t UnitSize()
+{
+    return (Enc == FileEncoding::UTF16_LE || Enc == FileEncoding::UTF16_BE) ? 2 : 1;
+}
+
+template <FileEncoding Enc>
+inline uint16_t Read(const uint8_t* data, uint64_t pos)
+{
+    if constexpr (Enc == FileEncoding::UTF16_LE) return (uint16_t)(data[pos] | (data[pos + 1] << 8));
+    else if constexpr (Enc == FileEncoding::UTF16_BE) return (uint16_t)((data[pos] << 8) | data[pos + 1]);
+    else return data[pos];
+}
+
+// Offset of the first unit in [from, to) equal to a, b or c; 'to' or past it if none
+template <FileEncoding Enc>
+inline uint64_t FindNext(const uint8_t* data, uint64_t from, uint64_t to, uint16_t a, uint16_t b, uint16_t c)
+{
+    if (from >= to) return to;
+    if constexpr (UnitSize<Enc>() == 2) {
+        size_t units = (size_t)((to - from) / 2);
+        return from + 2 * SimdScan::FindAnyUtf16(data + from, units, Enc == FileEncoding::UTF16_BE, a, b, c);
+    } else {
+        // A needle that is not a single byte can never match; search for the quote in its place
+        auto narrow = [](uint16_t ch) { return (uint8_t)(ch <= 0xFF ? ch : kQuote); };
+        return from + SimdScan::FindAny(data + from, (size_t)(to - from), narrow(a), narrow(b), narrow(c));
+    }
+}
+
+template <FileEncoding Enc, uint16_t Delim>
+void IndexBlock(const uint8_t* data, uint64_t from, uint64_t to, uint64_t base, uint16_t runtimeDelimiter,
+                CsvScanState& state, std::vector<uint64_t>& rowStarts, std::vector<size_t>& rowFields)
+{
+    const uint16_t delimiter = Delim ? Delim : runtimeDelimiter;
+    constexpr uint64_t unit = UnitSize<Enc>();
+    bool inQuotes = state.inQuotes;
+    size_t fields = state.fields;
+    uint64_t i = from;
+    if constexpr (Enc == FileEncoding::ANSI) {
+        if (state.trailByte && i < to) {
+            i++;
+            state.trailByte = false;
+        }
+    }
+
+    for (; i + unit <= to; i += unit) {
+        if constexpr (Enc != FileEncoding::ANSI) {
+            // Inside quotes only the closing quote matters
+            i = inQuotes ? FindNext<Enc>(data, i, to, kQuote, kQuote, kQuote)
+                         : FindNext<Enc>(data, i, to, kQuote, delimiter, kNewline);
+            if (i + unit > to) break;
+        }
+        uint16_t ch = Read<Enc>(data, i);
+        if (ch == kQuote) {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && ch == delimiter) {
+            fields++;
+        } else if (!inQuotes && ch == kNewline) {
+            rowStarts.push_back(base + i + unit);
+            rowFields.push_back(fields);
+            fields = 1;
+        } else if constexpr (Enc == FileEncoding::ANSI) {
+            // Skipped like FieldEnd does, so the field counts agree with the parsed rows
+            if (IsDBCSLeadByte(data[i])) {
+                if (i + 1 < to) i++;
+                else state.trailByte = true;
+            }
+        }
+    }
+    state.inQuotes = inQuotes;
+    state.fields = fields;
+}
+
+template <FileEncoding Enc>
+void CollectRowStarts(const uint8_t* data, uint64_t from, uint64_t to, bool inQuotes, std::vector<uint64_t>& starts)
+{
+    constexpr uint64_t unit = UnitSize<Enc>();
+    for (uint64_t i = from; i + unit <= to; i += unit) {
+        if constexpr (Enc != FileEncoding::ANSI) {
+            i = inQuotes ? FindNext<Enc>(data, i, to, kQuote, kQuote, kQuote)
+                         : FindNext<Enc>(data, i, to, kQuote, kNewline, kNewline);
+            if (i + unit > to) break;
+        }
+        uint16_t ch = Read<Enc>(data, i);
+        if (ch == kQuote) {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes && ch == kNewline) {
+            starts.push_back(i + unit);
+        } else if constexpr (Enc == FileEncoding::ANSI) {
+            if (IsDBCSLeadByte(data[i]) && i + 1 < to) i++; // As in IndexBlock
+        }
+    }
+}
+
+template <FileEncoding Enc, uint16_t Delim>
+size_t FieldEnd(const uint8_t* data, size_t from, size_t length, uint16_t runtimeDelimiter, bool& quoted)
+{
+    const uint16_t delimiter = Delim ? Delim : runtimeDelimiter;
+    constexpr size_t unit = UnitSize<Enc>();
+    bool inQuotes = false;
+
+    for (size_t i = from; i + unit <= length; i += unit) {
+        if constexpr (Enc != FileEncoding::ANSI) {
+            // Jump straight to the next unit that can change state
+            i = (size_t)(inQuotes ? FindNext<Enc>(data, i, length, kQuote, kQuote, kQuote)
+                                  : FindNext<Enc>(data, i, length, kQuote, delimiter, delimiter));
+            if (i + unit > length) break;
+        }
+        uint16_t ch = Read<Enc>(data, i);
+        if (ch == kQuote) {
+            inQuotes = !inQuotes;
+            quoted = true;
+        } else if (!inQuotes && ch == delimiter) {
+            return i;
+        } else if constexpr (Enc == FileEncoding::ANSI) {
+            // Trail bytes of double-byte code pages can collide with ASCII delimiters
+            if (IsDBCSLeadByte(data[i]) && i + 1 < length) i++;
+        }
+    }
+    return length;
+}
+
+template <FileEncoding Enc, uint16_t Delim>
+const CsvDialect& Instance()
+{
+    static const CsvDialect dialect = {
+        &IndexBlock<Enc, Delim>, &CollectRowStarts<Enc>, &FieldEnd<Enc, Delim>, (wchar_t)Delim
+    };
+    return dialect;
+}
+
+template <FileEncoding Enc>
+const CsvDialect& ForDelimiter(wchar_t delimiter)
+{
+    switch (delimiter) {
+    case L',':  return Instance<Enc, L','>();
+    case L'\t': return Instance<Enc, L'\t'>();
+    case L';':  return Instance<Enc, L';'>();
+    case L'|':  return Instance<Enc, L'|'>();
+    default:    return Instance<Enc, 0>();
+    }
+}
+
+} // namespace
+
+const CsvDialect& SelectCsvDialect(FileEncoding encoding, wchar_t delimiter)
+{
+    switch (encoding) {
+    case FileEncoding::UTF8:     return ForDelimiter<FileEncoding::UTF8>(delimiter);
+    case FileEncoding::UTF16_LE: return ForDelimiter<FileEncoding::UTF16_LE>(delimiter);
+    case FileEncoding::UTF16_BE: return Instance<FileEncoding::UTF16_BE, 0>();
+    default:                     return Instance<FileEncoding::ANSI, 0>();
+    }
+}
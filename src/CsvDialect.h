@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class FileEncoding;
+
+// Quote state and field count carried from one indexed block to the next
+struct CsvScanState {
+    bool inQuotes = false;
+    size_t fields = 1; // Fields seen so far in the current row
+    bool trailByte = false; // ANSI: the block ended on a double-byte lead byte, so the next byte is its trail
+};
+
+// The hot scanning loops of CsvDocument, instantiated per dialect (encoding x delimiter) so the
+// character constants are compiled in and there is no per-unit branch on the encoding.
+// SelectCsvDialect picks one when the encoding or delimiter changes. Comma, tab, semicolon and
+// pipe are specialized; other delimiters use the generic instance, which takes 'delimiter' at run time.
+// Quotes are always '"'; rows end at '\n' (a preceding '\r' is trimmed by the callers).
+struct CsvDialect {
+    // Row boundaries and field counts of data[from, to): for each newline outside quotes,
+    // appends base + the offset after it, and the field count of the row it ends
+    void (*indexBlock)(const uint8_t* data, uint64_t from, uint64_t to, uint64_t base, uint16_t delimiter,
+                       CsvScanState& state, std::vector<uint64_t>& rowStarts, std::vector<size_t>& rowFields);
+    // Offsets after each newline outside quotes in [from, to)
+    void (*collectRowStarts)(const uint8_t* data, uint64_t from, uint64_t to, bool inQuotes,
+                             std::vector<uint64_t>& starts);
+    // End of the field starting at 'from' (outside quotes) in a row of 'length' bytes: the offset of
+    // the delimiter closing it, or 'length'. Sets 'quoted' if the field contains a quote.
+    size_t (*fieldEnd)(const uint8_t* data, size_t from, size_t length, uint16_t delimiter, bool& quoted);
+    wchar_t delimiter; // 0 for the generic instance
+};
+
+const CsvDialect& SelectCsvDialect(FileEncoding encoding, wchar_t delimiter);
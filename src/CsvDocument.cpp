@@ -1,20 +1,34 @@
 #include "CsvDocument.h"
+#include "TextCodec.h"
+#include "SimdScan.h"
+#include "RegexEngine.h"
+#include "CaseFold.h"
+#include "AhoCorasick.h"
+#include "BufferedWriter.h"
 #include <iostream>
 #include <regex>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 
 CsvDocument::CsvDocument()
+    : m_dialect(&SelectCsvDialect(m_encoding, m_delimiter))
 {
 }
 
 CsvDocument::~CsvDocument()
 {
+    StopFindAll();
+    StopIndexing();
 }
 
-// Column Operations
 // Column Operations
 bool CsvDocument::Load(const std::wstring& filePath, std::function<void(float)> progressCallback)
 {
+    StopFindAll();
+    StopIndexing();
     if (!m_pieceTable.LoadFromFile(filePath)) return false;
+    ClearHistory(); // Saved piece lists refer to the previous file and add buffer
     
     m_rowOffsets.clear();
     DetectEncoding();
@@ -25,8 +39,171 @@ bool CsvDocument::Load(const std::wstring& filePath, std::function<void(float)>
     return true;
 }
 
+bool CsvDocument::LoadAsync(const std::wstring& filePath, std::function<void(float)> progressCallback,
+                            std::function<void(bool)> completedCallback, CancellationToken cancelToken)
+{
+    return LoadAsync(filePath, progressCallback, completedCallback, cancelToken, LoadOptions());
+}
+
+bool CsvDocument::LoadAsync(const std::wstring& filePath, std::function<void(float)> progressCallback,
+                            std::function<void(bool)> completedCallback, CancellationToken cancelToken,
+                            const LoadOptions& options)
+{
+    StopFindAll();
+    StopIndexing();
+    if (!m_pieceTable.LoadFromFile(filePath)) return false;
+    ClearHistory(); // Saved piece lists refer to the previous file and add buffer
+
+    DetectEncoding();
+    DetectLineEnding();
+    ResetRowIndex();
+
+    SampleRowLength();
+    m_indexCancel = cancelToken;
+
+    if (options.mode == OpenMode::Head) {
+        // Index the first rows up front so they are available as soon as we return
+        if (IndexRows(cancelToken, progressCallback, options.rowLimit)) {
+            if (completedCallback) completedCallback(true);
+            return true;
+        }
+    } else if (options.mode == OpenMode::Tail) {
+        if (!LocateTailRows(options.rowLimit)) {
+            // Small file (or nothing to locate): an exact index is just as cheap
+            IndexRows(cancelToken, progressCallback);
+            if (completedCallback) completedCallback(true);
+            return true;
+        }
+    }
+
+    if (options.mode == OpenMode::Full || options.continueInBackground) {
+        StartIndexingThread(progressCallback, completedCallback, cancelToken);
+    }
+    return true;
+}
+
+void CsvDocument::StartIndexingThread(std::function<void(float)> progressCallback,
+                                      std::function<void(bool)> completedCallback, CancellationToken cancelToken)
+{
+    m_indexing = true;
+    m_indexThread = std::thread([this, cancelToken, progressCallback, completedCallback]() {
+        bool finished = IndexRows(cancelToken, progressCallback);
+        m_indexing = false;
+        if (completedCallback) completedCallback(finished);
+    });
+}
+
+void CsvDocument::CancelLoad()
+{
+    m_indexCancel.Cancel();
+}
+
+void CsvDocument::WaitForIndexing()
+{
+    if (m_indexThread.joinable()) m_indexThread.join();
+}
+
+void CsvDocument::EnsureFullyIndexed()
+{
+    WaitForIndexing();
+    if (!m_fullyIndexed) {
+        // Resume where a cancelled pass stopped
+        IndexRows(CancellationToken(), nullptr);
+    }
+}
+
+size_t CsvDocument::EnsureFullyIndexed(size_t rowIndex)
+{
+    // Remember where an estimated row lives so it can be renumbered once the index is exact
+    uint64_t start = 0, end = 0;
+    bool located = !IsRowNumberExact(rowIndex) && GetRowSpan(rowIndex, start, end);
+    bool pastEnd = !IsFullyIndexed() && rowIndex >= GetRowCount();
+
+    EnsureFullyIndexed();
+
+    if (located) {
+        return std::lower_bound(m_rowOffsets.begin(), m_rowOffsets.end(), start) - m_rowOffsets.begin();
+    }
+    if (pastEnd) return m_rowOffsets.size();
+    return rowIndex;
+}
+
+void CsvDocument::StopIndexing()
+{
+    StopPrefetch();
+    PauseFindAll();
+    m_indexCancel.Cancel();
+    WaitForIndexing();
+}
+
+void CsvDocument::PrefetchRows(size_t firstRow, size_t count, bool forward, size_t firstCol, size_t colCount)
+{
+    m_prefetchCancel.Cancel(); // Also how a change of direction stops the old pass
+    WaitForPrefetch();
+
+    const uint64_t version = m_version.load();
+    std::vector<size_t> rows;
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        // Keep only what is still current and near the new range
+        for (auto it = m_prefetched.begin(); it != m_prefetched.end();) {
+            bool near = it->first + count >= firstRow && it->first < firstRow + 2 * count;
+            if (it->second.version != version || !near || !it->second.row.Covers(firstCol, colCount)) it = m_prefetched.erase(it);
+            else ++it;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t row = forward ? firstRow + i : firstRow + count - 1 - i;
+            if (!m_rowCache.Contains(row, version, firstCol, colCount) && !m_prefetched.count(row)) rows.push_back(row);
+        }
+    }
+    if (rows.empty()) return;
+
+    m_prefetchCancel = CancellationToken();
+    CancellationToken token = m_prefetchCancel;
+    m_prefetchThread = std::thread([this, rows, version, token, firstCol, colCount]() {
+        ParsedRow row;
+        for (size_t rowIndex : rows) {
+            if (token.IsCancelled()) return;
+            // Faults the row's pages in and parses it off the UI thread
+            if (!GetParsedRow(rowIndex, row, firstCol, colCount)) continue;
+
+            std::lock_guard<std::mutex> lock(m_prefetchMutex);
+            PrefetchedRow& slot = m_prefetched[rowIndex];
+            slot.version = version;
+            std::swap(slot.row, row);
+        }
+    });
+}
+
+void CsvDocument::WaitForPrefetch()
+{
+    if (m_prefetchThread.joinable()) m_prefetchThread.join();
+}
+
+void CsvDocument::StopPrefetch()
+{
+    m_prefetchCancel.Cancel();
+    WaitForPrefetch();
+
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    m_prefetched.clear();
+}
+
+bool CsvDocument::TakePrefetchedRow(size_t rowIndex, uint64_t version, size_t firstCol, size_t count, ParsedRow& row)
+{
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    auto it = m_prefetched.find(rowIndex);
+    if (it == m_prefetched.end() || it->second.version != version || !it->second.row.Covers(firstCol, count)) return false;
+    std::swap(it->second.row, row);
+    m_prefetched.erase(it);
+    m_prefetchHits++;
+    return true;
+}
+
 bool CsvDocument::Import(const std::wstring& filePath)
 {
+    EnsureFullyIndexed();
+
     // Load as a separate doc to parse
     CsvDocument importDoc;
     if (!importDoc.Load(filePath)) return false;
@@ -48,32 +225,149 @@ bool CsvDocument::Import(const std::wstring& filePath)
 
 void CsvDocument::DetectEncoding()
 {
-    size_t size = m_pieceTable.GetSize();
-    if (size >= 3) {
-        // UTF-8 BOM: EF BB BF
-        if (m_pieceTable.GetAt(0) == 0xEF && m_pieceTable.GetAt(1) == 0xBB && m_pieceTable.GetAt(2) == 0xBF) {
-            m_encoding = FileEncoding::UTF8;
-            // Should we skip BOM in indexing? Usually yes.
-            // But PieceTable is raw. We handle BOM skipping in iterators or just ignore it.
-            // For now, let's keep it simple: Encoding detected, rest is handled.
-            return;
+    m_encodingReport = AnalyzeEncoding(false);
+    m_encoding = m_encodingReport.encoding;
+    m_dialect = &SelectCsvDialect(m_encoding, m_delimiter);
+}
+
+CsvDocument::EncodingReport CsvDocument::AnalyzeEncoding(bool wholeFile) const
+{
+    const uint64_t kSampleBytes = 4 * 1024 * 1024; // Head, middle and tail thirds
+    const size_t kMaxInvalidOffsets = 1000;
+    
+    EncodingReport report;
+    const uint64_t size = m_pieceTable.GetSize();
+    uint8_t head[3] = { 0, 0, 0 };
+    m_pieceTable.CopyRange(0, (std::min)(size, (uint64_t)3), head);
+    
+    uint64_t skip = 0; // BOM
+    if (size >= 3 && head[0] == 0xEF && head[1] == 0xBB && head[2] == 0xBF) {
+        report.hasBom = true;
+        skip = 3;
+    } else if (size >= 2 && ((head[0] == 0xFF && head[1] == 0xFE) || (head[0] == 0xFE && head[1] == 0xFF))) {
+        // UTF-16 BOMs settle it
+        report.hasBom = true;
+        report.encoding = (head[0] == 0xFF) ? FileEncoding::UTF16_LE : FileEncoding::UTF16_BE;
+        report.confidence = 1.0;
+        return report;
+    }
+    
+    // Ranges to check: the whole file split across threads, or three samples
+    std::vector<std::pair<uint64_t, uint64_t>> ranges; // [start, end)
+    report.wholeFile = wholeFile || size - skip <= kSampleBytes;
+    if (report.wholeFile) {
+        uint64_t chunks = (std::max)(1u, std::thread::hardware_concurrency());
+        chunks = (std::min)(chunks, (size - skip) / (1024 * 1024) + 1);
+        uint64_t chunkSize = ((size - skip) / chunks + 1) & ~(uint64_t)1;
+        for (uint64_t start = skip; start < size; start += chunkSize) {
+            ranges.push_back({ start, (std::min)(size, start + chunkSize) });
         }
+    } else {
+        uint64_t third = (kSampleBytes / 3) & ~(uint64_t)1;
+        uint64_t middle = ((size / 2) - third / 2) & ~(uint64_t)1;
+        ranges.push_back({ skip, skip + third });
+        ranges.push_back({ middle, middle + third });
+        ranges.push_back({ (size - third) & ~(uint64_t)1, size });
     }
-    if (size >= 2) {
-        // UTF-16 LE BOM: FF FE
-        if (m_pieceTable.GetAt(0) == 0xFF && m_pieceTable.GetAt(1) == 0xFE) {
-            m_encoding = FileEncoding::UTF16_LE;
-            return;
+    
+    struct RangeResult {
+        TextCodec::Utf8Stats utf8;
+        std::vector<uint64_t> invalidOffsets;
+        uint64_t zeroEven = 0; // Zero bytes at even / odd file offsets (UTF-16 ASCII text)
+        uint64_t zeroOdd = 0;
+    };
+    std::vector<RangeResult> results(ranges.size());
+    
+    auto check = [&](size_t index) {
+        uint64_t start = ranges[index].first;
+        uint64_t end = ranges[index].second;
+        // Sequences starting near the end may run on for up to 3 bytes
+        uint64_t readableEnd = (std::min)(size, end + 3);
+        std::vector<uint8_t> copy;
+        const uint8_t* data = m_pieceTable.GetContiguous(start, readableEnd - start);
+        if (!data) {
+            copy.resize((size_t)(readableEnd - start));
+            m_pieceTable.CopyRange(start, readableEnd - start, copy.data());
+            data = copy.data();
         }
-        // UTF-16 BE BOM: FE FF
-        if (m_pieceTable.GetAt(0) == 0xFE && m_pieceTable.GetAt(1) == 0xFF) {
-            m_encoding = FileEncoding::UTF16_BE;
-            return;
+        
+        // A range starting inside a sequence: that sequence belongs to the previous range
+        size_t first = 0;
+        if (start > skip) {
+            while (first < 3 && start + first < end && (data[first] & 0xC0) == 0x80) first++;
+        }
+        
+        RangeResult& result = results[index];
+        size_t length = (size_t)(end - start);
+        TextCodec::ValidateUtf8(data + first, length - first, (size_t)(readableEnd - start) - first, start + first,
+                                result.utf8, &result.invalidOffsets, kMaxInvalidOffsets);
+        for (size_t i = 0; i < length; ++i) {
+            if (data[i] == 0) {
+                if ((start + i) % 2 == 0) result.zeroEven++;
+                else result.zeroOdd++;
+            }
+        }
+    };
+    
+    if (ranges.size() > 1 && report.wholeFile) {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < ranges.size(); ++i) workers.emplace_back(check, i);
+        for (auto& worker : workers) worker.join();
+    } else {
+        for (size_t i = 0; i < ranges.size(); ++i) check(i);
+    }
+    
+    // Merge in file order
+    TextCodec::Utf8Stats utf8;
+    uint64_t zeroEven = 0, zeroOdd = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        utf8.multiByte += results[i].utf8.multiByte;
+        utf8.invalid += results[i].utf8.invalid;
+        zeroEven += results[i].zeroEven;
+        zeroOdd += results[i].zeroOdd;
+        report.bytesChecked += ranges[i].second - ranges[i].first;
+        for (uint64_t offset : results[i].invalidOffsets) {
+            if (report.invalidOffsets.size() < kMaxInvalidOffsets) report.invalidOffsets.push_back(offset);
         }
     }
     
-    // Default to UTF-8 (or check logic for validity)
-    m_encoding = FileEncoding::UTF8;
+    // UTF-16 without BOM: mostly-ASCII text has a zero in every other byte
+    double units = (std::max)((double)report.bytesChecked / 2, 1.0);
+    double evenShare = zeroEven / units;
+    double oddShare = zeroOdd / units;
+    if (oddShare > 0.2 && oddShare > 4 * evenShare) {
+        report.encoding = FileEncoding::UTF16_LE;
+        report.confidence = (std::min)(1.0, 0.5 + oddShare - evenShare);
+        report.invalidOffsets.clear();
+        return report;
+    }
+    if (evenShare > 0.2 && evenShare > 4 * oddShare) {
+        report.encoding = FileEncoding::UTF16_BE;
+        report.confidence = (std::min)(1.0, 0.5 + evenShare - oddShare);
+        report.invalidOffsets.clear();
+        return report;
+    }
+    
+    report.invalidCount = utf8.invalid;
+    if (utf8.invalid == 0) {
+        // Valid UTF-8. Pure ASCII reads the same in any code page; a sample may just have missed the rest.
+        report.encoding = FileEncoding::UTF8;
+        if (report.hasBom) report.confidence = 1.0;
+        else if (utf8.multiByte > 0) report.confidence = 0.9 + 0.1 * (std::min)(1.0, utf8.multiByte / 100.0);
+        else report.confidence = report.wholeFile ? 1.0 : 0.6;
+        return report;
+    }
+    
+    // Invalid sequences: a legacy code page, unless they are rare damage in UTF-8 text
+    double utf8Share = (double)utf8.multiByte / (double)(utf8.multiByte + utf8.invalid);
+    if (report.hasBom || utf8Share >= 0.9) {
+        report.encoding = FileEncoding::UTF8;
+        report.confidence = report.hasBom ? 1.0 : utf8Share * 0.9;
+    } else {
+        report.encoding = FileEncoding::ANSI;
+        report.confidence = 1.0 - utf8Share;
+    }
+    return report;
 }
 
 void CsvDocument::DetectLineEnding()
@@ -149,21 +443,9 @@ std::vector<uint8_t> CsvDocument::EncodeString(const std::wstring& str)
 {
     std::vector<uint8_t> result;
     if (m_encoding == FileEncoding::UTF8) {
-        int len = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.length(), NULL, 0, NULL, NULL);
-        if (len > 0) {
-            result.resize(len);
-            WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.length(), (char*)result.data(), len, NULL, NULL);
-        }
-    } else if (m_encoding == FileEncoding::UTF16_LE) {
-        result.resize(str.length() * 2);
-        memcpy(result.data(), str.c_str(), str.length() * 2);
-    } else if (m_encoding == FileEncoding::UTF16_BE) {
-        result.resize(str.length() * 2);
-        for (size_t i = 0; i < str.length(); ++i) {
-            uint16_t ch = static_cast<uint16_t>(str[i]);
-            result[i*2] = (ch >> 8) & 0xFF;
-            result[i*2+1] = ch & 0xFF;
-        }
+        TextCodec::AppendAsUtf8(str.data(), str.length(), result);
+    } else if (m_encoding == FileEncoding::UTF16_LE || m_encoding == FileEncoding::UTF16_BE) {
+        TextCodec::AppendAsUtf16(str.data(), str.length(), m_encoding == FileEncoding::UTF16_BE, result);
     } else {
         // ANSI
         int len = WideCharToMultiByte(CP_ACP, 0, str.c_str(), (int)str.length(), NULL, 0, NULL, NULL);
@@ -177,13 +459,20 @@ std::vector<uint8_t> CsvDocument::EncodeString(const std::wstring& str)
 
 void CsvDocument::InsertColumn(size_t colIndex, const std::wstring& defaultValue)
 {
+    EnsureFullyIndexed();
     Snapshot(); // Save state
+    PauseFindAll(); // Until RebuildRowIndex restarts it
 
     int64_t shift = 0;
     size_t rows = GetRowCount();
     
     // We iterate all rows and modify them one by one.
     // This shifts offsets for subsequent rows.
+    // Buffers are reused across rows.
+    std::vector<uint8_t> rawRow;
+    std::wstring rowText;
+    std::wstring newRowStr;
+    ParsedRow cells;
     
     for (size_t r = 0; r < rows; ++r) {
         uint64_t start = m_rowOffsets[r] + shift;
@@ -193,25 +482,24 @@ void CsvDocument::InsertColumn(size_t colIndex, const std::wstring& defaultValue
         else oldLen = m_pieceTable.GetSize() - start;
         
         // Read raw row
-        std::vector<uint8_t> rawPos(oldLen);
-        if (oldLen > 0) {
-            for(size_t i=0; i<oldLen; ++i) {
-                rawPos[i] = m_pieceTable.GetAt(start + i);
-            }
-        }
+        rawRow.resize((size_t)oldLen);
+        m_pieceTable.CopyRange(start, oldLen, rawRow.data());
         
-        std::wstring rowText = DecodeString(rawPos);
-        auto cells = ParseRowCells(rowText);
+        rowText.clear();
+        AppendDecoded(rawRow.data(), rawRow.size(), rowText);
+        ParseRowCells(rowText, cells);
         
-        // Modify
-        if (colIndex <= cells.size()) {
-             cells.insert(cells.begin() + colIndex, defaultValue);
-        } else {
-             while(cells.size() < colIndex) cells.push_back(L"");
-             cells.push_back(defaultValue);
+        // Modify: pad short rows up to the new column
+        newRowStr.clear();
+        size_t count = (std::max)(cells.GetCellCount(), colIndex);
+        for (size_t c = 0; c <= count; ++c) {
+            if (c > 0) newRowStr += m_delimiter;
+            if (c == colIndex) AppendCsvCell(defaultValue, newRowStr);
+            else {
+                size_t src = (c < colIndex) ? c : c - 1;
+                if (src < cells.GetCellCount()) AppendCsvCell(cells.GetCell(src), newRowStr);
+            }
         }
-        
-        std::wstring newRowStr = ConstructRowString(cells);
         newRowStr += GetLineEndingStr(); 
         
         // Encode
@@ -229,9 +517,16 @@ void CsvDocument::InsertColumn(size_t colIndex, const std::wstring& defaultValue
 
 void CsvDocument::DeleteColumn(size_t colIndex)
 {
+    EnsureFullyIndexed();
     Snapshot();
+    PauseFindAll(); // Until RebuildRowIndex restarts it
     int64_t shift = 0;
     size_t rows = GetRowCount();
+
+    std::vector<uint8_t> rawRow;
+    std::wstring rowText;
+    std::wstring newRowStr;
+    ParsedRow cells;
     
     for (size_t r = 0; r < rows; ++r) {
         uint64_t start = m_rowOffsets[r] + shift;
@@ -240,20 +535,22 @@ void CsvDocument::DeleteColumn(size_t colIndex)
         if (r + 1 < rows) oldLen = m_rowOffsets[r+1] - m_rowOffsets[r];
         else oldLen = m_pieceTable.GetSize() - start;
         
-        std::vector<uint8_t> rawPos(oldLen);
-        if (oldLen > 0) {
-            for(size_t i=0; i<oldLen; ++i) {
-                rawPos[i] = m_pieceTable.GetAt(start + i);
-            }
-        }
+        rawRow.resize((size_t)oldLen);
+        m_pieceTable.CopyRange(start, oldLen, rawRow.data());
         
-        std::wstring rowText = DecodeString(rawPos);
-        auto cells = ParseRowCells(rowText);
+        rowText.clear();
+        AppendDecoded(rawRow.data(), rawRow.size(), rowText);
+        ParseRowCells(rowText, cells);
         
-        if (colIndex < cells.size()) {
-             cells.erase(cells.begin() + colIndex);
-             
-            std::wstring newRowStr = ConstructRowString(cells);
+        if (colIndex < cells.GetCellCount()) {
+            newRowStr.clear();
+            bool first = true;
+            for (size_t c = 0; c < cells.GetCellCount(); ++c) {
+                if (c == colIndex) continue;
+                if (!first) newRowStr += m_delimiter;
+                AppendCsvCell(cells.GetCell(c), newRowStr);
+                first = false;
+            }
             newRowStr += GetLineEndingStr(); 
             
             // Encode
@@ -268,58 +565,56 @@ void CsvDocument::DeleteColumn(size_t colIndex)
     RebuildRowIndex();
 }
 
-std::vector<std::wstring> CsvDocument::ParseRowCells(const std::wstring& rowText)
+void CsvDocument::ParseRowCells(std::wstring_view rowText, ParsedRow& cells) const
 {
-    std::vector<std::wstring> cells;
+    cells.Clear();
     bool inQuotes = false;
-    std::wstring currentCell;
     
     for (size_t i = 0; i < rowText.size(); ++i) {
         wchar_t c = rowText[i];
         if (inQuotes) {
             if (c == L'\"') {
                 if (i + 1 < rowText.size() && rowText[i + 1] == L'\"') {
-                    currentCell += L'\"'; i++;
+                    cells.Append(L'\"'); i++;
                 } else { inQuotes = false; }
-            } else { currentCell += c; }
+            } else { cells.Append(c); }
         } else {
             if (c == L'\"') { inQuotes = true; }
-            else if (c == m_delimiter) { cells.push_back(currentCell); currentCell.clear(); }
+            else if (c == m_delimiter) { cells.EndCell(); }
             else if (c == L'\r' || c == L'\n') { /* ignore */ } 
-            else { currentCell += c; }
+            else { cells.Append(c); }
         }
     }
-    cells.push_back(currentCell);
-    return cells;
+    cells.EndCell();
 }
 
 std::wstring CsvDocument::ConstructRowString(const std::vector<std::wstring>& cells)
 {
     std::wstring newRowStr;
     for (size_t i = 0; i < cells.size(); ++i) {
-        bool needsQuotes = false;
-        if (cells[i].find(m_delimiter) != std::wstring::npos || 
-            cells[i].find(L'\"') != std::wstring::npos ||
-            cells[i].find(L'\n') != std::wstring::npos) {
-            needsQuotes = true;
-        }
-        
-        if (needsQuotes) {
-            newRowStr += L'\"';
-            for (wchar_t c : cells[i]) {
-                if (c == L'\"') newRowStr += L"\"\"";
-                else newRowStr += c;
-            }
-            newRowStr += L'\"';
-        } else {
-            newRowStr += cells[i];
-        }
-        
+        AppendCsvCell(cells[i], newRowStr);
         if (i < cells.size() - 1) newRowStr += m_delimiter;
     }
     return newRowStr;
 }
 
+void CsvDocument::AppendCsvCell(std::wstring_view cell, std::wstring& out) const
+{
+    bool needsQuotes = cell.find(m_delimiter) != std::wstring_view::npos ||
+                       cell.find(L'\"') != std::wstring_view::npos ||
+                       cell.find(L'\n') != std::wstring_view::npos;
+    if (!needsQuotes) {
+        out.append(cell.data(), cell.size());
+        return;
+    }
+    out += L'\"';
+    for (wchar_t c : cell) {
+        if (c == L'\"') out += L"\"\"";
+        else out += c;
+    }
+    out += L'\"';
+}
+
 bool CsvDocument::Save(const std::wstring& filePath)
 {
     // In future: might need to handle encoding conversion here if we supported converting ON SAVE.
@@ -331,234 +626,853 @@ size_t CsvDocument::GetRowCount() const
 {
     // The last virtual row might be empty if file ends with newline, 
     // but usually we count it.
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    size_t count = GetIndexedRowCountLocked();
+    if (!m_window.offsets.empty()) {
+        count = (std::max)(count, m_window.firstRow + m_window.offsets.size() - 1);
+    }
+    return count;
+}
+
+size_t CsvDocument::GetIndexedRowCountLocked() const
+{
+    if (!m_fullyIndexed && !m_rowOffsets.empty()) {
+        // While indexing, the last offset starts a row whose end has not been found yet
+        return m_rowOffsets.size() - 1;
+    }
     return m_rowOffsets.size();
 }
 
+bool CsvDocument::IsRowNumberExact(size_t rowIndex) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    if (m_fullyIndexed || m_window.exact) return true;
+    return rowIndex < GetIndexedRowCountLocked();
+}
+
 uint64_t CsvDocument::GetRowStartOffset(size_t rowIndex) const
 {
-    if (rowIndex >= m_rowOffsets.size()) return m_pieceTable.GetSize();
-    return m_rowOffsets[rowIndex];
+    uint64_t start = 0, end = 0;
+    if (!GetRowSpan(rowIndex, start, end)) return m_pieceTable.GetSize();
+    return start;
+}
+
+bool CsvDocument::GetRowSpan(size_t rowIndex, uint64_t& start, uint64_t& end) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    if (rowIndex < GetIndexedRowCountLocked()) {
+        start = m_rowOffsets[rowIndex];
+        end = (rowIndex + 1 < m_rowOffsets.size()) ? m_rowOffsets[rowIndex + 1] : m_pieceTable.GetSize();
+        return true;
+    }
+
+    // Rows located ahead of the index
+    if (rowIndex >= m_window.firstRow && rowIndex - m_window.firstRow + 1 < m_window.offsets.size()) {
+        size_t i = rowIndex - m_window.firstRow;
+        start = m_window.offsets[i];
+        end = m_window.offsets[i + 1];
+        return true;
+    }
+    return false; // Still being indexed
 }
 
 void CsvDocument::RebuildRowIndex(std::function<void(float)> progressCallback)
 {
+    StopIndexing();
+    ResetRowIndex();
+    IndexRows(CancellationToken(), progressCallback);
+    RestartFindAll();
+}
+
+void CsvDocument::ResetRowIndex()
+{
+    std::unique_lock<std::shared_mutex> lock(m_indexMutex);
     m_rowOffsets.clear();
-    
-    if (m_pieceTable.GetSize() == 0) {
-        if (progressCallback) progressCallback(1.0f);
-        return; 
+    m_indexResumeOffset = 0;
+    m_indexResumeState = CsvScanState();
+    m_fullyIndexed = false;
+    m_window = RowWindow();
+    m_columnHistogram.clear();
+    m_irregularRows.clear();
+    m_headerColumns = 0;
+    m_version++;
+    
+    if (m_pieceTable.GetSize() > 0) {
+        m_rowOffsets.push_back(0); // First row always starts at 0
     }
+}
 
-    m_rowOffsets.push_back(0); // First row always starts at 0
+uint16_t CsvDocument::CharAt(const uint8_t* data, uint64_t pos) const
+{
+    if (m_encoding == FileEncoding::UTF16_LE) return data[pos] | (data[pos+1] << 8);
+    if (m_encoding == FileEncoding::UTF16_BE) return (data[pos] << 8) | data[pos+1];
+    return data[pos];
+}
 
-    // Iterate through all pieces
-    const auto& pieces = m_pieceTable.GetPieces();
-    const auto& file = m_pieceTable.GetOriginalFile();
-    const auto& addBuf = m_pieceTable.GetAddBuffer();
-    
-    uint64_t currentLogicalOffset = 0;
-    bool inQuotes = false;
-    
-    // Quick helpers
-    auto is_newline = [&](uint16_t ch) { return ch == L'\n'; };
-    auto is_quote = [&](uint16_t ch) { return ch == L'\"'; };
+bool CsvDocument::FindQuoteAnchor(const uint8_t* data, uint64_t size, uint64_t from, uint64_t to,
+                                  uint64_t& anchor, bool& inQuotes) const
+{
+    // The quote state is unknown mid-file. A quote between a boundary and ordinary text
+    // can only be opening (or only closing), which pins the state down from there on.
+    const uint64_t unit = GetCodeUnitSize();
+    auto isBoundary = [&](uint16_t ch) { return ch == m_delimiter || ch == L'\n' || ch == L'\r'; };
+    auto isOrdinary = [&](uint16_t ch) { return !isBoundary(ch) && ch != L'\"'; };
+
+    for (uint64_t i = from; i + unit <= to; i += unit) {
+        if (CharAt(data, i) != L'\"') continue;
+        uint16_t prev = (i >= unit) ? CharAt(data, i - unit) : L'\n';
+        uint16_t next = (i + 2 * unit <= size) ? CharAt(data, i + unit) : L'\n';
+        bool opening = isBoundary(prev) && isOrdinary(next);
+        bool closing = isOrdinary(prev) && isBoundary(next);
+        if (opening != closing) {
+            anchor = i + unit;
+            inQuotes = opening;
+            return true;
+        }
+    }
+    return false;
+}
 
-    uint64_t totalBytes = m_pieceTable.GetSize(); // Approx
-    uint64_t processedBytes = 0;
-    const uint64_t reportInterval = 1024 * 1024; // Report every 1MB
-    uint64_t nextReport = reportInterval;
+void CsvDocument::CollectRowStarts(const uint8_t* data, uint64_t from, uint64_t to, bool inQuotes,
+                                   std::vector<uint64_t>& starts) const
+{
+    m_dialect->collectRowStarts(data, from, to, inQuotes, starts);
+}
 
-    for (const auto& piece : pieces) {
-        const uint8_t* data = (piece.source == Piece::ORIGINAL) 
-            ? file.GetData() + piece.offset
-            : addBuf.data() + piece.offset;
-        
-        uint64_t len = piece.length;
-
-        // Progress check helper
-        auto check_progress = [&](uint64_t currentPieceIdx) {
-            processedBytes += currentPieceIdx; 
-            if (processedBytes >= nextReport) {
-                if (progressCallback) progressCallback((float)processedBytes / totalBytes);
-                nextReport += reportInterval;
-            }
-            processedBytes -= currentPieceIdx; // Reset for loop
-        };
-        // Simplified progress: just report inside loop logic or after piece?
-        // Pieces can be large (whole file). Need inside loop.
+uint64_t CsvDocument::GetCodeUnitSize() const
+{
+    return (m_encoding == FileEncoding::UTF16_LE || m_encoding == FileEncoding::UTF16_BE) ? 2 : 1;
+}
 
-        if (m_encoding == FileEncoding::UTF16_LE) {
-            for (uint64_t i = 0; i + 1 < len; i += 2) {
-                // Progress
-                if (progressCallback && (processedBytes + i) >= nextReport) {
-                    progressCallback((float)(processedBytes + i) / totalBytes);
-                    nextReport += reportInterval;
-                }
-                
-                uint16_t ch = data[i] | (data[i+1] << 8);
-                if (is_quote(ch)) {
-                    inQuotes = !inQuotes;
-                } else if (is_newline(ch)) {
-                    if (!inQuotes) {
-                        m_rowOffsets.push_back(currentLogicalOffset + i + 2);
-                    }
-                }
+bool CsvDocument::LocateTailRows(size_t rowLimit)
+{
+    // Only a freshly loaded file is a single contiguous mapping we can scan backward
+    const auto& pieces = m_pieceTable.GetPieces();
+    if (rowLimit == 0 || pieces.size() != 1 || pieces[0].source != Piece::ORIGINAL) return false;
+
+    const uint8_t* data = m_pieceTable.GetOriginalFile().GetData() + pieces[0].offset;
+    const uint64_t size = pieces[0].length;
+    const uint64_t unit = GetCodeUnitSize();
+
+    // Grow a window back from EOF until it holds enough rows
+    const uint64_t maxWindow = 64ull * 1024 * 1024;
+    uint64_t windowBytes = (std::max)((uint64_t)64 * 1024, (uint64_t)rowLimit * 128);
+    std::vector<uint64_t> starts;
+
+    for (;;) {
+        if (windowBytes >= size) return false; // Whole file: index it normally
+
+        uint64_t windowStart = ((size - windowBytes) / unit) * unit;
+        uint64_t scanFrom = windowStart;
+        bool inQuotes = false;
+        if (!FindQuoteAnchor(data, size, windowStart, size, scanFrom, inQuotes)) {
+            // Fall back to assuming the file ends outside quotes
+            size_t quotes = 0;
+            for (uint64_t i = windowStart; i + unit <= size; i += unit) {
+                if (CharAt(data, i) == L'\"') quotes++;
             }
-        } else if (m_encoding == FileEncoding::UTF16_BE) {
-            for (uint64_t i = 0; i + 1 < len; i += 2) {
-                 if (progressCallback && (processedBytes + i) >= nextReport) {
-                    progressCallback((float)(processedBytes + i) / totalBytes);
-                    nextReport += reportInterval;
-                }
+            inQuotes = (quotes % 2) != 0;
+        }
 
-                uint16_t ch = (data[i] << 8) | data[i+1];
-                if (is_quote(ch)) {
-                    inQuotes = !inQuotes;
-                } else if (is_newline(ch)) {
-                    if (!inQuotes) {
-                        m_rowOffsets.push_back(currentLogicalOffset + i + 2);
-                    }
-                }
-            }
-        } else {
-            // UTF8 / ANSI
-            for (uint64_t i = 0; i < len; ++i) {
-                 if (progressCallback && (processedBytes + i) >= nextReport) {
-                    progressCallback((float)(processedBytes + i) / totalBytes);
-                    nextReport += reportInterval;
-                }
+        // Rows start after each unquoted newline; text before the first one is a partial row
+        starts.clear();
+        CollectRowStarts(data, scanFrom, size, inQuotes, starts);
+        if (!starts.empty() && starts.back() == size) starts.pop_back(); // Trailing newline
 
-                uint8_t b = data[i];
-                if (b == '\"') {
-                    inQuotes = !inQuotes;
-                }
-                else if (b == '\n') {
-                    if (!inQuotes) {
-                        m_rowOffsets.push_back(currentLogicalOffset + i + 1);
-                    }
-                }
-            }
-        }
-        currentLogicalOffset += len;
-        processedBytes += len;
+        if (starts.size() >= rowLimit || windowBytes >= maxWindow) break;
+        windowBytes *= 2;
     }
-    
-    // Handle trailing newline/empty row logic
-    if (m_rowOffsets.size() > 1 && m_rowOffsets.back() == m_pieceTable.GetSize()) {
-        m_rowOffsets.pop_back();
+    if (starts.empty()) return false;
+
+    if (starts.size() > rowLimit) {
+        starts.erase(starts.begin(), starts.end() - rowLimit);
     }
-    
-    if (progressCallback) progressCallback(1.0f);
+
+    // Estimate row numbers from the average row length in the window
+    size_t rows = starts.size();
+    uint64_t avgRowBytes = (std::max)((uint64_t)1, (size - starts.front()) / rows);
+    size_t estimatedTotal = (std::max)((size_t)(size / avgRowBytes), rows + 1);
+
+    std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+    m_window.firstRow = (std::max)(estimatedTotal - rows, GetIndexedRowCountLocked());
+    m_window.exact = false;
+    m_window.offsets = std::move(starts);
+    m_window.offsets.push_back(size);
+    m_version++;
+    return true;
 }
 
-std::vector<uint8_t> CsvDocument::GetRowRaw(size_t rowIndex)
+bool CsvDocument::SeekToFraction(double fraction, size_t& row)
 {
-    std::vector<uint8_t> result;
-    if (rowIndex >= m_rowOffsets.size()) return result;
+    fraction = (std::min)(1.0, (std::max)(0.0, fraction));
+    if (m_fullyIndexed) {
+        size_t rows = GetRowCount();
+        row = rows > 0 ? (std::min)((size_t)(fraction * rows), rows - 1) : 0;
+        return rows > 0;
+    }
 
-    uint64_t start = m_rowOffsets[rowIndex];
-    uint64_t end = (rowIndex + 1 < m_rowOffsets.size()) ? m_rowOffsets[rowIndex + 1] : m_pieceTable.GetSize();
-    
-    // Exclude the newline char(s) from the row data? Usually yes.
-    // Check if previous char was \r if we are at \n (handled in parsing logic usually)
-    
-    if (end > start) {
-        uint64_t dataLen = end - start;
-        // Fetch byte by byte is slow, optimization needed: FetchChunk
-        // For now, simple loop
-        for (uint64_t i = 0; i < dataLen; ++i) {
-            result.push_back(m_pieceTable.GetAt(start + i));
+    const auto& pieces = m_pieceTable.GetPieces();
+    if (pieces.size() != 1 || pieces[0].source != Piece::ORIGINAL) return false;
+
+    const uint8_t* data = m_pieceTable.GetOriginalFile().GetData() + pieces[0].offset;
+    const uint64_t size = pieces[0].length;
+    const uint64_t unit = GetCodeUnitSize();
+    const uint64_t target = (std::min)((uint64_t)(fraction * size) / unit * unit, size);
+
+    uint64_t frontierOffset = 0, frontierRowStart = 0;
+    bool frontierInQuotes = false;
+    size_t indexed = 0;
+    {
+        // Already indexed, or inside the current window
+        std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+        if (m_rowOffsets.empty()) return false;
+        indexed = GetIndexedRowCountLocked();
+        if (indexed > 0 && target < m_rowOffsets[indexed]) {
+            row = std::upper_bound(m_rowOffsets.begin(), m_rowOffsets.begin() + indexed, target) - m_rowOffsets.begin() - 1;
+            return true;
         }
-
-        // Check for newline removal based on encoding
-        if (m_encoding == FileEncoding::UTF8 || m_encoding == FileEncoding::ANSI) {
-            if (!result.empty() && result.back() == '\n') {
-                result.pop_back();
-                if (!result.empty() && result.back() == '\r') result.pop_back();
-            }
-        } else if (m_encoding == FileEncoding::UTF16_LE) {
-            // Newline is 0A 00
-            if (result.size() >= 2 && result[result.size()-2] == 0x0A && result[result.size()-1] == 0x00) {
-                result.pop_back(); result.pop_back();
-                // Check CR: 0D 00
-                if (result.size() >= 2 && result[result.size()-2] == 0x0D && result[result.size()-1] == 0x00) {
-                     result.pop_back(); result.pop_back();
-                }
-            }
-        } else if (m_encoding == FileEncoding::UTF16_BE) {
-            // Newline is 00 0A
-            if (result.size() >= 2 && result[result.size()-2] == 0x00 && result[result.size()-1] == 0x0A) {
-                result.pop_back(); result.pop_back();
-                // Check CR: 00 0D
-                if (result.size() >= 2 && result[result.size()-2] == 0x00 && result[result.size()-1] == 0x0D) {
-                     result.pop_back(); result.pop_back();
-                }
-            }
+        const auto& offsets = m_window.offsets;
+        if (offsets.size() > 1 && target >= offsets.front() && target < offsets.back()) {
+            row = m_window.firstRow + (std::upper_bound(offsets.begin(), offsets.end(), target) - offsets.begin() - 1);
+            return true;
         }
+        frontierOffset = m_indexResumeOffset;
+        frontierInQuotes = m_indexResumeState.inQuotes;
+        frontierRowStart = m_rowOffsets[indexed];
     }
-    
-    return result;
+
+    // Index a local window around the target
+    const uint64_t reach = 512 * 1024;
+    uint64_t from = target > reach ? (target - reach) / unit * unit : 0;
+    uint64_t to = (std::min)(size, target + reach);
+
+    uint64_t scanFrom = from;
+    bool inQuotes = false;
+    bool exact = false;
+    std::vector<uint64_t> starts;
+    if (from <= frontierOffset) {
+        // Close to the index: continue from it, where both quote state and row number are known
+        starts.push_back(frontierRowStart);
+        scanFrom = frontierOffset;
+        inQuotes = frontierInQuotes;
+        exact = true;
+    } else if (!FindQuoteAnchor(data, size, from, to, scanFrom, inQuotes)) {
+        // Resynchronize within the bounded look-back; with no quotes nearby nothing can straddle lines
+        scanFrom = from;
+        inQuotes = false;
+    }
+    CollectRowStarts(data, scanFrom, to, inQuotes, starts);
+    if (to == size) {
+        if (!starts.empty() && starts.back() == size) starts.pop_back();
+        starts.push_back(size); // Last row ends at EOF
+    }
+    if (starts.size() < 2) return false; // No complete row nearby
+
+    // Number the rows so the target lands where the estimated row count puts it
+    size_t firstRow = exact ? indexed : (size_t)((double)starts.front() / size * GetEstimatedRowCount());
+
+    std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+    m_window.firstRow = exact ? firstRow : (std::max)(firstRow, GetIndexedRowCountLocked());
+    m_window.exact = exact;
+    m_window.offsets = std::move(starts);
+    m_version++;
+
+    size_t local = std::upper_bound(m_window.offsets.begin(), m_window.offsets.end(), target) - m_window.offsets.begin();
+    local = (std::min)(local > 0 ? local - 1 : 0, m_window.offsets.size() - 2);
+    row = m_window.firstRow + local;
+    return true;
 }
 
-void CsvDocument::SetDelimiter(wchar_t delimiter)
+bool CsvDocument::IsRowAvailable(size_t rowIndex) const
 {
-    m_delimiter = delimiter;
+    uint64_t start = 0, end = 0;
+    return GetRowSpan(rowIndex, start, end);
 }
 
-void CsvDocument::SetEncoding(FileEncoding encoding)
+size_t CsvDocument::GetEstimatedRowCount() const
 {
-    m_encoding = encoding;
+    if (m_fullyIndexed) return GetRowCount();
+
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    size_t indexed = GetIndexedRowCountLocked();
+    double size = (double)m_pieceTable.GetSize();
+    double estimate = (double)indexed;
+    if (m_indexResumeOffset > m_sampledBytes) {
+        // The index has seen more of the file than the samples did
+        estimate = indexed * size / m_indexResumeOffset;
+    } else if (m_sampledBytes > 0) {
+        estimate = m_sampledRows * size / m_sampledBytes;
+    }
+
+    size_t count = (std::max)((size_t)estimate, indexed);
+    if (!m_window.offsets.empty()) {
+        count = (std::max)(count, m_window.firstRow + m_window.offsets.size() - 1);
+    }
+    return count;
 }
 
-std::vector<std::wstring> CsvDocument::GetRowCells(size_t rowIndex)
+void CsvDocument::SampleRowLength()
 {
-    std::vector<std::wstring> cells;
-    std::vector<uint8_t> rawRow = GetRowRaw(rowIndex);
-    std::wstring rowText = DecodeString(rawRow);
+    // Count rows in evenly spaced samples; cheap even for huge files
+    m_sampledBytes = 0;
+    m_sampledRows = 0;
 
-    // Basic CSV parsing state machine
-    bool inQuotes = false;
-    std::wstring currentCell;
-    
-    for (size_t i = 0; i < rowText.size(); ++i) {
-        wchar_t c = rowText[i];
-        
-        if (inQuotes) {
-            if (c == L'\"') {
-                if (i + 1 < rowText.size() && rowText[i + 1] == L'\"') {
-                    // Escaped quote
-                    currentCell += L'\"';
-                    i++;
-                } else {
-                    inQuotes = false;
-                }
-            } else {
-                currentCell += c;
+    const auto& pieces = m_pieceTable.GetPieces();
+    if (pieces.size() != 1 || pieces[0].source != Piece::ORIGINAL) return;
+
+    const uint8_t* data = m_pieceTable.GetOriginalFile().GetData() + pieces[0].offset;
+    const uint64_t size = pieces[0].length;
+    const uint64_t unit = GetCodeUnitSize();
+    const uint64_t sampleBytes = 64 * 1024;
+    const int sampleCount = 16;
+
+    uint64_t stride = (std::max)(sampleBytes, size / sampleCount);
+    std::vector<uint64_t> starts;
+    for (uint64_t start = 0; start < size; start += stride) {
+        uint64_t from = start / unit * unit;
+        uint64_t to = (std::min)(size, from + sampleBytes);
+        uint64_t scanFrom = from;
+        bool inQuotes = false;
+        if (from > 0 && !FindQuoteAnchor(data, size, from, to, scanFrom, inQuotes)) {
+            scanFrom = from;
+        }
+        starts.clear();
+        CollectRowStarts(data, scanFrom, to, inQuotes, starts);
+        m_sampledRows += starts.size();
+        m_sampledBytes += to - scanFrom;
+    }
+}
+
+bool CsvDocument::IndexRows(const CancellationToken& cancelToken, std::function<void(float)> progressCallback,
+                            size_t rowLimit)
+{
+    uint64_t totalBytes = m_pieceTable.GetSize();
+    if (totalBytes == 0) {
+        m_fullyIndexed = true;
+        if (progressCallback) progressCallback(1.0f);
+        return true; 
+    }
+
+    // Iterate through all pieces
+    const auto& pieces = m_pieceTable.GetPieces();
+    const auto& file = m_pieceTable.GetOriginalFile();
+    const auto& addBuf = m_pieceTable.GetAddBuffer();
+    const uint16_t delimiter = (uint16_t)m_delimiter;
+    const CsvDialect& dialect = *m_dialect;
+
+    // Rows are published, progress reported and cancellation checked once per block
+    const uint64_t blockSize = 1024 * 1024;
+    std::vector<uint64_t> batch;
+    std::vector<size_t> batchColumns; // Column count of each row finished in this block
+    
+    auto publish = [&](uint64_t indexedBytes, const CsvScanState& scanState) {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        AddColumnStatsLocked(m_rowOffsets.size() - 1, batchColumns);
+        m_rowOffsets.insert(m_rowOffsets.end(), batch.begin(), batch.end());
+        m_indexResumeOffset = indexedBytes;
+        m_indexResumeState = scanState;
+        batch.clear();
+        batchColumns.clear();
+
+        if (!m_window.offsets.empty() && indexedBytes >= m_window.offsets.front()) {
+            // The index has reached the window: pin its row numbers, or drop it if the
+            // boundaries disagree (the tail scan had to guess the quote state)
+            if (!m_window.exact) {
+                auto it = std::lower_bound(m_rowOffsets.begin(), m_rowOffsets.end(), m_window.offsets.front());
+                if (it != m_rowOffsets.end() && *it == m_window.offsets.front()) {
+                    m_window.firstRow = it - m_rowOffsets.begin();
+                    m_window.exact = true;
+                } else {
+                    m_window = RowWindow();
+                }
+                m_version++;
             }
+        } else if (!m_window.offsets.empty() && m_rowOffsets.size() - 1 > m_window.firstRow) {
+            // Estimate was too low; keep window rows after the indexed ones
+            m_window.firstRow = m_rowOffsets.size() - 1;
+            m_version++;
+        }
+    };
+
+    CsvScanState state = m_indexResumeState;
+    uint64_t pieceStart = 0;
+
+    for (const auto& piece : pieces) {
+        uint64_t pieceEnd = pieceStart + piece.length;
+        if (m_indexResumeOffset >= pieceEnd) {
+            pieceStart = pieceEnd;
+            continue;
+        }
+
+        const uint8_t* data = (piece.source == Piece::ORIGINAL) 
+            ? file.GetData() + piece.offset
+            : addBuf.data() + piece.offset;
+
+        uint64_t blockStart = m_indexResumeOffset - pieceStart;
+        while (blockStart < piece.length) {
+            uint64_t blockEnd = (std::min)(piece.length, blockStart + blockSize);
+
+            // Row boundaries and column counts in one pass
+            dialect.indexBlock(data, blockStart, blockEnd, pieceStart, delimiter, state, batch, batchColumns);
+
+            uint64_t indexedBytes = pieceStart + blockEnd;
+            publish(indexedBytes, state);
+            if (progressCallback) progressCallback((float)indexedBytes / totalBytes);
+
+            if (cancelToken.IsCancelled() && indexedBytes < totalBytes) {
+                return false;
+            }
+            if (rowLimit != SIZE_MAX && m_rowOffsets.size() > rowLimit && indexedBytes < totalBytes) {
+                return false; // Enough rows for now; the rest is indexed later
+            }
+            blockStart = blockEnd;
+        }
+        pieceStart = pieceEnd;
+    }
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        // Handle trailing newline/empty row logic
+        if (m_rowOffsets.size() > 1 && m_rowOffsets.back() == totalBytes) {
+            m_rowOffsets.pop_back();
         } else {
-            if (c == L'\"') {
-                inQuotes = true;
-            } else if (c == m_delimiter) {
-                cells.push_back(currentCell);
-                currentCell.clear();
-            } else {
-                // If we hit \r or \n here, it's end of row (but usually GetRowRaw strips them?)
-                // Actually GetRowRaw might strip the *row delimiter*, but not in-cell newlines if logic was better.
-                // Current `GetRowRaw` relies on `RebuildRowIndex` which splits on ANY \n.
-                // This is a flaw: `RebuildRowIndex` needs to respect quotes to support newlines in cells.
-                // For this step, I will stick to simple splitting. 
-                // Advanced parsing requires `RebuildRowIndex` to change.
-                currentCell += c;
+            // Last row has no newline of its own
+            AddColumnStatsLocked(m_rowOffsets.size() - 1, std::vector<size_t>(1, state.fields));
+        }
+        m_indexResumeOffset = totalBytes;
+        m_fullyIndexed = true;
+        m_window = RowWindow();
+    }
+    
+    if (progressCallback) progressCallback(1.0f);
+    return true;
+}
+
+void CsvDocument::AddColumnStatsLocked(size_t firstRow, const std::vector<size_t>& columns)
+{
+    for (size_t i = 0; i < columns.size(); ++i) {
+        size_t row = firstRow + i;
+        m_columnHistogram[columns[i]]++;
+        if (row == 0) {
+            m_headerColumns = columns[i];
+        } else if (columns[i] != m_headerColumns) {
+            // Appending while indexing; inserting in the middle after edits
+            m_irregularRows.insert(std::upper_bound(m_irregularRows.begin(), m_irregularRows.end(), row), row);
+        }
+    }
+}
+
+void CsvDocument::RemoveColumnStatsLocked(size_t firstRow, const std::vector<size_t>& columns)
+{
+    for (size_t count : columns) {
+        auto it = m_columnHistogram.find(count);
+        if (it != m_columnHistogram.end() && --it->second == 0) m_columnHistogram.erase(it);
+    }
+    auto first = std::lower_bound(m_irregularRows.begin(), m_irregularRows.end(), firstRow);
+    auto last = std::lower_bound(first, m_irregularRows.end(), firstRow + columns.size());
+    m_irregularRows.erase(first, last);
+}
+
+void CsvDocument::SpliceRowIndex(size_t firstRow, const std::vector<size_t>& oldColumns, uint64_t oldBytes, uint64_t newBytes)
+{
+    const uint64_t unit = GetCodeUnitSize();
+    const uint64_t newSize = m_pieceTable.GetSize();
+    const uint64_t start = (firstRow < m_rowOffsets.size()) ? m_rowOffsets[firstRow] : newSize - newBytes;
+    const uint64_t end = start + newBytes;
+
+    // Scan the new rows with the indexer (they start outside quotes, like any row)
+    std::vector<uint64_t> newStarts;
+    std::vector<size_t> newColumns;
+    CsvScanState state;
+    if (start + unit <= end) {
+        const uint64_t length = end - start;
+        const uint8_t* data = m_pieceTable.GetContiguous(start, length);
+        std::vector<uint8_t> copy;
+        if (!data) {
+            copy.resize((size_t)length);
+            m_pieceTable.CopyRange(start, length, copy.data());
+            data = copy.data();
+        }
+        newStarts.push_back(start);
+        m_dialect->indexBlock(data, 0, length, start, (uint16_t)m_delimiter, state, newStarts, newColumns);
+        if (newStarts.back() == end) newStarts.pop_back(); // The span ends on a newline
+    }
+    if (newStarts.size() > newColumns.size()) {
+        if (end < newSize || state.inQuotes) {
+            // The new text does not end on a row boundary, so rows after it moved too
+            RebuildRowIndex();
+            return;
+        }
+        newColumns.push_back(state.fields); // Last row without a trailing newline
+    }
+
+    // Changing the header's width reclassifies every row
+    if (firstRow == 0 && (newColumns.empty() || newColumns[0] != m_headerColumns)) {
+        RebuildRowIndex();
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+    RemoveColumnStatsLocked(firstRow, oldColumns);
+
+    // Shift everything after the edit
+    size_t oldCount = (std::min)(oldColumns.size(), m_rowOffsets.size() - (std::min)(firstRow, m_rowOffsets.size()));
+    int64_t rowDelta = (int64_t)newStarts.size() - (int64_t)oldCount;
+    int64_t byteDelta = (int64_t)newBytes - (int64_t)oldBytes;
+    for (auto it = std::lower_bound(m_irregularRows.begin(), m_irregularRows.end(), firstRow); it != m_irregularRows.end(); ++it) {
+        *it += rowDelta;
+    }
+    auto eraseFrom = m_rowOffsets.begin() + (std::min)(firstRow, m_rowOffsets.size());
+    auto next = m_rowOffsets.erase(eraseFrom, eraseFrom + oldCount);
+    for (auto it = next; it != m_rowOffsets.end(); ++it) {
+        *it += byteDelta;
+    }
+    m_rowOffsets.insert(m_rowOffsets.begin() + (std::min)(firstRow, m_rowOffsets.size()), newStarts.begin(), newStarts.end());
+
+    AddColumnStatsLocked(firstRow, newColumns);
+    m_indexResumeOffset = newSize;
+
+    if (rowDelta == 0) {
+        m_rowCache.Invalidate(firstRow, newStarts.size());
+        InvalidateFieldCheckpoints(firstRow, newStarts.size());
+    } else {
+        m_version++; // Later rows were renumbered
+    }
+    lock.unlock();
+    UpdateMatches(firstRow, oldCount, newStarts.size());
+}
+
+size_t CsvDocument::GetMaxColumnCount()
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    if (m_columnHistogram.empty()) return 26;
+    return m_columnHistogram.rbegin()->first;
+}
+
+std::map<size_t, size_t> CsvDocument::GetColumnCountHistogram() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_columnHistogram;
+}
+
+size_t CsvDocument::GetHeaderColumnCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_headerColumns;
+}
+
+size_t CsvDocument::GetIrregularRowCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    return m_irregularRows.size();
+}
+
+bool CsvDocument::FindIrregularRow(size_t& row, bool forward) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    if (forward) {
+        auto it = std::upper_bound(m_irregularRows.begin(), m_irregularRows.end(), row);
+        if (it == m_irregularRows.end()) return false;
+        row = *it;
+    } else {
+        auto it = std::lower_bound(m_irregularRows.begin(), m_irregularRows.end(), row);
+        if (it == m_irregularRows.begin()) return false;
+        row = *(--it);
+    }
+    return true;
+}
+
+std::vector<uint8_t> CsvDocument::GetRowRaw(size_t rowIndex)
+{
+    std::vector<uint8_t> result;
+    uint64_t start = 0, end = 0;
+    if (!GetRowSpan(rowIndex, start, end)) return result;
+    
+    // Exclude the newline char(s) from the row data? Usually yes.
+    // Check if previous char was \r if we are at \n (handled in parsing logic usually)
+    
+    if (end > start) {
+        uint64_t dataLen = end - start;
+        result.resize((size_t)dataLen);
+        m_pieceTable.CopyRange(start, dataLen, result.data());
+
+        // Check for newline removal based on encoding
+        if (m_encoding == FileEncoding::UTF8 || m_encoding == FileEncoding::ANSI) {
+            if (!result.empty() && result.back() == '\n') {
+                result.pop_back();
+                if (!result.empty() && result.back() == '\r') result.pop_back();
+            }
+        } else if (m_encoding == FileEncoding::UTF16_LE) {
+            // Newline is 0A 00
+            if (result.size() >= 2 && result[result.size()-2] == 0x0A && result[result.size()-1] == 0x00) {
+                result.pop_back(); result.pop_back();
+                // Check CR: 0D 00
+                if (result.size() >= 2 && result[result.size()-2] == 0x0D && result[result.size()-1] == 0x00) {
+                     result.pop_back(); result.pop_back();
+                }
+            }
+        } else if (m_encoding == FileEncoding::UTF16_BE) {
+            // Newline is 00 0A
+            if (result.size() >= 2 && result[result.size()-2] == 0x00 && result[result.size()-1] == 0x0A) {
+                result.pop_back(); result.pop_back();
+                // Check CR: 00 0D
+                if (result.size() >= 2 && result[result.size()-2] == 0x00 && result[result.size()-1] == 0x0D) {
+                     result.pop_back(); result.pop_back();
+                }
             }
         }
     }
-    cells.push_back(currentCell);
     
-    return cells;
+    return result;
+}
+
+void CsvDocument::SetDelimiter(wchar_t delimiter)
+{
+    StopPrefetch();
+    PauseFindAll();
+    m_delimiter = delimiter;
+    m_dialect = &SelectCsvDialect(m_encoding, m_delimiter);
+    m_version++;
+    RestartFindAll();
+}
+
+void CsvDocument::SetEncoding(FileEncoding encoding)
+{
+    EnsureFullyIndexed(); // The worker scans in the current encoding
+    StopPrefetch();
+    PauseFindAll();
+    m_encoding = encoding;
+    m_dialect = &SelectCsvDialect(m_encoding, m_delimiter);
+    m_version++;
+    RestartFindAll();
+}
+
+const ParsedRow* CsvDocument::GetCachedRow(size_t rowIndex, size_t firstCol, size_t count)
+{
+    const uint64_t version = m_version.load();
+    if (const ParsedRow* row = m_rowCache.Find(rowIndex, version, firstCol, count)) return row;
+    if (!IsRowAvailable(rowIndex)) return nullptr;
+
+    ParsedRow& row = m_rowCache.Insert(rowIndex, version);
+    if (!TakePrefetchedRow(rowIndex, version, firstCol, count, row)) GetParsedRow(rowIndex, row, firstCol, count);
+    return &row;
+}
+
+std::vector<std::wstring> CsvDocument::GetRowCells(size_t rowIndex)
+{
+    ParsedRow& row = ParsedRow::ForThread();
+    if (!GetParsedRow(rowIndex, row)) {
+        return std::vector<std::wstring>(1); // Not available: one empty cell, like an empty row
+    }
+    return row.ToVector();
+}
+
+std::vector<std::wstring> CsvDocument::GetRowCells(size_t rowIndex, size_t firstCol, size_t count)
+{
+    ParsedRow& row = ParsedRow::ForThread();
+    if (!GetParsedRow(rowIndex, row, firstCol, count)) return std::vector<std::wstring>();
+    return row.ToVector();
+}
+
+bool CsvDocument::GetRowView(size_t rowIndex, RowView& view) const
+{
+    return GetRowView(rowIndex, view, 0, SIZE_MAX);
+}
+
+bool CsvDocument::GetRowView(size_t rowIndex, RowView& view, size_t firstCol, size_t count) const
+{
+    view.Clear();
+    view.m_firstColumn = firstCol;
+    if (count == 0) {
+        view.m_complete = false; // No cells parsed, so nothing is known about the rest of the row
+        return IsRowAvailable(rowIndex);
+    }
+    uint64_t start = 0, end = 0;
+    if (!GetRowSpan(rowIndex, start, end)) return false;
+
+    size_t length = (size_t)(end - start);
+    const uint8_t* data = m_pieceTable.GetContiguous(start, length);
+    if (!data && length > 0) {
+        // Row straddles pieces (after edits): parse a private copy
+        view.m_rowCopy.resize(length);
+        m_pieceTable.CopyRange(start, length, reinterpret_cast<uint8_t*>(&view.m_rowCopy[0]));
+        data = reinterpret_cast<const uint8_t*>(view.m_rowCopy.data());
+        view.m_copied = true;
+    }
+    const char* base = reinterpret_cast<const char*>(data);
+    const size_t unit = (size_t)GetCodeUnitSize();
+    // Spans start at even offsets of 2-aligned buffers (the owned string's storage is aligned too)
+    view.m_wide = (m_encoding == FileEncoding::UTF16_LE && sizeof(wchar_t) == 2 && (reinterpret_cast<uintptr_t>(data) & 1) == 0);
+
+    // Exclude the row's own line ending
+    if (length >= unit && CharAt(data, length - unit) == L'\n') {
+        length -= unit;
+        if (length >= unit && CharAt(data, length - unit) == L'\r') length -= unit;
+    }
+
+    // Same state machine as ParseRowCells, on code units. Cells without quotes are
+    // borrowed as-is; quoted ones are unescaped into the view's own buffer.
+    auto finishCell = [&](size_t cellStart, size_t cellEnd, bool quoted) {
+        if (!quoted) {
+            view.m_cells.push_back({ base, cellStart, cellEnd - cellStart, cellStart, cellEnd - cellStart });
+            return;
+        }
+        size_t ownedStart = view.m_owned.size();
+        bool inQuotes = false;
+        for (size_t i = cellStart; i + unit <= cellEnd; i += unit) {
+            if (CharAt(data, i) == L'\"') {
+                if (inQuotes && i + 2 * unit <= cellEnd && CharAt(data, i + unit) == L'\"') {
+                    view.m_owned.append(base + i, unit); // Escaped quote
+                    i += unit;
+                } else {
+                    inQuotes = !inQuotes;
+                }
+            } else {
+                view.m_owned.append(base + i, unit);
+            }
+        }
+        view.m_cells.push_back({ nullptr, ownedStart, view.m_owned.size() - ownedStart, cellStart, cellEnd - cellStart });
+    };
+
+    const uint16_t delimiter = (uint16_t)m_delimiter;
+    const CsvDialect& dialect = *m_dialect;
+    size_t cellStart = 0;
+    size_t field = 0;
+    size_t begin = 0;
+
+    // Wide rows: resume from the nearest checkpoint at or before firstCol (fields start outside quotes)
+    size_t knownCheckpoints = SIZE_MAX; // Looked up on first need
+    thread_local std::vector<uint32_t> foundCheckpoints;
+    foundCheckpoints.clear();
+    if (firstCol >= kFieldCheckpointInterval) {
+        field = FindFieldCheckpoint(rowIndex, firstCol, begin, knownCheckpoints);
+        cellStart = begin;
+    }
+    auto recordCheckpoints = [&]() {
+        if (!foundCheckpoints.empty()) AddFieldCheckpoints(rowIndex, knownCheckpoints, foundCheckpoints);
+    };
+
+    // One field at a time: the dialect's loop finds the delimiter that ends it
+    while (true) {
+        bool quoted = false;
+        size_t end = dialect.fieldEnd(data, cellStart, length, delimiter, quoted);
+        if (field >= firstCol) finishCell(cellStart, end, quoted);
+        if (end >= length) break;
+
+        cellStart = end + unit;
+        if (++field % kFieldCheckpointInterval == 0 && cellStart <= UINT32_MAX) {
+            size_t unused = 0;
+            if (knownCheckpoints == SIZE_MAX) FindFieldCheckpoint(rowIndex, 0, unused, knownCheckpoints);
+            if (field / kFieldCheckpointInterval > knownCheckpoints) foundCheckpoints.push_back((uint32_t)cellStart);
+        }
+        if (field >= firstCol && field - firstCol >= count) {
+            view.m_complete = false;
+            recordCheckpoints();
+            return true;
+        }
+    }
+    recordCheckpoints();
+    return true;
+}
+
+size_t CsvDocument::FindFieldCheckpoint(size_t rowIndex, size_t field, size_t& offset, size_t& known) const
+{
+    std::lock_guard<std::mutex> lock(m_checkpointMutex);
+    if (m_checkpointVersion != m_version.load()) {
+        m_fieldCheckpoints.clear();
+        m_checkpointBytes = 0;
+        m_checkpointVersion = m_version.load();
+    }
+    offset = 0;
+    known = 0;
+    auto it = m_fieldCheckpoints.find(rowIndex);
+    if (it == m_fieldCheckpoints.end()) return 0;
+
+    known = it->second.size();
+    size_t k = (std::min)(field / kFieldCheckpointInterval, known);
+    if (k == 0) return 0;
+    offset = it->second[k - 1];
+    return k * kFieldCheckpointInterval;
+}
+
+void CsvDocument::AddFieldCheckpoints(size_t rowIndex, size_t known, const std::vector<uint32_t>& found) const
+{
+    std::lock_guard<std::mutex> lock(m_checkpointMutex);
+    if (m_checkpointVersion != m_version.load()) return; // Found under an older index
+
+    std::vector<uint32_t>& checkpoints = m_fieldCheckpoints[rowIndex];
+    if (checkpoints.size() != known) return; // Another thread got there first
+    if (m_checkpointBytes + found.size() * sizeof(uint32_t) > kFieldCheckpointBudget) {
+        // Over budget: start over rather than track recency for every row
+        m_fieldCheckpoints.clear();
+        m_checkpointBytes = 0;
+        return;
+    }
+    checkpoints.insert(checkpoints.end(), found.begin(), found.end());
+    m_checkpointBytes += found.size() * sizeof(uint32_t);
+}
+
+void CsvDocument::InvalidateFieldCheckpoints(size_t firstRow, size_t count)
+{
+    std::lock_guard<std::mutex> lock(m_checkpointMutex);
+    for (size_t row = firstRow; row < firstRow + count; ++row) {
+        auto it = m_fieldCheckpoints.find(row);
+        if (it == m_fieldCheckpoints.end()) continue;
+        m_checkpointBytes -= it->second.size() * sizeof(uint32_t);
+        m_fieldCheckpoints.erase(it);
+    }
+}
+
+size_t CsvDocument::GetFieldCheckpointBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_checkpointMutex);
+    return m_checkpointBytes;
+}
+
+void CsvDocument::DropFieldCheckpoints()
+{
+    std::lock_guard<std::mutex> lock(m_checkpointMutex);
+    std::unordered_map<size_t, std::vector<uint32_t>>().swap(m_fieldCheckpoints); // Release the buckets too
+    m_checkpointBytes = 0;
+}
+
+std::wstring CsvDocument::DecodeCell(std::string_view cell) const
+{
+    std::wstring result;
+    DecodeCell(cell, result);
+    return result;
+}
+
+void CsvDocument::DecodeCell(std::string_view cell, std::wstring& out) const
+{
+    out.clear();
+    AppendDecoded(reinterpret_cast<const uint8_t*>(cell.data()), cell.size(), out);
+}
+
+bool CsvDocument::GetParsedRow(size_t rowIndex, ParsedRow& row, size_t firstCol, size_t count) const
+{
+    row.Clear();
+    thread_local RowView view;
+    if (!GetRowView(rowIndex, view, firstCol, count)) return false;
+    row.m_firstColumn = view.GetFirstColumn();
+    row.m_complete = view.IsComplete();
+
+    for (size_t i = 0; i < view.GetCellCount(); ++i) {
+        if (view.HasWideCells()) {
+            row.m_chars.append(view.GetWideCell(i));
+        } else {
+            std::string_view cell = view.GetCell(i);
+            AppendDecoded(reinterpret_cast<const uint8_t*>(cell.data()), cell.size(), row.m_chars);
+        }
+        row.EndCell();
+    }
+    return true;
 }
 
 void CsvDocument::DeleteRow(size_t rowIndex)
 {
+    rowIndex = EnsureFullyIndexed(rowIndex);
+    StopPrefetch();
     if (rowIndex >= m_rowOffsets.size()) return;
 
     uint64_t startOffset = m_rowOffsets[rowIndex];
@@ -573,318 +1487,1048 @@ void CsvDocument::DeleteRow(size_t rowIndex)
     
     uint64_t length = endOffset - startOffset;
     if (length > 0) {
+        RowView view;
+        GetRowView(rowIndex, view);
+        size_t oldColumns = view.GetCellCount();
+        PauseFindAll();
         m_pieceTable.Delete(startOffset, length);
-        RebuildRowIndex(); // Re-index after structural change
+        SpliceRowIndex(rowIndex, std::vector<size_t>(1, oldColumns), length, 0);
     }
 }
 
 void CsvDocument::UpdateCell(size_t row, size_t col, const std::wstring& value)
 {
-    // 1. Get current row content
-    // This is expensive: we need to parse the row again to find the cell's byte range
-    // Then delete that range, insert new value (encoded).
-    
-    // Simplification for prototype:
-    // Reconstruct the ENTIRE row with the new cell value and replace the whole row.
-    
-    auto cells = GetRowCells(row);
-    if (col >= cells.size()) {
-        // Pad with empty cells?
+    row = EnsureFullyIndexed(row);
+    StopPrefetch();
+    
+    // Locate just the target cell's bytes (quotes included); far-right cells start from a field checkpoint
+    uint64_t rowStart = 0, rowEnd = 0;
+    if (!GetRowSpan(row, rowStart, rowEnd)) return;
+    RowView view;
+    GetRowView(row, view, col, 1);
+    
+    if (view.GetCellCount() == 0) {
+        // The row is too short: pad it out, which changes its column count
+        auto cells = GetRowCells(row);
         while (cells.size() <= col) cells.push_back(L"");
+        cells[col] = value;
+        SetRowCells(row, cells);
+        return;
     }
     
-    cells[col] = value;
+    // Replace only those bytes, quoting the new value if needed. The row keeps its
+    // column count and line ending, so only later row offsets move.
+    std::wstring text;
+    AppendCsvCell(value, text);
+    std::vector<uint8_t> bytes = EncodeString(text);
     
-    // Reconstruct row string
-    std::wstring newRowStr;
-    for (size_t i = 0; i < cells.size(); ++i) {
-        bool needsQuotes = false;
-        // Check if needs quotes (contains delimiter, quote, or newline)
-        if (cells[i].find(m_delimiter) != std::wstring::npos || 
-            cells[i].find(L'"') != std::wstring::npos ||
-            cells[i].find(L'\n') != std::wstring::npos) {
-            needsQuotes = true;
+    const RowView::Cell& cell = view.m_cells[0];
+    uint64_t cellStart = rowStart + cell.rawOffset;
+    PauseFindAll();
+    m_pieceTable.Delete(cellStart, cell.rawLength);
+    m_pieceTable.Insert(cellStart, bytes.data(), bytes.size());
+    
+    ShiftRowsAfter(row, (int64_t)bytes.size() - (int64_t)cell.rawLength);
+}
+
+void CsvDocument::ShiftRowsAfter(size_t rowIndex, int64_t byteDelta)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        for (size_t r = rowIndex + 1; r < m_rowOffsets.size(); ++r) {
+            m_rowOffsets[r] += byteDelta;
         }
-        
-        if (needsQuotes) {
-            newRowStr += L'"';
-            // Escape quotes
-            std::wstring& cell = cells[i];
-            for (wchar_t c : cell) {
-                if (c == L'"') newRowStr += L"\"\"";
-                else newRowStr += c;
+        m_indexResumeOffset = m_pieceTable.GetSize();
+    }
+    m_rowCache.Invalidate(rowIndex, 1);
+    InvalidateFieldCheckpoints(rowIndex, 1);
+    UpdateMatches(rowIndex, 1, 1);
+}
+
+void CsvDocument::InsertRow(size_t rowIndex, const std::vector<std::wstring>& values)
+{
+    rowIndex = EnsureFullyIndexed(rowIndex);
+    StopPrefetch();
+
+    // Calculate Offset first to check if we need to prepend newline
+    uint64_t insertOffset = 0;
+    bool needsPrependNewline = false;
+    
+    if (rowIndex < m_rowOffsets.size()) {
+        insertOffset = m_rowOffsets[rowIndex];
+    } else {
+        insertOffset = m_pieceTable.GetSize();
+        const uint64_t unit = GetCodeUnitSize();
+        if (insertOffset >= unit) {
+            uint8_t last[2] = { 0, 0 };
+            m_pieceTable.CopyRange(insertOffset - unit, unit, last);
+            if (CharAt(last, 0) != L'\n') {
+                needsPrependNewline = true;
             }
-            newRowStr += L'"';
-        } else {
-            newRowStr += cells[i];
         }
-        
-        if (i < cells.size() - 1) newRowStr += m_delimiter;
     }
+
+    // Construct row string
+    std::wstring newRowStr;
     
-    // Add newline
+    if (needsPrependNewline) {
+        newRowStr += GetLineEndingStr();
+    }
+    newRowStr += ConstructRowString(values);
+    
+    // Always append newline at end of inserted row (standard CSV row behavior)
+    // If we inserted IN BETWEEN, the previous row ends with \n. We insert "RowContent\n".
+    // Next row starts after our \n. Correct.
     newRowStr += GetLineEndingStr(); 
+    
+    std::vector<uint8_t> bytes = EncodeString(newRowStr);
+    
+    // Rows whose bytes change: none, or the old last row when it gains a newline
+    size_t firstRow = (std::min)(rowIndex, m_rowOffsets.size());
+    std::vector<size_t> oldColumns;
+    uint64_t oldBytes = 0;
+    if (needsPrependNewline && !m_rowOffsets.empty()) {
+        firstRow = m_rowOffsets.size() - 1;
+        RowView view;
+        GetRowView(firstRow, view);
+        oldColumns.push_back(view.GetCellCount());
+        oldBytes = insertOffset - m_rowOffsets[firstRow];
+    }
+
+    Snapshot(); // Save before modification
+    PauseFindAll();
+
+    m_pieceTable.Insert(insertOffset, (const uint8_t*)bytes.data(), bytes.size());
+    SpliceRowIndex(firstRow, oldColumns, oldBytes, oldBytes + bytes.size());
+}
 
-    // Encode to bytes
-    // Simple UTF8 for now
-    std::string bytes;
-    if (!newRowStr.empty()) {
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), NULL, 0, NULL, NULL);
-        bytes.resize(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), &bytes[0], size_needed, NULL, NULL);
+void CsvDocument::Snapshot()
+{
+    StopPrefetch(); // The worker reads the piece table that is about to change
+    HistoryState state;
+    state.pieces = m_pieceTable.GetPieces();
+    m_undoStack.push_back(state);
+    
+    // Clear redo stack on new action
+    m_redoStack.clear();
+    
+    // Cap history size? For now unlimited or 100
+    if (m_undoStack.size() > 100) {
+        m_undoStack.erase(m_undoStack.begin());
     }
+}
+
+void CsvDocument::Undo()
+{
+    if (m_undoStack.empty()) return;
+    EnsureFullyIndexed();
     
-    // Replace old row
-    uint64_t startOffset = m_rowOffsets[row];
-    uint64_t endOffset = (row + 1 < m_rowOffsets.size()) ? m_rowOffsets[row + 1] : m_pieceTable.GetSize();
+    // Save current to Redo
+    HistoryState current;
+    current.pieces = m_pieceTable.GetPieces();
+    m_redoStack.push_back(current);
     
-    m_pieceTable.Delete(startOffset, endOffset - startOffset);
-    m_pieceTable.Insert(startOffset, (const uint8_t*)bytes.data(), bytes.size());
+    // Restore
+    HistoryState match = m_undoStack.back();
+    m_undoStack.pop_back();
+    
+    StopPrefetch();
+    PauseFindAll();
+    m_pieceTable.SetPieces(match.pieces);
+    RebuildRowIndex();
+}
+
+void CsvDocument::Redo()
+{
+    if (m_redoStack.empty()) return;
+    EnsureFullyIndexed();
+    
+    // Save current to Undo
+    HistoryState current;
+    current.pieces = m_pieceTable.GetPieces();
+    m_undoStack.push_back(current);
+    
+    // Restore
+    HistoryState match = m_redoStack.back();
+    m_redoStack.pop_back();
     
+    StopPrefetch();
+    PauseFindAll();
+    m_pieceTable.SetPieces(match.pieces);
     RebuildRowIndex();
 }
 
-void CsvDocument::InsertRow(size_t rowIndex, const std::vector<std::wstring>& values)
+void CsvDocument::ClearHistory()
+{
+    m_undoStack.clear();
+    m_redoStack.clear();
+}
+
+bool CsvDocument::CanUndo() const { return !m_undoStack.empty(); }
+bool CsvDocument::CanRedo() const { return !m_redoStack.empty(); }
+
+
+// Ignoring case, 'query' is already folded and 'text' is folded here
+static bool CellMatches(std::wstring& text, const std::wstring& query,
+                        const CsvDocument::SearchOptions& options, const std::wregex& regexPattern)
+{
+    if (options.mode == CsvDocument::SearchMode::Regex) return std::regex_search(text, regexPattern);
+    if (!options.matchCase) CaseFold::FoldInPlace(text);
+    if (options.mode == CsvDocument::SearchMode::Contains) return text.find(query) != std::wstring::npos;
+    if (options.mode == CsvDocument::SearchMode::Exact) return text == query;
+    return false;
+}
+
+// Whether a search scope (empty: everything) covers cell (row, col)
+static bool ScopeContains(const std::vector<CsvDocument::CellRange>& scope, size_t row, size_t col)
+{
+    if (scope.empty()) return true;
+    for (const auto& range : scope) {
+        if (row >= range.firstRow && row <= range.lastRow && col >= range.firstCol && col <= range.lastCol) return true;
+    }
+    return false;
+}
+
+// Columns [firstCol, lastCol] spanned by the ranges covering 'row'; false if none does
+static bool ScopeColumns(const std::vector<CsvDocument::CellRange>& scope, size_t row, size_t& firstCol, size_t& lastCol)
+{
+    firstCol = 0;
+    lastCol = SIZE_MAX;
+    if (scope.empty()) return true;
+    bool covered = false;
+    for (const auto& range : scope) {
+        if (row < range.firstRow || row > range.lastRow) continue;
+        firstCol = covered ? (std::min)(firstCol, range.firstCol) : range.firstCol;
+        lastCol = covered ? (std::max)(lastCol, range.lastCol) : range.lastCol;
+        covered = true;
+    }
+    return covered;
+}
+
+// Clips rows [rowBegin, rowEnd) to the rows the scope spans
+static void ClipToScope(const std::vector<CsvDocument::CellRange>& scope, size_t& rowBegin, size_t& rowEnd)
+{
+    if (scope.empty()) return;
+    size_t first = SIZE_MAX, last = 0;
+    for (const auto& range : scope) {
+        first = (std::min)(first, range.firstRow);
+        last = (std::max)(last, range.lastRow);
+    }
+    rowBegin = (std::max)(rowBegin, first);
+    if (last < SIZE_MAX) rowEnd = (std::min)(rowEnd, last + 1);
+    if (rowEnd < rowBegin) rowEnd = rowBegin;
+}
+
+// The cell's text with the query replaced (every occurrence, or the whole cell in Exact mode);
+// false if it does not match. Ignoring case outside regex mode, 'query' is already folded.
+static bool ReplaceInCell(const std::wstring& text, const std::wstring& query, const std::wstring& replacement,
+                          const CsvDocument::SearchOptions& options, const std::wregex& regexPattern, std::wstring& newText)
+{
+    newText.clear();
+    if (options.mode == CsvDocument::SearchMode::Regex) {
+        if (!std::regex_search(text, regexPattern)) return false;
+        newText = std::regex_replace(text, regexPattern, replacement);
+        return true;
+    }
+    // Folding keeps offsets, so matches found in the folded text are replaced in the original
+    const std::wstring folded = options.matchCase ? std::wstring() : CaseFold::Folded(text);
+    const std::wstring& haystack = options.matchCase ? text : folded;
+    if (options.mode == CsvDocument::SearchMode::Exact) {
+        if (haystack != query) return false;
+        newText = replacement;
+        return true;
+    }
+    size_t pos = haystack.find(query);
+    if (pos == std::wstring::npos) return false;
+    size_t last = 0;
+    for (; pos != std::wstring::npos; pos = haystack.find(query, last)) {
+        newText.append(text, last, pos - last);
+        newText += replacement;
+        last = pos + query.size();
+    }
+    newText.append(text, last, std::wstring::npos);
+    return true;
+}
+
+struct CsvDocument::SearchPlan {
+    std::wstring query;          // Folded when ignoring case outside regex mode
+    SearchOptions options;
+    std::wregex regex;
+    RegexEngine dfa;             // Linear-time matcher for the patterns it supports
+    std::vector<uint8_t> needle; // Encoded query for the byte-level scan, or empty
+    std::vector<uint8_t> foldMask;
+    bool columnScoped = false;   // The scope leaves out some columns
+    size_t startRow = 0;
+    size_t startCol = 0;
+};
+
+bool CsvDocument::PrepareSearch(const std::wstring& query, const SearchOptions& options, SearchPlan& plan)
+{
+    if (query.empty()) return false;
+    plan.query = (options.matchCase || options.mode == SearchMode::Regex) ? query : CaseFold::Folded(query);
+    plan.options = options;
+    
+    // Prepare Regex if needed
+    if (options.mode == SearchMode::Regex) {
+        try {
+            std::regex_constants::syntax_option_type flags = std::regex_constants::icase; // Default icase?
+            if (options.matchCase) flags = std::regex_constants::ECMAScript;
+            else flags = std::regex_constants::ECMAScript | std::regex_constants::icase;
+            
+            plan.regex.assign(query, flags);
+        } catch(...) {
+            return false; // Invalid regex
+        }
+        plan.dfa.Compile(query, !options.matchCase);
+    }
+    EncodeSearchBytes(plan.query, options, plan.needle, plan.foldMask);
+    for (const auto& range : options.scope) {
+        if (range.firstCol > 0 || range.lastCol < SIZE_MAX) plan.columnScoped = true;
+    }
+    return true;
+}
+
+unsigned CsvDocument::GetSearchThreadCount() const
+{
+    unsigned threads = m_searchThreads ? m_searchThreads : std::thread::hardware_concurrency();
+    return threads ? threads : 1;
+}
+
+// Enough chunks to balance the threads, but none so small that handing it out costs more than scanning it
+static size_t RowChunkSize(size_t rows, unsigned threads)
+{
+    const size_t kMinChunkRows = 4096;
+    if (threads < 2 || rows < 2 * kMinChunkRows) return (std::max)(rows, (size_t)1);
+    return (std::max)(kMinChunkRows, rows / ((size_t)threads * 8));
+}
+
+size_t CsvDocument::GetRowChunkCount(size_t rows) const
+{
+    size_t chunkRows = RowChunkSize(rows, GetSearchThreadCount());
+    return (rows + chunkRows - 1) / chunkRows;
+}
+
+void CsvDocument::ForEachRowChunk(size_t rows, const std::function<void(size_t, size_t, size_t)>& fn) const
+{
+    const unsigned threads = GetSearchThreadCount();
+    const size_t chunkRows = RowChunkSize(rows, threads);
+    const size_t chunks = (rows + chunkRows - 1) / chunkRows;
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (size_t k = nextChunk++; k < chunks; k = nextChunk++) fn(k, k * chunkRows, (std::min)(rows, (k + 1) * chunkRows));
+    };
+    if (chunks <= 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < (std::min)((size_t)threads, chunks); ++i) workers.emplace_back(worker);
+    for (auto& thread : workers) thread.join();
+}
+
+bool CsvDocument::Search(const std::wstring& query, size_t& row, size_t& col, const SearchOptions& options)
+{
+    SearchPlan plan;
+    if (!PrepareSearch(query, options, plan)) return false;
+    plan.startRow = row;
+    plan.startCol = col;
+    size_t numRows = GetRowCount();
+
+    // Rows to search: from the start row to the end, or back to the first row
+    if (numRows == 0 || (options.forward && row >= numRows)) return false;
+    size_t rowBegin = options.forward ? row : 0;
+    size_t rowEnd = options.forward ? numRows : (std::min)(row, numRows - 1) + 1;
+    ClipToScope(options.scope, rowBegin, rowEnd);
+    if (rowBegin >= rowEnd) return false;
+
+    // Chunks are numbered in search order and taken in that order. Once chunk k has a match,
+    // later chunks are skipped or stop early; earlier ones still finish, as they take precedence.
+    const size_t rows = rowEnd - rowBegin;
+    std::atomic<size_t> bestChunk(SIZE_MAX);
+    std::vector<std::pair<size_t, size_t>> results(GetRowChunkCount(rows));
+    ForEachRowChunk(rows, [&](size_t k, size_t first, size_t last) {
+        if (k > bestChunk.load()) return;
+        size_t begin = options.forward ? rowBegin + first : rowEnd - last;
+        size_t end = options.forward ? rowBegin + last : rowEnd - first;
+
+        auto stop = [&]() { return bestChunk.load() < k; };
+        auto onMatch = [&](size_t r, size_t c, const RowView&) {
+            results[k] = { r, c };
+            return true;
+        };
+        if (SearchRows(plan, begin, end, stop, onMatch)) {
+            size_t best = bestChunk.load();
+            while (k < best && !bestChunk.compare_exchange_weak(best, k)) {}
+        }
+    });
+
+    if (bestChunk == SIZE_MAX) return false;
+    row = results[bestChunk].first;
+    col = results[bestChunk].second;
+    return true;
+}
+
+bool CsvDocument::SearchRows(const SearchPlan& plan, size_t rowBegin, size_t rowEnd, const std::function<bool()>& stop,
+                             const std::function<bool(size_t, size_t, const RowView&)>& onMatch) const
+{
+    const SearchOptions& options = plan.options;
+
+    // One view and one decode buffer for the whole scan
+    RowView view;
+    std::wstring cellText;
+    RegexEngine dfa = plan.dfa; // This thread's own DFA cache
+
+    const uint8_t* foldMask = plan.foldMask.empty() ? nullptr : plan.foldMask.data();
+    auto cellMatches = [&](std::string_view cell) {
+        if (dfa.IsCompiled()) return RegexMatchesCell(dfa, cell, cellText);
+        // A cell without the query's bytes cannot match: skip decoding it
+        if (!plan.needle.empty()) {
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(cell.data());
+            if (SimdScan::FindSubstring(data, cell.size(), plan.needle.data(), plan.needle.size(), foldMask) == cell.size()) return false;
+        }
+        DecodeCell(cell, cellText);
+        return CellMatches(cellText, plan.query, options, plan.regex);
+    };
+
+    // Checks the cells of row r from column c on (backward: from c down to 0). With a column
+    // scope only the fields up to its last column are parsed, starting at its first.
+    auto searchRow = [&](size_t r, int64_t c) {
+        size_t firstCol = 0, lastCol = SIZE_MAX;
+        if (!ScopeColumns(options.scope, r, firstCol, lastCol)) return false;
+        bool parsed = plan.columnScoped
+            ? GetRowView(r, view, firstCol, lastCol == SIZE_MAX ? SIZE_MAX : lastCol - firstCol + 1)
+            : GetRowView(r, view);
+        if (!parsed) return false;
+        const int64_t first = (int64_t)view.GetFirstColumn();
+        const int64_t end = first + (int64_t)view.GetCellCount();
+        auto check = [&](int64_t col) {
+            return ScopeContains(options.scope, r, (size_t)col) && cellMatches(view.GetCell((size_t)(col - first))) &&
+                   onMatch(r, (size_t)col, view);
+        };
+        if (options.forward) {
+            for (c = (std::max)(c, first); c < end; ++c) {
+                if (check(c)) return true;
+            }
+        } else {
+            if (c >= end) c = end - 1;
+            for (; c >= first; --c) {
+                if (check(c)) return true;
+            }
+        }
+        return false;
+    };
+    auto firstColumn = [&](size_t r) -> int64_t {
+        if (r != plan.startRow) return options.forward ? 0 : INT64_MAX;
+        if (options.includeStart) return (int64_t)plan.startCol;
+        return options.forward ? (int64_t)plan.startCol + 1 : (int64_t)plan.startCol - 1;
+    };
+    auto stopped = [&]() { return stop && stop(); };
+    ClipToScope(options.scope, rowBegin, rowEnd);
+    if (rowBegin >= rowEnd) return false;
+
+    // Byte-level: scan the mapped data for the encoded query and decode only rows that contain it.
+    // A column scope is searched row by row instead, looking only at the bytes of its cells.
+    uint64_t from = 0, to = 0, unused = 0;
+    if (!plan.needle.empty() && !plan.columnScoped && GetRowSpan(rowBegin, from, unused) && GetRowSpan(rowEnd - 1, unused, to)) {
+        uint64_t hit = 0;
+        while (!stopped() && FindBytes(plan.needle, plan.foldMask, from, to, options.forward, hit)) {
+            size_t r = GetRowAtOffset(hit);
+            if (searchRow(r, firstColumn(r))) return true;
+            uint64_t spanStart = 0, spanEnd = 0;
+            if (!GetRowSpan(r, spanStart, spanEnd)) return false;
+            if (options.forward) from = spanEnd;
+            else to = spanStart;
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i < rowEnd - rowBegin; ++i) {
+        if (i % 256 == 0 && stopped()) return false;
+        size_t r = options.forward ? rowBegin + i : rowEnd - 1 - i;
+        if (searchRow(r, firstColumn(r))) return true;
+    }
+    return false;
+}
+
+bool CsvDocument::RegexMatchesCell(RegexEngine& regex, std::string_view cell, std::wstring& scratch) const
+{
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(cell.data());
+    switch (m_encoding) {
+    case FileEncoding::UTF8: return regex.SearchUtf8(data, cell.size());
+    case FileEncoding::UTF16_LE: return regex.SearchUtf16(data, cell.size(), false);
+    case FileEncoding::UTF16_BE: return regex.SearchUtf16(data, cell.size(), true);
+    default:
+        DecodeCell(cell, scratch);
+        return regex.Search(scratch.data(), scratch.size());
+    }
+}
+
+bool CsvDocument::EncodeSearchBytes(const std::wstring& query, const SearchOptions& options, std::vector<uint8_t>& needle,
+                                    std::vector<uint8_t>& foldMask)
+{
+    // Raw bytes equal decoded text only for text without quotes (escaped in quoted cells),
+    // delimiters or line breaks (which split cells), and U+FFFD (stands for invalid bytes)
+    if (options.mode == SearchMode::Regex || m_encoding == FileEncoding::ANSI || !IsFullyIndexed()) return false;
+    for (wchar_t ch : query) {
+        if (ch == L'\"' || ch == m_delimiter || ch == L'\n' || ch == L'\r' || ch == 0xFFFD) return false;
+        // Ignoring case, the scan folds ASCII letters only; other characters must have a single form
+        if (!options.matchCase && CaseFold::HasVariants(ch) && !CaseFold::HasOnlyAsciiVariants(ch)) return false;
+    }
+    needle = EncodeString(query);
+    foldMask.clear();
+    if (!options.matchCase) {
+        // The query is folded: its letters are lowercase. In UTF-8 every byte below 0x80 is an
+        // ASCII character; in UTF-16 it is the low byte of the unit that is folded.
+        foldMask.assign(needle.size(), 0);
+        const size_t unit = (size_t)GetCodeUnitSize();
+        const size_t low = (m_encoding == FileEncoding::UTF16_BE) ? 1 : 0;
+        for (size_t i = 0; i + unit <= needle.size(); i += unit) {
+            bool ascii = (unit == 1) || needle[i + 1 - low] == 0;
+            uint8_t b = needle[i + low];
+            if (ascii && b >= 'a' && b <= 'z') foldMask[i + low] = 0x20;
+        }
+    }
+    return !needle.empty();
+}
+
+bool CsvDocument::FindBytes(const std::vector<uint8_t>& needle, const std::vector<uint8_t>& foldMask, uint64_t from, uint64_t to,
+                            bool forward, uint64_t& found) const
+{
+    const size_t n = needle.size();
+    const uint8_t* mask = foldMask.empty() ? nullptr : foldMask.data();
+    to = (std::min)(to, m_pieceTable.GetSize());
+    if (n == 0 || to < from || to - from < n) return false;
+    const uint64_t unit = GetCodeUnitSize();
+
+    // Occurrences within data[0, length) (at file offset 'base') that start at or after 'minStart'
+    // on a code unit boundary
+    auto searchSpan = [&](const uint8_t* data, uint64_t base, size_t length, uint64_t minStart) {
+        size_t begin = (size_t)(minStart - base);
+        size_t end = length;
+        while (begin < end && end - begin >= n) {
+            size_t span = end - begin;
+            size_t i = forward ? SimdScan::FindSubstring(data + begin, span, needle.data(), n, mask)
+                               : SimdScan::FindLastSubstring(data + begin, span, needle.data(), n, mask);
+            if (i == span) return false;
+            uint64_t offset = base + begin + i;
+            if (offset % unit == 0) {
+                found = offset;
+                return true;
+            }
+            if (forward) begin += i + 1;
+            else end = begin + i + n - 1;
+        }
+        return false;
+    };
+
+    // Each piece is searched in place; matches that cross into the next piece are found in a small
+    // copied window around the boundary, which lies after the piece's own matches.
+    // Only the pieces overlapping [from, to) are visited, found by the piece table's binary search.
+    const size_t firstPiece = m_pieceTable.GetPieceIndex(from);
+    const size_t lastPiece = m_pieceTable.GetPieceIndex(to - 1);
+    std::vector<uint8_t> window;
+
+    for (size_t k = firstPiece; k <= lastPiece; ++k) {
+        size_t p = forward ? k : firstPiece + lastPiece - k;
+        uint64_t pieceStart = m_pieceTable.GetPieceStart(p), pieceEnd = m_pieceTable.GetPieceStart(p + 1);
+        if (pieceEnd <= from || pieceStart >= to) continue;
+        uint64_t segStart = (std::max)(from, pieceStart);
+        uint64_t segEnd = (std::min)(to, pieceEnd);
+
+        auto searchWindow = [&]() {
+            if (n < 2 || segEnd != pieceEnd || pieceEnd >= to) return false;
+            uint64_t winStart = (std::max)(segStart, pieceEnd - (n - 1));
+            uint64_t winEnd = (std::min)(to, pieceEnd + n - 1);
+            window.resize((size_t)(winEnd - winStart));
+            m_pieceTable.CopyRange(winStart, winEnd - winStart, window.data());
+            return searchSpan(window.data(), winStart, window.size(), winStart);
+        };
+        auto searchPiece = [&]() {
+            const uint8_t* data = m_pieceTable.GetContiguous(segStart, segEnd - segStart);
+            return data && searchSpan(data, segStart, (size_t)(segEnd - segStart), segStart);
+        };
+        if (forward ? (searchPiece() || searchWindow()) : (searchWindow() || searchPiece())) return true;
+    }
+    return false;
+}
+
+size_t CsvDocument::GetRowAtOffset(uint64_t offset) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+    size_t indexed = GetIndexedRowCountLocked();
+    auto it = std::upper_bound(m_rowOffsets.begin(), m_rowOffsets.begin() + indexed, offset);
+    return (it == m_rowOffsets.begin()) ? 0 : (size_t)(it - m_rowOffsets.begin() - 1);
+}
+
+bool CsvDocument::StartFindAll(const std::wstring& query, const SearchOptions& options,
+                               std::function<void(size_t)> progressCallback, std::function<void()> completedCallback)
 {
-    // Calculate Offset first to check if we need to prepend newline
-    uint64_t insertOffset = 0;
-    bool needsPrependNewline = false;
-    
-    if (rowIndex < m_rowOffsets.size()) {
-        insertOffset = m_rowOffsets[rowIndex];
-    } else {
-        insertOffset = m_pieceTable.GetSize();
-        if (insertOffset > 0) {
-            uint8_t lastChar = m_pieceTable.GetAt(insertOffset - 1);
-            if (lastChar != '\n') {
-                needsPrependNewline = true;
+    PauseFindAll();
+    auto plan = std::make_shared<SearchPlan>();
+    if (!PrepareSearch(query, options, *plan)) {
+        StopFindAll();
+        return false;
+    }
+    plan->options.forward = true;
+    plan->startRow = SIZE_MAX; // Every cell of every row
+    
+    // A query containing the active one can only match cells the active one matched:
+    // take those (and any it had yet to re-check itself) as the candidates
+    std::vector<std::pair<size_t, size_t>> candidates;
+    size_t candidateEnd = 0;
+    if (m_findAllPlan && options.mode == SearchMode::Contains && m_findAllOptions.mode == SearchMode::Contains &&
+        options.matchCase == m_findAllOptions.matchCase && options.scope == m_findAllOptions.scope &&
+        plan->query.find(m_findAllPlan->query) != std::wstring::npos) {
+        std::lock_guard<std::mutex> lock(m_matchMutex);
+        for (const Match& match : m_matches) {
+            if (candidates.empty() || candidates.back() != std::make_pair(match.row, match.col)) {
+                candidates.emplace_back(match.row, match.col);
             }
         }
+        bool refining = m_refineNext < m_refineCells.size();
+        candidates.insert(candidates.end(), m_refineCells.begin() + m_refineNext, m_refineCells.end());
+        candidateEnd = refining ? m_refineEnd : m_matchedRows;
     }
+    StopFindAll();
+    m_refineCells = std::move(candidates);
+    m_refineEnd = candidateEnd;
+    
+    m_findAllPlan = plan;
+    m_findAllQuery = query;
+    m_findAllOptions = options;
+    m_findAllProgress = progressCallback;
+    m_findAllCompleted = completedCallback;
+    ResumeFindAll();
+    return true;
+}
 
-    // Construct row string
-    std::wstring newRowStr;
-    
-    if (needsPrependNewline) {
-        newRowStr += GetLineEndingStr();
+void CsvDocument::StopFindAll()
+{
+    PauseFindAll();
+    m_findAllPlan.reset();
+    m_findAllProgress = nullptr;
+    m_findAllCompleted = nullptr;
+    m_refineCells.clear();
+    m_refineNext = 0;
+    m_refineEnd = 0;
+    
+    std::lock_guard<std::mutex> lock(m_matchMutex);
+    std::vector<Match>().swap(m_matches);
+    m_matchedRows = 0;
+    m_matchesComplete = false;
+}
+
+void CsvDocument::WaitForFindAll()
+{
+    if (m_findAllThread.joinable()) m_findAllThread.join();
+}
+
+void CsvDocument::PauseFindAll()
+{
+    m_findAllCancel.Cancel();
+    WaitForFindAll();
+}
+
+void CsvDocument::ResumeFindAll()
+{
+    if (!m_findAllPlan || m_findAllThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_matchMutex);
+        if (m_matchesComplete) return;
+    }
+    m_findAllCancel = CancellationToken();
+    CancellationToken token = m_findAllCancel;
+    m_findAllThread = std::thread([this, token]() { RunFindAll(token); });
+}
+
+void CsvDocument::RestartFindAll()
+{
+    if (!m_findAllPlan) return;
+    PauseFindAll();
+    
+    // The encoding or delimiter the byte-level needle was built for may have changed
+    auto plan = std::make_shared<SearchPlan>();
+    PrepareSearch(m_findAllQuery, m_findAllOptions, *plan);
+    plan->options.forward = true;
+    plan->startRow = SIZE_MAX;
+    m_findAllPlan = plan;
+    m_refineCells.clear();
+    m_refineNext = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_matchMutex);
+        m_matches.clear();
+        m_matchedRows = 0;
+        m_matchesComplete = false;
     }
+    ResumeFindAll();
+}
 
-    for (size_t i = 0; i < values.size(); ++i) {
-        bool needsQuotes = false;
-        if (values[i].find(m_delimiter) != std::wstring::npos || 
-            values[i].find(L'"') != std::wstring::npos ||
-            values[i].find(L'\n') != std::wstring::npos) {
-            needsQuotes = true;
+void CsvDocument::RunFindAll(CancellationToken token)
+{
+    const size_t kBatchRows = 4096;
+    const size_t kBatchCells = 4096;
+    auto stop = [&]() { return token.IsCancelled(); };
+    std::vector<Match> found;
+    RowView view;
+    std::wstring text, folded;
+    
+    while (!token.IsCancelled()) {
+        if (m_refineNext < m_refineCells.size()) {
+            // Re-check candidate cells; a batch never ends inside a row, so m_matchedRows stays exact
+            size_t first = m_refineNext;
+            size_t last = (std::min)(m_refineCells.size(), first + kBatchCells);
+            while (last < m_refineCells.size() && m_refineCells[last].first == m_refineCells[last - 1].first) last++;
+            found.clear();
+            for (size_t i = first; i < last && !token.IsCancelled(); ++i) {
+                size_t row = m_refineCells[i].first, col = m_refineCells[i].second;
+                if (GetRowView(row, view, col, 1) && view.GetCellCount() > 0) {
+                    AppendCellMatches(*m_findAllPlan, row, col, view.GetCell(0), text, folded, found);
+                }
+            }
+            if (token.IsCancelled()) return;
+            
+            m_refineNext = last;
+            size_t settled = m_refineEnd;
+            if (last < m_refineCells.size()) {
+                settled = m_refineCells[last].first;
+            } else {
+                m_refineCells.clear();
+                m_refineNext = 0;
+            }
+            size_t count = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_matchMutex);
+                m_matches.insert(m_matches.end(), found.begin(), found.end());
+                m_matchedRows = settled;
+                count = m_matches.size();
+            }
+            if (m_findAllProgress) m_findAllProgress(count);
+            continue;
         }
         
-        if (needsQuotes) {
-            newRowStr += L'"';
-            std::wstring val = values[i];
-            for (wchar_t c : val) {
-                if (c == L'"') newRowStr += L"\"\"";
-                else newRowStr += c;
+        size_t begin = 0, indexed = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_matchMutex);
+            begin = m_matchedRows;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+            indexed = GetIndexedRowCountLocked();
+        }
+        if (begin >= indexed) {
+            if (IsIndexing()) {
+                // Rows are still being published
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                continue;
             }
-            newRowStr += L'"';
-        } else {
-            newRowStr += values[i];
+            if (!IsFullyIndexed()) return; // Partially opened: rows past the index are left to Search
+            {
+                std::lock_guard<std::mutex> lock(m_matchMutex);
+                m_matchesComplete = true;
+            }
+            if (m_findAllCompleted) m_findAllCompleted();
+            return;
         }
         
-        if (i < values.size() - 1) newRowStr += m_delimiter;
-    }
-    
-    // Always append newline at end of inserted row (standard CSV row behavior)
-    // If we inserted IN BETWEEN, the previous row ends with \n. We insert "RowContent\n".
-    // Next row starts after our \n. Correct.
-    newRowStr += GetLineEndingStr(); 
-    
-    // Encode
-    std::string bytes;
-    if (!newRowStr.empty()) {
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), NULL, 0, NULL, NULL);
-        bytes.resize(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), &bytes[0], size_needed, NULL, NULL);
+        size_t end = (std::min)(indexed, begin + kBatchRows);
+        found.clear();
+        CollectMatches(begin, end, stop, found);
+        if (token.IsCancelled()) return; // The batch is scanned again on resume
+        
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_matchMutex);
+            m_matches.insert(m_matches.end(), found.begin(), found.end());
+            m_matchedRows = end;
+            count = m_matches.size();
+        }
+        if (m_findAllProgress) m_findAllProgress(count);
     }
-    
-    Snapshot(); // Save before modification
-
-    m_pieceTable.Insert(insertOffset, (const uint8_t*)bytes.data(), bytes.size());
-    RebuildRowIndex();
 }
 
-void CsvDocument::Snapshot()
+void CsvDocument::CollectMatches(size_t rowBegin, size_t rowEnd, const std::function<bool()>& stop, std::vector<Match>& out) const
 {
-    HistoryState state;
-    state.pieces = m_pieceTable.GetPieces();
-    m_undoStack.push_back(state);
+    const SearchPlan& plan = *m_findAllPlan;
+    std::wstring text, folded;
     
-    // Clear redo stack on new action
-    m_redoStack.clear();
-    
-    // Cap history size? For now unlimited or 100
-    if (m_undoStack.size() > 100) {
-        m_undoStack.erase(m_undoStack.begin());
-    }
+    SearchRows(plan, rowBegin, rowEnd, stop, [&](size_t r, size_t c, const RowView& view) {
+        AppendCellMatches(plan, r, c, view.GetCell(c - view.GetFirstColumn()), text, folded, out);
+        return false; // Every cell
+    });
 }
 
-void CsvDocument::Undo()
+// Spans of the query in one cell. Exact cells are taken as matching; Contains cells may hold none.
+void CsvDocument::AppendCellMatches(const SearchPlan& plan, size_t row, size_t col, std::string_view cell,
+                                    std::wstring& text, std::wstring& folded, std::vector<Match>& out) const
 {
-    if (m_undoStack.empty()) return;
-    
-    // Save current to Redo
-    HistoryState current;
-    current.pieces = m_pieceTable.GetPieces();
-    m_redoStack.push_back(current);
-    
-    // Restore
-    HistoryState match = m_undoStack.back();
-    m_undoStack.pop_back();
-    
-    m_pieceTable.SetPieces(match.pieces);
-    RebuildRowIndex();
+    DecodeCell(cell, text);
+    Match match;
+    match.row = row;
+    match.col = col;
+    if (plan.options.mode == SearchMode::Exact) {
+        match.length = text.size();
+        out.push_back(match);
+    } else if (plan.options.mode == SearchMode::Regex) {
+        for (std::wsregex_iterator it(text.begin(), text.end(), plan.regex), end; it != end; ++it) {
+            match.start = (size_t)it->position();
+            match.length = (size_t)it->length();
+            out.push_back(match);
+        }
+    } else {
+        // Folding keeps offsets, so spans found in the folded text hold for the original
+        const std::wstring* haystack = &text;
+        if (!plan.options.matchCase) {
+            folded = text;
+            CaseFold::FoldInPlace(folded);
+            haystack = &folded;
+        }
+        match.length = plan.query.size();
+        for (size_t pos = haystack->find(plan.query); pos != std::wstring::npos; pos = haystack->find(plan.query, pos + match.length)) {
+            match.start = pos;
+            out.push_back(match);
+        }
+    }
 }
 
-void CsvDocument::Redo()
+void CsvDocument::UpdateMatches(size_t firstRow, size_t oldCount, size_t newCount)
 {
-    if (m_redoStack.empty()) return;
-    
-    // Save current to Undo
-    HistoryState current;
-    current.pieces = m_pieceTable.GetPieces();
-    m_undoStack.push_back(current);
-    
-    // Restore
-    HistoryState match = m_redoStack.back();
-    m_redoStack.pop_back();
+    if (!m_findAllPlan) return;
+    PauseFindAll(); // Normally the edit has already
+    
+    auto rowLess = [](const Match& match, size_t row) { return match.row < row; };
+    size_t rematchEnd = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_matchMutex);
+        auto first = std::lower_bound(m_matches.begin(), m_matches.end(), firstRow, rowLess);
+        auto last = std::lower_bound(first, m_matches.end(), firstRow + oldCount, rowLess);
+        first = m_matches.erase(first, last);
+        int64_t delta = (int64_t)newCount - (int64_t)oldCount;
+        for (auto it = first; it != m_matches.end(); ++it) it->row += delta;
+        
+        // Candidates left from refining are not shifted: the scan takes over from m_matchedRows
+        m_refineCells.clear();
+        m_refineNext = 0;
+        if (m_matchedRows >= firstRow + oldCount) m_matchedRows += delta;
+        else if (m_matchedRows > firstRow) m_matchedRows = firstRow; // The scan stopped inside the edit
+        rematchEnd = (std::min)(firstRow + newCount, m_matchedRows);
+    }
     
-    m_pieceTable.SetPieces(match.pieces);
-    RebuildRowIndex();
+    // Re-match the new rows the scan had already passed; it reaches the others itself
+    if (rematchEnd > firstRow) {
+        std::vector<Match> fresh;
+        CollectMatches(firstRow, rematchEnd, nullptr, fresh);
+        std::lock_guard<std::mutex> lock(m_matchMutex);
+        auto at = std::lower_bound(m_matches.begin(), m_matches.end(), firstRow, rowLess);
+        m_matches.insert(at, fresh.begin(), fresh.end());
+    }
+    if (m_findAllProgress) m_findAllProgress(GetMatchCount());
+    ResumeFindAll();
 }
 
-bool CsvDocument::CanUndo() const { return !m_undoStack.empty(); }
-bool CsvDocument::CanRedo() const { return !m_redoStack.empty(); }
+bool CsvDocument::IsFindAllFor(const std::wstring& query, const SearchOptions& options) const
+{
+    return m_findAllPlan && query == m_findAllQuery && options.matchCase == m_findAllOptions.matchCase &&
+           options.mode == m_findAllOptions.mode && options.scope == m_findAllOptions.scope;
+}
 
+bool CsvDocument::IsFindAllComplete() const
+{
+    std::lock_guard<std::mutex> lock(m_matchMutex);
+    return m_findAllPlan && m_matchesComplete;
+}
 
-// Wait, that's literally what I had. If it failed, maybe I need to be more explicit.
-// Let's use std::tolower from <locale> or just simple loop.
-// Win32 approach:
-// Helper for case-insensitive find (Manual loop to verify correct behavior)
-static bool CaseInsensitiveFindWin32(const std::wstring& haystack, const std::wstring& needle) {
-    if (needle.empty()) return true;
-    if (haystack.size() < needle.size()) return false;
-    for (size_t i = 0; i <= haystack.size() - needle.size(); ++i) {
-        bool match = true;
-        for (size_t j = 0; j < needle.size(); ++j) {
-           if (towlower(haystack[i+j]) != towlower(needle[j])) {
-               match = false;
-               break;
-           }
-        }
-        if (match) return true;
-    }
-    return false;
+size_t CsvDocument::GetMatchCount() const
+{
+    std::lock_guard<std::mutex> lock(m_matchMutex);
+    return m_matches.size();
 }
 
-static bool CaseInsensitiveExact(const std::wstring& a, const std::wstring& b) {
-    if (a.size() != b.size()) return false;
-    for(size_t i=0; i<a.size(); ++i) {
-        if(towlower(a[i]) != towlower(b[i])) return false;
+bool CsvDocument::FindMatch(size_t& row, size_t& col, bool forward, bool includeStart) const
+{
+    std::lock_guard<std::mutex> lock(m_matchMutex);
+    auto cellLess = [](const Match& match, const std::pair<size_t, size_t>& cell) {
+        return std::make_pair(match.row, match.col) < cell;
+    };
+    auto cellGreater = [](const std::pair<size_t, size_t>& cell, const Match& match) {
+        return cell < std::make_pair(match.row, match.col);
+    };
+    const std::pair<size_t, size_t> cell(row, col);
+    
+    if (forward) {
+        // Every row before a listed match has been scanned, so the first one after the cell is the answer
+        auto it = includeStart ? std::lower_bound(m_matches.begin(), m_matches.end(), cell, cellLess)
+                               : std::upper_bound(m_matches.begin(), m_matches.end(), cell, cellGreater);
+        if (it == m_matches.end()) return false;
+        row = it->row;
+        col = it->col;
+        return true;
     }
+    
+    // Rows between the scan's position and the cell could still hold a nearer match
+    if (!m_matchesComplete && row >= m_matchedRows) return false;
+    auto it = includeStart ? std::upper_bound(m_matches.begin(), m_matches.end(), cell, cellGreater)
+                           : std::lower_bound(m_matches.begin(), m_matches.end(), cell, cellLess);
+    if (it == m_matches.begin()) return false;
+    --it;
+    row = it->row;
+    col = it->col;
     return true;
 }
 
-bool CsvDocument::Search(const std::wstring& query, size_t& row, size_t& col, const SearchOptions& options)
+std::vector<CsvDocument::Match> CsvDocument::GetMatches(size_t firstRow, size_t rowCount) const
 {
-    if (query.empty()) return false;
-    
-    size_t startRow = row;
-    size_t startCol = col;
-    size_t numRows = GetRowCount();
+    std::lock_guard<std::mutex> lock(m_matchMutex);
+    auto rowLess = [](const Match& match, size_t row) { return match.row < row; };
+    auto first = std::lower_bound(m_matches.begin(), m_matches.end(), firstRow, rowLess);
+    auto last = std::lower_bound(first, m_matches.end(), firstRow + (std::min)(rowCount, SIZE_MAX - firstRow), rowLess);
+    return std::vector<Match>(first, last);
+}
+
+bool CsvDocument::SearchMany(const std::vector<std::wstring>& patterns, const SearchOptions& options,
+                             std::vector<std::vector<Match>>& hits)
+{
+    hits.assign(patterns.size(), std::vector<Match>());
+    if (options.mode == SearchMode::Regex) return false;
+    std::vector<std::wstring> queries(patterns.size());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        queries[i] = options.matchCase ? patterns[i] : CaseFold::Folded(patterns[i]);
+    }
     
-    // Prepare Regex if needed
-    std::wregex regexPattern;
-    if (options.mode == SearchMode::Regex) {
-        try {
-            std::regex_constants::syntax_option_type flags = std::regex_constants::icase; // Default icase?
-            if (options.matchCase) flags = std::regex_constants::ECMAScript;
-            else flags = std::regex_constants::ECMAScript | std::regex_constants::icase;
-            
-            regexPattern.assign(query, flags);
-        } catch(...) {
-            return false; // Invalid regex
+    // Byte-level if every pattern can be found in the raw bytes (ignoring case, ASCII letters are
+    // folded on both sides). Otherwise each cell is decoded and folded, and scanned as the bytes of its text.
+    std::vector<std::vector<uint8_t>> encoded(queries.size());
+    std::vector<uint8_t> foldMask;
+    bool byteLevel = true;
+    for (size_t i = 0; i < queries.size() && byteLevel; ++i) {
+        if (!queries[i].empty()) byteLevel = EncodeSearchBytes(queries[i], options, encoded[i], foldMask);
+    }
+    if (!byteLevel) {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(queries[i].data());
+            encoded[i].assign(bytes, bytes + queries[i].size() * sizeof(wchar_t));
         }
     }
-
-    if (options.forward) {
-        for (size_t r = startRow; r < numRows; ++r) {
-            auto cells = GetRowCells(r);
-            size_t c = (r == startRow) ? (options.includeStart ? startCol : startCol + 1) : 0;
-            
-            for (; c < cells.size(); ++c) {
-                 bool found = false;
-                 
-                 if (options.mode == SearchMode::Contains) {
-                     if (options.matchCase) {
-                         if (cells[c].find(query) != std::wstring::npos) found = true;
-                     } else {
-                         if (CaseInsensitiveFindWin32(cells[c], query)) found = true;
-                     }
-                 } else if (options.mode == SearchMode::Exact) {
-                     if (options.matchCase) found = (cells[c] == query);
-                     else found = CaseInsensitiveExact(cells[c], query);
-                 } else if (options.mode == SearchMode::Regex) {
-                     if (std::regex_search(cells[c], regexPattern)) found = true;
-                 }
-                 
-                 if (found) {
-                     row = r;
-                     col = c;
-                     return true;
-                 }
+    uint8_t asciiFold[256];
+    for (int b = 0; b < 256; ++b) asciiFold[b] = (uint8_t)((b >= 'A' && b <= 'Z') ? b + 0x20 : b);
+    AhoCorasick automaton;
+    automaton.Build(encoded, (byteLevel && !options.matchCase) ? asciiFold : nullptr);
+    
+    // A hit only says the pattern's bytes occur (in UTF-16 possibly off a code unit boundary);
+    // the decoded cell decides
+    typedef std::vector<std::pair<uint32_t, Match>> Found;
+    auto confirmCell = [&](size_t r, size_t c, const std::wstring& text, const std::vector<uint32_t>& candidates, Found& out) {
+        if (!ScopeContains(options.scope, r, c)) return;
+        for (uint32_t p : candidates) {
+            const std::wstring& query = queries[p];
+            Match match;
+            match.row = r;
+            match.col = c;
+            match.length = query.size();
+            if (options.mode == SearchMode::Exact) {
+                if (text == query) out.emplace_back(p, match);
+                continue;
+            }
+            for (size_t pos = text.find(query); pos != std::wstring::npos; pos = text.find(query, pos + query.size())) {
+                match.start = pos;
+                out.emplace_back(p, match);
             }
         }
-    } else {
-        // Backward
-        for (int r = (int)startRow; r >= 0; --r) {
-            auto cells = GetRowCells(r);
-            int startC = (int)startCol;
-            int c = (r == (int)startRow) ? (options.includeStart ? startC : startC - 1) : (int)cells.size() - 1;
-            
-            for (; c >= 0; --c) {
-                 bool found = false;
-                 if (options.mode == SearchMode::Contains) {
-                     if (options.matchCase) {
-                         if (cells[c].find(query) != std::wstring::npos) found = true;
-                     } else {
-                         if (CaseInsensitiveFindWin32(cells[c], query)) found = true;
-                     }
-                 } else if (options.mode == SearchMode::Exact) {
-                     if (options.matchCase) found = (cells[c] == query);
-                     else found = CaseInsensitiveExact(cells[c], query);
-                 } else if (options.mode == SearchMode::Regex) {
-                     if (std::regex_search(cells[c], regexPattern)) found = true;
-                 }
-                 
-                 if (found) {
-                     row = r;
-                     col = c;
-                     return true;
-                 }
+    };
+    
+    auto searchRows = [&](size_t rowBegin, size_t rowEnd, Found& out) {
+        ClipToScope(options.scope, rowBegin, rowEnd);
+        if (rowBegin >= rowEnd) return;
+        RowView view;
+        std::wstring text;
+        std::vector<uint32_t> candidates;
+        auto decode = [&](size_t c) {
+            DecodeCell(view.GetCell(c), text);
+            if (!options.matchCase) CaseFold::FoldInPlace(text);
+        };
+        
+        if (!byteLevel) {
+            for (size_t r = rowBegin; r < rowEnd; ++r) {
+                if (!GetRowView(r, view)) continue;
+                for (size_t c = 0; c < view.GetCellCount(); ++c) {
+                    if (!ScopeContains(options.scope, r, c)) continue;
+                    decode(c);
+                    uint32_t state = 0;
+                    candidates.clear();
+                    automaton.Scan(reinterpret_cast<const uint8_t*>(text.data()), text.size() * sizeof(wchar_t), state,
+                                   [&](size_t, uint32_t p) { candidates.push_back(p); });
+                    if (candidates.empty()) continue;
+                    std::sort(candidates.begin(), candidates.end());
+                    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+                    confirmCell(r, c, text, candidates, out);
+                }
             }
+            return;
         }
-    }
+        
+        // Rows are collected by the offset where a hit ends, which only grows
+        size_t hitRow = SIZE_MAX;
+        uint64_t hitRowStart = 0, hitRowEnd = 0;
+        auto confirmRow = [&]() {
+            if (hitRow == SIZE_MAX || !GetRowView(hitRow, view)) return;
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            for (size_t c = 0; c < view.GetCellCount(); ++c) {
+                if (!ScopeContains(options.scope, hitRow, c)) continue;
+                decode(c);
+                confirmCell(hitRow, c, text, candidates, out);
+            }
+        };
+        auto onHit = [&](uint64_t end, uint32_t p) {
+            size_t r = (hitRow != SIZE_MAX && end > hitRowStart && end <= hitRowEnd) ? hitRow : GetRowAtOffset(end - 1);
+            if (r != hitRow) {
+                confirmRow();
+                candidates.clear();
+                hitRow = r;
+                if (!GetRowSpan(hitRow, hitRowStart, hitRowEnd)) hitRowEnd = hitRowStart;
+            }
+            candidates.push_back(p);
+        };
+        
+        // Each piece is fed in place; the automaton's state carries matches across piece boundaries
+        uint64_t from = 0, to = 0, unused = 0;
+        if (!GetRowSpan(rowBegin, from, unused) || !GetRowSpan(rowEnd - 1, unused, to)) return;
+        uint32_t state = 0;
+        const size_t pieceCount = m_pieceTable.GetPieces().size();
+        for (size_t p = m_pieceTable.GetPieceIndex(from); p < pieceCount; ++p) {
+            uint64_t pieceStart = m_pieceTable.GetPieceStart(p), pieceEnd = m_pieceTable.GetPieceStart(p + 1);
+            if (pieceStart >= to) break;
+            uint64_t segStart = (std::max)(from, pieceStart);
+            uint64_t segEnd = (std::min)(to, pieceEnd);
+            if (segStart < segEnd) {
+                const uint8_t* data = m_pieceTable.GetContiguous(segStart, segEnd - segStart);
+                if (!data) return;
+                automaton.Scan(data, (size_t)(segEnd - segStart), state,
+                               [&](size_t end, uint32_t pattern) { onHit(segStart + end, pattern); });
+            }
+        }
+        confirmRow();
+    };
     
-    return false;
+    size_t numRows = GetRowCount();
+    if (numRows == 0) return true;
+    std::vector<Found> results(GetRowChunkCount(numRows));
+    ForEachRowChunk(numRows, [&](size_t k, size_t first, size_t end) { searchRows(first, end, results[k]); });
+    
+    // Chunks in row order keep each pattern's list sorted
+    for (const Found& found : results) {
+        for (const auto& hit : found) hits[hit.first].push_back(hit.second);
+    }
+    return true;
 }
 
 bool CsvDocument::Replace(const std::wstring& query, const std::wstring& replacement, size_t& row, size_t& col, const SearchOptions& options)
 {
     // 1. Verify match at row/col
-    if (row >= GetRowCount()) return false;
+    if (row >= GetRowCount() || !ScopeContains(options.scope, row, col)) return false;
     auto cells = GetRowCells(row);
     if (col >= cells.size()) return false;
     
-    std::wstring& cellText = cells[col];
-    bool found = false;
+    const std::wstring& cellText = cells[col];
     
     // Prepare Regex
     std::wregex regexPattern;
@@ -894,81 +2538,10 @@ bool CsvDocument::Replace(const std::wstring& query, const std::wstring& replace
             regexPattern.assign(query, flags);
         } catch(...) { return false; }
     }
-
-    // Check Match
-    if (options.mode == SearchMode::Exact) {
-         if (options.matchCase) found = (cellText == query);
-         else found = CaseInsensitiveExact(cellText, query);
-    } else if (options.mode == SearchMode::Contains) {
-         if (options.matchCase) found = (cellText.find(query) != std::wstring::npos);
-         else found = CaseInsensitiveFindWin32(cellText, query);
-    } else if (options.mode == SearchMode::Regex) {
-         found = std::regex_search(cellText, regexPattern);
-    }
-    
-    if (!found) return false;
-    
-    // Perform Replacement
-    std::wstring newText = cellText;
-    if (options.mode == SearchMode::Exact) {
-        newText = replacement;
-    } else if (options.mode == SearchMode::Regex) {
-        newText = std::regex_replace(cellText, regexPattern, replacement);
-    } else { // Contains
-        // Replace current occurrence? Or all in cell?
-        // Usually "Replace" does "Replace All in Cell" or "Replace First"?
-        // Standard is Replace All occurrences within the target string for that "Replace" action?
-        // Let's do Replace All Occurrences WITHIN cell for 'Contains' mode.
-        // Actually simpler: just find first and replace? 
-        // Let's do ALL in cell logic for simplicity unless user highlights specific part.
-        
-        // Manual string replace
-        // Note: Caseless replace is tricky. std::regex is easier.
-        // If not using regex, implementing caseless replace is pain.
-        // Let's use simple logic: if !CaseSensitive, use regex anyway? 
-        // Or specific loop.
-        
-        if (options.matchCase) {
-             size_t pos = 0;
-             while ((pos = newText.find(query, pos)) != std::wstring::npos) {
-                 newText.replace(pos, query.length(), replacement);
-                 pos += replacement.length();
-             }
-        } else {
-             // Use Regex for case-insensitive non-regex replace
-             // Escape query for regex?
-             // Too complex.
-             // Let's assume naive single replace for now or use regex hack.
-             // Actually, the user asked for "partly match".
-             // Let's iterate.
-             std::wstring lowerQuery = query;
-             for(auto& c : lowerQuery) c = towlower(c);
-             
-             size_t pos = 0;
-             // Naive iteration
-             while (true) {
-                 if (newText.size() < lowerQuery.size()) break;
-                 size_t limit = newText.size() - lowerQuery.size();
-                 if (pos > limit) break;
-
-                 // Scan
-                 size_t foundPos = std::wstring::npos;
-                 for (size_t i = pos; i <= limit; ++i) {
-                     bool m = true;
-                     for(size_t j=0; j<lowerQuery.size(); ++j) {
-                         if(towlower(newText[i+j]) != lowerQuery[j]) { m = false; break; }
-                     }
-                     if (m) { foundPos = i; break; }
-                 }
-                 
-                 if (foundPos == std::wstring::npos) break;
-                 newText.replace(foundPos, query.length(), replacement);
-                 pos = foundPos + replacement.length();
-                 // if (pos > newText.size()) break; // Handled by limit check next iter
-             }
-        }
-    }
+    const bool caseless = !options.matchCase && options.mode != SearchMode::Regex;
     
+    std::wstring newText;
+    if (!ReplaceInCell(cellText, caseless ? CaseFold::Folded(query) : query, replacement, options, regexPattern, newText)) return false;
     if (newText != cellText) {
         UpdateCell(row, col, newText);
         return true;
@@ -976,49 +2549,245 @@ bool CsvDocument::Replace(const std::wstring& query, const std::wstring& replace
     return false;
 }
 
-int CsvDocument::ReplaceAll(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options)
+bool CsvDocument::ReplaceCellBytes(const SearchPlan& plan, const std::wstring& replacement, size_t row, const RowView& view,
+                                   size_t index, uint64_t& offset, uint64_t& length, std::vector<uint8_t>& bytes,
+                                   std::wstring& text, std::wstring& newText)
 {
-    int count = 0;
-    size_t rows = GetRowCount();
+    // The matcher only picks the cells; replacing goes through std::regex in regex mode
+    DecodeCell(view.GetCell(index), text);
+    if (!ReplaceInCell(text, plan.query, replacement, plan.options, plan.regex, newText) || newText == text) return false;
+    uint64_t rowStart = 0, rowEnd = 0;
+    if (!GetRowSpan(row, rowStart, rowEnd)) return false;
+    
+    const RowView::Cell& cell = view.m_cells[index];
+    offset = rowStart + cell.rawOffset;
+    length = cell.rawLength;
+    text.clear();
+    AppendCsvCell(newText, text);
+    bytes = EncodeString(text);
+    return true;
+}
+
+int CsvDocument::ReplaceAll(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options,
+                            std::function<void(float)> progressCallback, CancellationToken cancelToken)
+{
+    EnsureFullyIndexed(); // Edits are located by row offset
+    SearchPlan plan;
+    if (!PrepareSearch(query, options, plan)) return 0;
+    plan.options.forward = true;
+    plan.startRow = SIZE_MAX; // Every cell of every row
+    size_t numRows = GetRowCount();
+    if (numRows == 0) return 0;
+    
+    // 1. Collect: the stored bytes of each changed cell and its new bytes, per chunk of rows
+    struct Batch {
+        std::vector<PieceTable::Edit> edits;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Batch> batches(GetRowChunkCount(numRows));
+    size_t chunksDone = 0;
+    std::mutex progressMutex;
+    auto stop = [&]() { return cancelToken.IsCancelled(); };
+    
+    ForEachRowChunk(numRows, [&](size_t k, size_t first, size_t end) {
+        if (stop()) return;
+        Batch& batch = batches[k];
+        std::wstring text, newText;
+        std::vector<uint8_t> bytes;
+        SearchRows(plan, first, end, stop, [&](size_t r, size_t c, const RowView& view) {
+            uint64_t offset = 0, length = 0;
+            if (ReplaceCellBytes(plan, replacement, r, view, c - view.GetFirstColumn(), offset, length, bytes, text, newText)) {
+                batch.edits.push_back({ offset, length, batch.data.size(), bytes.size() });
+                batch.data.insert(batch.data.end(), bytes.begin(), bytes.end());
+            }
+            return false; // Every cell
+        });
+        if (progressCallback && !stop()) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progressCallback((float)++chunksDone / batches.size());
+        }
+    });
+    if (cancelToken.IsCancelled()) return 0;
+    
+    // Chunks in row order keep the edits sorted by offset
+    std::vector<PieceTable::Edit> edits;
+    std::vector<uint8_t> data;
+    for (Batch& batch : batches) {
+        for (PieceTable::Edit edit : batch.edits) {
+            edit.dataOffset += data.size();
+            edits.push_back(edit);
+        }
+        data.insert(data.end(), batch.data.begin(), batch.data.end());
+        std::vector<uint8_t>().swap(batch.data);
+    }
+    if (edits.empty()) return 0;
     
-    // Iterate ALL cells.
-    for (size_t r = 0; r < rows; ++r) {
-        auto cells = GetRowCells(r);
-        bool rowMod = false;
-        
-        for (size_t c = 0; c < cells.size(); ++c) {
-             size_t tempR = r, tempC = c;
-             // Temporarily use Replace logic per cell
-             // Optimize: Check match first
-             if (Replace(query, replacement, tempR, tempC, options)) {
-                 count++;
-                 // Update local cells copy if we want to continue in same row?
-                 // Replace() calls UpdateCell() which Snapshot()s and modifies PieceTable.
-                 // This is VERY SLOW for ReplaceAll (one snapshot per cell).
-                 // Ideally: Batch edits.
-                 // Current limitation: One undo per ReplaceAll call?
-                 // Or just let it be slow for now. ReplaceAll implementation in PieceTable is better.
-                 // For now, naive loop.
-             }
+    // 2. Apply: one snapshot, one pass over the pieces, one pass over the row offsets.
+    // Rows keep their fields, so the column statistics stand.
+    Snapshot();
+    PauseFindAll();
+    m_pieceTable.ReplaceRanges(edits, data.data(), data.size());
+    {
+        std::unique_lock<std::shared_mutex> lock(m_indexMutex);
+        int64_t delta = 0;
+        size_t e = 0;
+        for (size_t r = 0; r < m_rowOffsets.size(); ++r) {
+            for (; e < edits.size() && edits[e].offset < m_rowOffsets[r]; ++e) {
+                delta += (int64_t)edits[e].dataLength - (int64_t)edits[e].length;
+            }
+            m_rowOffsets[r] += delta;
         }
+        m_indexResumeOffset = m_pieceTable.GetSize();
     }
-    return count;
+    m_version++; // Cached rows and field checkpoints of the edited rows are stale
+    RestartFindAll();
+    return (int)edits.size();
+}
+
+int CsvDocument::ReplaceAllToFile(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options,
+                                  const std::wstring& filePath, bool reopen,
+                                  std::function<void(float)> progressCallback, CancellationToken cancelToken)
+{
+    EnsureFullyIndexed(); // Chunks are cut at row offsets
+    SearchPlan plan;
+    if (!PrepareSearch(query, options, plan)) return -1;
+    plan.options.forward = true;
+    plan.startRow = SIZE_MAX;
+    const size_t numRows = GetRowCount();
+    const uint64_t totalSize = m_pieceTable.GetSize();
+    
+    // Chunks of about kChunkBytes, cut between rows. The first also takes any bytes before row 0
+    // (a BOM), the last any after the last row.
+    const uint64_t kChunkBytes = 4 << 20;
+    std::vector<size_t> chunkFirstRow(1, 0);
+    std::vector<uint64_t> chunkStart(1, 0);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_indexMutex);
+        const size_t indexed = (std::min)(numRows, m_rowOffsets.size());
+        for (size_t r = 0; r < indexed; ) {
+            auto next = std::lower_bound(m_rowOffsets.begin() + r + 1, m_rowOffsets.begin() + indexed,
+                                         m_rowOffsets[r] + kChunkBytes);
+            r = next - m_rowOffsets.begin();
+            if (r < indexed) {
+                chunkFirstRow.push_back(r);
+                chunkStart.push_back(m_rowOffsets[r]);
+            }
+        }
+    }
+    chunkFirstRow.push_back(numRows);
+    chunkStart.push_back(totalSize);
+    const size_t chunks = chunkFirstRow.size() - 1;
+    
+    BufferedWriter writer;
+    if (!writer.Open(filePath)) return -1;
+    
+    // Workers rewrite chunks in order of their index, at most maxInFlight ahead of the writer
+    // (this thread), which takes each finished chunk in turn.
+    const size_t workerCount = (std::min)((size_t)GetSearchThreadCount(), chunks);
+    const size_t maxInFlight = workerCount * 2;
+    std::vector<std::vector<uint8_t>> output(chunks);
+    std::vector<char> ready(chunks, 0);
+    size_t nextChunk = 0;
+    size_t written = 0;
+    bool failed = false;
+    std::atomic<int> changed(0);
+    std::mutex mutex;
+    std::condition_variable wake;
+    auto stop = [&]() { return cancelToken.IsCancelled(); };
+    
+    auto worker = [&]() {
+        std::wstring text, newText;
+        std::vector<uint8_t> encoded;
+        while (true) {
+            size_t k;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return failed || nextChunk >= chunks || nextChunk < written + maxInFlight; });
+                if (failed || nextChunk >= chunks) return;
+                k = nextChunk++;
+            }
+            
+            // Unchanged bytes are copied up to each changed cell, then its new bytes appended
+            std::vector<uint8_t> bytes;
+            bytes.reserve((size_t)(chunkStart[k + 1] - chunkStart[k]));
+            uint64_t copied = chunkStart[k];
+            auto copyTo = [&](uint64_t end) {
+                size_t at = bytes.size();
+                bytes.resize(at + (size_t)(end - copied));
+                m_pieceTable.CopyRange(copied, end - copied, bytes.data() + at);
+                copied = end;
+            };
+            int count = 0;
+            SearchRows(plan, chunkFirstRow[k], chunkFirstRow[k + 1], stop, [&](size_t r, size_t c, const RowView& view) {
+                uint64_t offset = 0, length = 0;
+                if (ReplaceCellBytes(plan, replacement, r, view, c - view.GetFirstColumn(), offset, length, encoded, text, newText)) {
+                    copyTo(offset);
+                    bytes.insert(bytes.end(), encoded.begin(), encoded.end());
+                    copied += length;
+                    count++;
+                }
+                return false; // Every cell
+            });
+            copyTo(chunkStart[k + 1]);
+            changed += count;
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stop()) failed = true;
+                output[k].swap(bytes);
+                ready[k] = 1;
+            }
+            wake.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; ++i) workers.emplace_back(worker);
+    
+    for (size_t k = 0; k < chunks; ++k) {
+        std::vector<uint8_t> bytes;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return failed || ready[k]; });
+            if (failed) break;
+            bytes.swap(output[k]);
+            written = k + 1;
+        }
+        wake.notify_all();
+        if (stop() || !writer.Write(bytes.data(), bytes.size())) {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+            break;
+        }
+        if (progressCallback) progressCallback((float)(k + 1) / chunks);
+    }
+    wake.notify_all();
+    for (auto& thread : workers) thread.join();
+    
+    if (!writer.Close() || failed || stop()) {
+        DeleteFileW(filePath.c_str());
+        return -1;
+    }
+    if (reopen && !Load(filePath)) return -1;
+    return changed;
 }
 
 std::wstring CsvDocument::GetRangeAsText(size_t startRow, size_t startCol, size_t endRow, size_t endCol)
 {
     std::wstring result;
+    size_t rowCount = GetRowCount();
     
-    for (size_t r = startRow; r <= endRow && r < m_rowOffsets.size(); ++r) {
-        auto cells = GetRowCells(r);
+    RowView view;
+    std::wstring cell;
+    for (size_t r = startRow; r <= endRow && r < rowCount; ++r) {
+        GetRowView(r, view, startCol, endCol - startCol + 1); // Wide rows: skip columns left of the range
         
         for (size_t c = startCol; c <= endCol; ++c) {
-            if (c < cells.size()) {
+            if (c - startCol < view.GetCellCount()) {
                 // Determine if we need quoting for clipboard?
                 // Excel puts TSV on clipboard usually.
                 // Let's use Tab (\t) delimiter for clipboard by default as it works best with Excel.
                 
-                std::wstring cell = cells[c];
+                DecodeCell(view.GetCell(c - startCol), cell);
                 bool needsQuotes = false;
                 if (cell.find(L'\t') != std::wstring::npos || cell.find(L'\n') != std::wstring::npos || cell.find(L'"') != std::wstring::npos) {
                     needsQuotes = true;
@@ -1047,48 +2816,45 @@ std::wstring CsvDocument::GetRangeAsText(size_t startRow, size_t startCol, size_
 
 std::wstring CsvDocument::DecodeString(const std::vector<uint8_t>& bytes)
 {
-    if (bytes.empty()) return L"";
+    std::wstring result;
+    AppendDecoded(bytes.data(), bytes.size(), result);
+    return result;
+}
+
+void CsvDocument::AppendDecoded(const uint8_t* data, size_t length, std::wstring& out) const
+{
+    if (length == 0) return;
 
     if (m_encoding == FileEncoding::UTF8) {
-        int wlen = MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<const char*>(bytes.data()), (int)bytes.size(), NULL, 0);
-        if (wlen == 0) return L"";
-        
-        std::wstring result(wlen, 0);
-        MultiByteToWideChar(CP_UTF8, 0, reinterpret_cast<const char*>(bytes.data()), (int)bytes.size(), &result[0], wlen);
-        return result;
+        TextCodec::AppendUtf8(data, length, out);
     } 
-    else if (m_encoding == FileEncoding::UTF16_LE) {
-        if (bytes.size() % 2 != 0) {
-            // Invalid stream size, maybe pad or ignore last byte?
-        }
-        size_t wlen = bytes.size() / 2;
-        std::wstring result(wlen, 0);
-        memcpy(&result[0], bytes.data(), wlen * sizeof(wchar_t));
-        return result;
-    }
-    else if (m_encoding == FileEncoding::UTF16_BE) {
-        size_t wlen = bytes.size() / 2;
-        std::wstring result(wlen, 0);
-        for(size_t i=0; i<wlen; ++i) {
-            uint16_t b1 = bytes[i*2];
-            uint16_t b2 = bytes[i*2+1];
-            // BE: b1 is high byte
-            wchar_t ch = (b1 << 8) | b2;
-            result[i] = ch;
-        }
-        return result;
-    }
-
-    // Fallback to ANSI
-    int wlen = MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(bytes.data()), (int)bytes.size(), NULL, 0);
-    if (wlen == 0) return L"";
-    std::wstring result(wlen, 0);
-    MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(bytes.data()), (int)bytes.size(), &result[0], wlen);
-    return result;
+    else if (m_encoding == FileEncoding::UTF16_LE || m_encoding == FileEncoding::UTF16_BE) {
+        TextCodec::AppendUtf16(data, length, m_encoding == FileEncoding::UTF16_BE, out);
+    }
+    else {
+        // Fallback to ANSI
+        int wlen = MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(data), (int)length, NULL, 0);
+        if (wlen == 0) return;
+        size_t pos = out.size();
+        out.resize(pos + wlen);
+        MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(data), (int)length, &out[pos], wlen);
+    }
+}
+
+void CsvDocument::AppendCellUtf8(std::string_view cell, std::string& out) const
+{
+    if (m_encoding == FileEncoding::UTF8) {
+        out.append(cell.data(), cell.size()); // Already UTF-8
+        return;
+    }
+    std::wstring wide;
+    DecodeCell(cell, wide);
+    TextCodec::AppendAsUtf8(wide.data(), wide.length(), out);
 }
 
 void CsvDocument::PasteCells(size_t startRow, size_t startCol, const std::wstring& text)
 {
+    startRow = EnsureFullyIndexed(startRow);
     Snapshot(); // Save state
 
     if (text.empty()) return;
@@ -1104,12 +2870,11 @@ void CsvDocument::PasteCells(size_t startRow, size_t startCol, const std::wstrin
         }
     }
 
-    std::vector<std::vector<std::wstring>> grid;
-    
-    // Parse Logic
+    // Parse Logic: one arena per pasted row
+    std::vector<ParsedRow> grid;
+    ParsedRow currentRow;
     bool inQuotes = false;
-    std::wstring currentCell;
-    std::vector<std::wstring> currentRow;
+    bool rowHasContent = false;
     
     for (size_t i = 0; i < text.size(); ++i) {
         wchar_t c = text[i];
@@ -1117,60 +2882,63 @@ void CsvDocument::PasteCells(size_t startRow, size_t startCol, const std::wstrin
         if (inQuotes) {
             if (c == L'\"') {
                 if (i + 1 < text.size() && text[i+1] == L'\"') {
-                    currentCell += L'\"';
+                    currentRow.Append(L'\"');
                     i++;
                 } else {
                     inQuotes = false;
                 }
             } else {
-                currentCell += c;
+                currentRow.Append(c);
             }
+            rowHasContent = true;
         } else {
             if (c == L'\"') {
                 inQuotes = true;
+                rowHasContent = true;
             } else if (c == delimiter) {
-                currentRow.push_back(currentCell);
-                currentCell.clear();
+                currentRow.EndCell();
+                rowHasContent = true;
             } else if (c == L'\n') {
-                currentRow.push_back(currentCell);
-                currentCell.clear();
-                grid.push_back(currentRow);
-                currentRow.clear();
+                currentRow.EndCell();
+                grid.push_back(std::move(currentRow));
+                currentRow.Clear();
+                rowHasContent = false;
             } else if (c == L'\r') {
                 // Ignore \r
             } else {
-                currentCell += c;
+                currentRow.Append(c);
+                rowHasContent = true;
             }
         }
     }
-    if (!currentCell.empty() || !currentRow.empty()) {
-        currentRow.push_back(currentCell);
-        grid.push_back(currentRow);
+    if (rowHasContent) {
+        currentRow.EndCell();
+        grid.push_back(std::move(currentRow));
     }
     
     // Apply to Document
+    ParsedRow existing;
+    std::wstring newRowStr;
     for(size_t r = 0; r < grid.size(); ++r) {
         size_t targetRow = startRow + r;
-        
-        std::vector<std::wstring> cells;
-        if (targetRow < GetRowCount()) {
-             cells = GetRowCells(targetRow);
-        }
-        
-        // Resize if needed
-        size_t neededSize = startCol + grid[r].size();
-        if (cells.size() < neededSize) {
-            cells.resize(neededSize, L"");
-        }
-        
-        for(size_t c = 0; c < grid[r].size(); ++c) {
-            cells[startCol + c] = grid[r][c];
-        }
+        const ParsedRow& pasted = grid[r];
         
         if (targetRow < GetRowCount()) {
-             SetRowCells(targetRow, cells);
+            // Merge the pasted cells over the existing row, padding if needed
+            GetParsedRow(targetRow, existing);
+            size_t count = (std::max)(existing.GetCellCount(), startCol + pasted.GetCellCount());
+            newRowStr.clear();
+            for (size_t c = 0; c < count; ++c) {
+                if (c > 0) newRowStr += m_delimiter;
+                if (c >= startCol && c - startCol < pasted.GetCellCount()) AppendCsvCell(pasted.GetCell(c - startCol), newRowStr);
+                else if (c < existing.GetCellCount()) AppendCsvCell(existing.GetCell(c), newRowStr);
+            }
+            newRowStr += GetLineEndingStr();
+            ReplaceRowText(targetRow, newRowStr);
         } else {
-             InsertRow(targetRow, cells);
+            std::vector<std::wstring> cells(startCol);
+            for (size_t c = 0; c < pasted.GetCellCount(); ++c) cells.emplace_back(pasted.GetCell(c));
+            InsertRow(targetRow, cells);
         }
     }
 }
@@ -1180,56 +2948,58 @@ void CsvDocument::SetRowCells(size_t rowIndex, const std::vector<std::wstring>&
     // Reconstruct row string and replace in PieceTable
     std::wstring newRowStr = ConstructRowString(cells);
     newRowStr += GetLineEndingStr(); 
+    ReplaceRowText(rowIndex, newRowStr);
+}
+
+void CsvDocument::ReplaceRowText(size_t rowIndex, const std::wstring& newRowStr)
+{
+    RowView view;
+    GetRowView(rowIndex, view);
+    size_t oldColumns = view.GetCellCount();
     
-    std::string bytes;
-    if (!newRowStr.empty()) {
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), NULL, 0, NULL, NULL);
-        bytes.resize(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, newRowStr.c_str(), (int)newRowStr.length(), &bytes[0], size_needed, NULL, NULL);
-    }
+    std::vector<uint8_t> bytes = EncodeString(newRowStr);
     
     uint64_t startOffset = m_rowOffsets[rowIndex];
     uint64_t endOffset = (rowIndex + 1 < m_rowOffsets.size()) ? m_rowOffsets[rowIndex + 1] : m_pieceTable.GetSize();
     
+    PauseFindAll();
     m_pieceTable.Delete(startOffset, endOffset - startOffset);
     m_pieceTable.Insert(startOffset, (const uint8_t*)bytes.data(), bytes.size());
     
-    RebuildRowIndex();
+    SpliceRowIndex(rowIndex, std::vector<size_t>(1, oldColumns), endOffset - startOffset, bytes.size());
 }
 
 
 bool CsvDocument::Export(const std::wstring& filePath, ExportFormat format)
 {
+    EnsureFullyIndexed();
+
     FILE* f = _wfopen(filePath.c_str(), L"wb");
     if (!f) return false;
 
     std::string content;
+    RowView view;
+    std::string cellUtf8;
     
     if (format == ExportFormat::HTML) {
         content += "<html>\n<body>\n<table border=\"1\">\n";
         size_t rows = GetRowCount();
         for (size_t r = 0; r < rows; ++r) {
             content += "  <tr>\n";
-            auto cells = GetRowCells(r);
-            for (const auto& cell : cells) {
-                // Convert wstring to UTF-8
-                std::string cellUtf8;
-                int len = WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, NULL, 0, NULL, NULL);
-                if (len > 0) {
-                    cellUtf8.resize(len-1);
-                    WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, &cellUtf8[0], len, NULL, NULL);
-                }
+            GetRowView(r, view);
+            for (size_t c = 0; c < view.GetCellCount(); ++c) {
+                cellUtf8.clear();
+                AppendCellUtf8(view.GetCell(c), cellUtf8);
                 
                 // Simple escaping
-                std::string escaped;
-                for(char c : cellUtf8) {
-                    if (c == '<') escaped += "&lt;";
-                    else if (c == '>') escaped += "&gt;";
-                    else if (c == '&') escaped += "&amp;";
-                    else escaped += c;
+                content += "    <td>";
+                for(char ch : cellUtf8) {
+                    if (ch == '<') content += "&lt;";
+                    else if (ch == '>') content += "&gt;";
+                    else if (ch == '&') content += "&amp;";
+                    else content += ch;
                 }
-
-                content += "    <td>" + escaped + "</td>\n";
+                content += "</td>\n";
             }
             content += "  </tr>\n";
         }
@@ -1242,16 +3012,15 @@ bool CsvDocument::Export(const std::wstring& filePath, ExportFormat format)
              fclose(f); return true;
         }
 
-        auto headerCells = GetRowCells(0);
-        size_t cols = headerCells.size();
+        GetRowView(0, view);
+        size_t cols = view.GetCellCount();
         
         // Header
         content += "|";
-        for (const auto& cell : headerCells) {
-             std::string cellUtf8;
-             int len = WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, NULL, 0, NULL, NULL);
-             if (len > 0) { cellUtf8.resize(len-1); WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, &cellUtf8[0], len, NULL, NULL); }
-             content += " " + cellUtf8 + " |";
+        for (size_t c = 0; c < cols; ++c) {
+             content += " ";
+             AppendCellUtf8(view.GetCell(c), content);
+             content += " |";
         }
         content += "\n|";
         for (size_t c = 0; c < cols; ++c) content += " --- |";
@@ -1260,16 +3029,12 @@ bool CsvDocument::Export(const std::wstring& filePath, ExportFormat format)
         // Rows
         for (size_t r = 1; r < rows; ++r) {
             content += "|";
-            auto cells = GetRowCells(r);
-            size_t currentCols = cells.size();
+            GetRowView(r, view);
+            size_t currentCols = view.GetCellCount();
             for (size_t c=0; c<cols; ++c) { // Normalize to header col count
-                std::string cellUtf8;
-                if (c < currentCols) {
-                    const auto& cell = cells[c];
-                    int len = WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, NULL, 0, NULL, NULL);
-                    if (len > 0) { cellUtf8.resize(len-1); WideCharToMultiByte(CP_UTF8, 0, cell.c_str(), -1, &cellUtf8[0], len, NULL, NULL); }
-                }
-                content += " " + cellUtf8 + " |";
+                content += " ";
+                if (c < currentCols) AppendCellUtf8(view.GetCell(c), content);
+                content += " |";
             }
             content += "\n";
         }
@@ -1279,23 +3044,3 @@ bool CsvDocument::Export(const std::wstring& filePath, ExportFormat format)
     fclose(f);
     return true;
 }
-size_t CsvDocument::GetMaxColumnCount()
-{
-    size_t maxCols = 0;
-    size_t rows = GetRowCount();
-    
-    if (rows > 1000) {
-        // Sample
-        for(size_t i=0; i<100; ++i) {
-             size_t c = GetRowCells(i).size();
-             if(c > maxCols) maxCols = c;
-        }
-        return maxCols > 0 ? maxCols : 26;
-    }
-    
-    for (size_t i = 0; i < rows; ++i) {
-        size_t c = GetRowCells(i).size();
-        if (c > maxCols) maxCols = c;
-    }
-    return maxCols > 0 ? maxCols : 26;
-}
\ No newline at end of file
@@ -1,9 +1,23 @@
 #pragma once
 
 #include "PieceTable.h"
+#include "CancellationToken.h"
+#include "RowView.h"
+#include "ParsedRow.h"
+#include "RowCache.h"
+#include "CsvDialect.h"
 #include <vector>
 #include <string>
 #include <functional>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+class RegexEngine;
 
 enum class FileEncoding {
     UTF8,
@@ -23,7 +37,55 @@ public:
     CsvDocument();
     ~CsvDocument();
 
+    // Owns a worker thread and a file mapping, so it is neither copyable nor movable
+    CsvDocument(const CsvDocument&) = delete;
+    CsvDocument& operator=(const CsvDocument&) = delete;
+
     bool Load(const std::wstring& filePath, std::function<void(float)> progressCallback = nullptr);
+
+    // Partial open modes for LoadAsync
+    enum class OpenMode {
+        Full, // Index everything in the background
+        Head, // Index the first 'rowLimit' rows before returning
+        Tail  // Locate the last 'rowLimit' rows by scanning backward from end-of-file
+    };
+    struct LoadOptions {
+        OpenMode mode = OpenMode::Full;
+        size_t rowLimit = 5000;
+        bool continueInBackground = true; // Otherwise the rest is indexed on demand (EnsureFullyIndexed)
+    };
+
+    // Asynchronous Load
+    // Maps the file and returns immediately; rows are indexed on a worker thread and
+    // published in batches, so GetRowCount() grows while indexing.
+    // Callbacks run on the worker thread. 'completedCallback' receives true once the
+    // document is fully indexed, false if the token was cancelled first.
+    bool LoadAsync(const std::wstring& filePath,
+                   std::function<void(float)> progressCallback = nullptr,
+                   std::function<void(bool)> completedCallback = nullptr,
+                   CancellationToken cancelToken = CancellationToken());
+    bool LoadAsync(const std::wstring& filePath,
+                   std::function<void(float)> progressCallback,
+                   std::function<void(bool)> completedCallback,
+                   CancellationToken cancelToken,
+                   const LoadOptions& options);
+    void CancelLoad();
+    void WaitForIndexing();     // Joins the worker (index may be partial if cancelled)
+    void EnsureFullyIndexed();  // Joins the worker and finishes any remaining indexing
+    // Same, and returns the exact number of a row that was addressed by an estimated number
+    size_t EnsureFullyIndexed(size_t rowIndex);
+    bool IsIndexing() const { return m_indexing.load(); }
+    bool IsFullyIndexed() const { return m_fullyIndexed.load(); }
+    // False for rows located ahead of the index (e.g. Tail mode), whose numbers are estimates
+    bool IsRowNumberExact(size_t rowIndex) const;
+    bool IsRowAvailable(size_t rowIndex) const; // Indexed, or inside a located window
+
+    // Approximate random access while indexing: locates rows around 'fraction' of the file
+    // (0..1), resynchronizing to a record boundary, and returns the (estimated) row there.
+    bool SeekToFraction(double fraction, size_t& row);
+    // Exact once indexed; until then extrapolated from sampled row lengths
+    size_t GetEstimatedRowCount() const;
+
     bool Import(const std::wstring& filePath); // Appends to end
     bool Save(const std::wstring& filePath);
     
@@ -42,9 +104,44 @@ public:
     
     // Returns parsed cells as wide strings
     std::vector<std::wstring> GetRowCells(size_t rowIndex);
+    // Only cells [firstCol, firstCol + count): earlier fields are skipped without being
+    // materialized and parsing stops after the last one. Fewer if the row is shorter.
+    std::vector<std::wstring> GetRowCells(size_t rowIndex, size_t firstCol, size_t count);
+
+    // Zero-copy access: fills 'view' with byte spans of the row's cells (document encoding).
+    // Returns false if the row is not available yet.
+    bool GetRowView(size_t rowIndex, RowView& view) const;
+    bool GetRowView(size_t rowIndex, RowView& view, size_t firstCol, size_t count) const;
+    // Decodes the row's cells into 'row', whose arena is reused (no per-cell allocation)
+    bool GetParsedRow(size_t rowIndex, ParsedRow& row, size_t firstCol = 0, size_t count = SIZE_MAX) const;
+    // Decoded row from the LRU row cache, parsed on a miss. nullptr if the row is not available.
+    // The cached row holds at least columns [firstCol, firstCol + count); index it from GetFirstColumn().
+    // The pointer is valid until the next GetCachedRow call or edit. UI thread only.
+    const ParsedRow* GetCachedRow(size_t rowIndex, size_t firstCol = 0, size_t count = SIZE_MAX);
+    size_t GetRowCacheHits() const { return m_rowCache.GetHitCount(); }
+    size_t GetRowCacheMisses() const { return m_rowCache.GetMissCount(); }
+    // Parses rows [firstRow, firstRow + count) on a worker thread, nearest first in the scroll
+    // direction, so GetCachedRow finds them ready. Replaces (cancels) any running prefetch.
+    void PrefetchRows(size_t firstRow, size_t count, bool forward, size_t firstCol = 0, size_t colCount = SIZE_MAX);
+    void WaitForPrefetch();
+    void StopPrefetch(); // Cancels the worker and drops prefetched rows
+    size_t GetPrefetchHits() const { return m_prefetchHits; }
+    // Frees the per-row field checkpoints of wide rows (e.g. when memory runs low); they are rebuilt on access
+    void DropFieldCheckpoints();
+    size_t GetFieldCheckpointBytes() const;
+    // Bumped whenever row numbers or contents may have changed other than by in-place row edits
+    uint64_t GetVersion() const { return m_version.load(); }
+    // Decodes one cell from a RowView
+    std::wstring DecodeCell(std::string_view cell) const;
+    void DecodeCell(std::string_view cell, std::wstring& out) const;
     
-    // Returns max columns across all rows (slow-ish but safe)
-    size_t GetMaxColumnCount();
+    // Column statistics, counted while indexing and kept up to date by edits
+    size_t GetMaxColumnCount(); // Exact over indexed rows, O(1)
+    std::map<size_t, size_t> GetColumnCountHistogram() const; // Column count -> number of rows
+    size_t GetHeaderColumnCount() const;
+    size_t GetIrregularRowCount() const; // Rows whose column count differs from the header
+    // Moves 'row' to the next (or previous) irregular row. Returns false if there is none.
+    bool FindIrregularRow(size_t& row, bool forward = true) const;
 
     // Export range to string (e.g. for clipboard), typically TSV or CSV
     std::wstring GetRangeAsText(size_t startRow, size_t startCol, size_t endRow, size_t endCol);
@@ -52,16 +149,33 @@ public:
 
     // Search & Replace Types
     enum class SearchMode { Contains, Exact, Regex };
+    // Rectangle of cells, bounds inclusive (first <= last): a column (rows 0 to SIZE_MAX), a row
+    // range (columns 0 to SIZE_MAX) or a selection
+    struct CellRange {
+        size_t firstRow = 0;
+        size_t lastRow = SIZE_MAX;
+        size_t firstCol = 0;
+        size_t lastCol = SIZE_MAX;
+        bool operator==(const CellRange& other) const {
+            return firstRow == other.firstRow && lastRow == other.lastRow && firstCol == other.firstCol && lastCol == other.lastCol;
+        }
+    };
     struct SearchOptions {
         bool matchCase = false;
         SearchMode mode = SearchMode::Contains;
         bool forward = true;
         bool includeStart = false;
+        // Only cells in one of these ranges are searched (empty: every cell). Rows outside them are
+        // skipped; in rows inside, fields left of the scope are skipped by counting delimiters
+        // and those right of it are not parsed.
+        std::vector<CellRange> scope;
     };
 
     // Search
     // Updates row/col to match position if found. Returns true if found.
+    // Large row ranges are split into chunks searched in parallel; the first match in search order wins.
     bool Search(const std::wstring& query, size_t& row, size_t& col, const SearchOptions& options);
+    void SetSearchThreadCount(unsigned count) { m_searchThreads = count; } // 0: one per hardware thread
 
     // Replace
     // Replaces match at specific cell if found. Returns true if changed.
@@ -69,12 +183,80 @@ public:
     bool Replace(const std::wstring& query, const std::wstring& replacement, size_t& row, size_t& col, const SearchOptions& options);
     
     // Replace All
-    // Returns number of replacements.
-    int ReplaceAll(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options);
+    // Returns the number of cells changed. One pass over the document (in parallel row chunks)
+    // collects every changed cell; they are then applied as one batch: one undo step, one index update.
+    // 'progressCallback' receives the fraction of rows searched, from the search threads one at a time.
+    // Cancelled before the batch is applied, the document is left unchanged and 0 is returned.
+    int ReplaceAll(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options,
+                   std::function<void(float)> progressCallback = nullptr,
+                   CancellationToken cancelToken = CancellationToken());
+
+    // Replace All into a new file
+    // Streams the document to 'filePath' with every replacement made, leaving this document as it is:
+    // chunks of rows are rewritten in parallel and written in order through a BufferedWriter, with a
+    // bounded number of chunks in flight, so memory stays constant however large the file.
+    // Returns the number of cells changed, or -1 if the file could not be written or the operation
+    // was cancelled (the partial file is deleted). With 'reopen', the new file is then loaded as this document.
+    int ReplaceAllToFile(const std::wstring& query, const std::wstring& replacement, const SearchOptions& options,
+                         const std::wstring& filePath, bool reopen = false,
+                         std::function<void(float)> progressCallback = nullptr,
+                         CancellationToken cancelToken = CancellationToken());
+
+    // Find All
+    // Collects every occurrence on a worker thread into a list sorted by (row, col, start), published
+    // in batches so the count grows while the scan runs. Next/previous are then binary searches.
+    // Edits pause the worker and re-match only the rows they touched; rebuilding the row index
+    // (undo, column edits, delimiter or encoding changes) starts the scan over.
+    // 'progressCallback' receives the match count after each batch (on the worker thread) and each
+    // edit (on the editing thread); 'completedCallback' runs on the worker once every row has been scanned.
+    // Restarting with a Contains query that extends the active one (same case setting) re-checks only
+    // the cells the active one matched, so search-as-you-type narrows instead of rescanning.
+    struct Match {
+        size_t row = 0;
+        size_t col = 0;
+        size_t start = 0;  // Span within the decoded cell text, in code units
+        size_t length = 0;
+    };
+    bool StartFindAll(const std::wstring& query, const SearchOptions& options,
+                      std::function<void(size_t)> progressCallback = nullptr,
+                      std::function<void()> completedCallback = nullptr); // false for an invalid query
+    void StopFindAll(); // Cancels the scan and drops the matches
+    void WaitForFindAll();
+    bool IsFindAllFor(const std::wstring& query, const SearchOptions& options) const;
+    bool IsFindAllComplete() const;
+    size_t GetMatchCount() const;
+    // Moves row/col to the next (or previous) cell holding a match. False if there is none, or if
+    // it may lie in rows the scan has not reached yet (IsFindAllComplete() tells these apart).
+    bool FindMatch(size_t& row, size_t& col, bool forward, bool includeStart = false) const;
+    std::vector<Match> GetMatches(size_t firstRow, size_t rowCount) const;
+    
+    // Search Many
+    // Every occurrence of every pattern in one pass over the file: an Aho-Corasick automaton runs
+    // over the encoded bytes, and only rows it hits in are decoded to confirm. hits[i] lists the
+    // matches of patterns[i] sorted by (row, col, start), so its size is the hit count.
+    // Contains and Exact modes; false for Regex. Large files are split into chunks searched in parallel.
+    bool SearchMany(const std::vector<std::wstring>& patterns, const SearchOptions& options,
+                    std::vector<std::vector<Match>>& hits);
     
     // Configuration
     void SetDelimiter(wchar_t delimiter);
     void SetEncoding(FileEncoding encoding);
+    FileEncoding GetEncoding() const { return m_encoding; }
+
+    // Encoding detection
+    struct EncodingReport {
+        FileEncoding encoding = FileEncoding::UTF8;
+        double confidence = 0.0;              // 0..1
+        bool hasBom = false;
+        bool wholeFile = false;               // Otherwise head, middle and tail samples
+        uint64_t bytesChecked = 0;
+        uint64_t invalidCount = 0;            // Invalid UTF-8 sequences seen
+        std::vector<uint64_t> invalidOffsets; // File offsets of the first of them
+    };
+    // Result of the detection run at load (samples only)
+    const EncodingReport& GetEncodingReport() const { return m_encodingReport; }
+    // Validates the whole file, split across threads, or just the samples. Does not change the encoding.
+    EncodingReport AnalyzeEncoding(bool wholeFile = true) const;
 
 
     // Parsing (Basic)
@@ -100,6 +282,7 @@ private:
 
 private:
     void Snapshot(); // Save current state to Undo Stack
+    void ClearHistory(); // Drop Undo/Redo, e.g. when another file is loaded
     
     // Helpers
     void DetectEncoding();
@@ -107,8 +290,78 @@ private:
     std::wstring GetLineEndingStr() const;
     std::vector<uint8_t> EncodeString(const std::wstring& str);
     std::wstring DecodeString(const std::vector<uint8_t>& bytes);
-    std::vector<std::wstring> ParseRowCells(const std::wstring& rowText);
+    void AppendDecoded(const uint8_t* data, size_t length, std::wstring& out) const;
+    void AppendCellUtf8(std::string_view cell, std::string& out) const;
+    void ParseRowCells(std::wstring_view rowText, ParsedRow& cells) const;
     std::wstring ConstructRowString(const std::vector<std::wstring>& cells);
+    void AppendCsvCell(std::wstring_view cell, std::wstring& out) const; // Quotes if needed
+    void ReplaceRowText(size_t rowIndex, const std::wstring& rowText);
+
+    // Indexing
+    void ResetRowIndex();
+    bool IndexRows(const CancellationToken& cancelToken, std::function<void(float)> progressCallback,
+                   size_t rowLimit = SIZE_MAX); // false if cancelled or stopped at rowLimit
+    void StartIndexingThread(std::function<void(float)> progressCallback, std::function<void(bool)> completedCallback,
+                             CancellationToken cancelToken);
+    void StopIndexing();
+    bool LocateTailRows(size_t rowLimit);
+    void SampleRowLength();
+    uint64_t GetCodeUnitSize() const;
+    uint16_t CharAt(const uint8_t* data, uint64_t pos) const;
+    bool FindQuoteAnchor(const uint8_t* data, uint64_t size, uint64_t from, uint64_t to,
+                         uint64_t& anchor, bool& inQuotes) const;
+    void CollectRowStarts(const uint8_t* data, uint64_t from, uint64_t to, bool inQuotes,
+                          std::vector<uint64_t>& starts) const;
+    size_t GetIndexedRowCountLocked() const;
+    void AddColumnStatsLocked(size_t firstRow, const std::vector<size_t>& columns);
+    void RemoveColumnStatsLocked(size_t firstRow, const std::vector<size_t>& columns);
+    // Incremental re-index after whole rows were replaced in place
+    void SpliceRowIndex(size_t firstRow, const std::vector<size_t>& oldColumns, uint64_t oldBytes, uint64_t newBytes);
+    bool GetRowSpan(size_t rowIndex, uint64_t& start, uint64_t& end) const;
+    // After an edit inside one row that kept its row and column structure
+    void ShiftRowsAfter(size_t rowIndex, int64_t byteDelta);
+    size_t FindFieldCheckpoint(size_t rowIndex, size_t field, size_t& offset, size_t& known) const;
+    void AddFieldCheckpoints(size_t rowIndex, size_t known, const std::vector<uint32_t>& found) const;
+    void InvalidateFieldCheckpoints(size_t firstRow, size_t count);
+    bool TakePrefetchedRow(size_t rowIndex, uint64_t version, size_t firstCol, size_t count, ParsedRow& row);
+    // Compiled query shared by the search workers
+    struct SearchPlan;
+    bool PrepareSearch(const std::wstring& query, const SearchOptions& options, SearchPlan& plan); // false if invalid
+    // Searches rows [rowBegin, rowEnd) in the plan's direction, calling 'onMatch' for each matching cell
+    // until it or 'stop' returns true. Returns true if 'onMatch' did.
+    bool SearchRows(const SearchPlan& plan, size_t rowBegin, size_t rowEnd, const std::function<bool()>& stop,
+                    const std::function<bool(size_t row, size_t col, const RowView& view)>& onMatch) const;
+    // Parallel scans: rows [0, rows) in chunks of at least 4096 rows (one chunk when single-threaded),
+    // taken in order by up to GetSearchThreadCount() threads. fn(k, first, end) handles chunk k,
+    // rows [first, end); with one chunk it runs on this thread.
+    unsigned GetSearchThreadCount() const;
+    size_t GetRowChunkCount(size_t rows) const;
+    void ForEachRowChunk(size_t rows, const std::function<void(size_t chunk, size_t first, size_t end)>& fn) const;
+    // Find All worker control; edits pause it, patch the list and resume it
+    void PauseFindAll();
+    void ResumeFindAll();
+    void RestartFindAll(); // The plan and every match are out of date
+    void RunFindAll(CancellationToken token);
+    // Rows [firstRow, firstRow + oldCount) were replaced by 'newCount' rows
+    void UpdateMatches(size_t firstRow, size_t oldCount, size_t newCount);
+    void CollectMatches(size_t rowBegin, size_t rowEnd, const std::function<bool()>& stop, std::vector<Match>& out) const;
+    void AppendCellMatches(const SearchPlan& plan, size_t row, size_t col, std::string_view cell,
+                           std::wstring& text, std::wstring& folded, std::vector<Match>& out) const;
+    // Replace All: the stored range of cell 'index' of the row and its new bytes (quoted as needed, so
+    // the row keeps its fields and line ending). False if replacing leaves the cell's text as it was.
+    bool ReplaceCellBytes(const SearchPlan& plan, const std::wstring& replacement, size_t row, const RowView& view,
+                          size_t index, uint64_t& offset, uint64_t& length, std::vector<uint8_t>& bytes,
+                          std::wstring& text, std::wstring& newText);
+    // Byte-level search: the query in the document's encoding, if every cell match must contain those bytes.
+    // Ignoring case, 'foldMask' marks the bytes of ASCII letters (see SimdScan::FindSubstring).
+    bool EncodeSearchBytes(const std::wstring& query, const SearchOptions& options, std::vector<uint8_t>& needle,
+                           std::vector<uint8_t>& foldMask);
+    // First (or last) occurrence lying within [from, to), across piece boundaries
+    bool FindBytes(const std::vector<uint8_t>& needle, const std::vector<uint8_t>& foldMask, uint64_t from, uint64_t to,
+                   bool forward, uint64_t& found) const;
+    size_t GetRowAtOffset(uint64_t offset) const; // Indexed rows only
+    // Runs the regex over a RowView cell in the document's encoding, decoding only ANSI
+    bool RegexMatchesCell(RegexEngine& regex, std::string_view cell, std::wstring& scratch) const;
 
     struct HistoryState {
         std::vector<Piece> pieces;
@@ -120,10 +373,83 @@ private:
     PieceTable m_pieceTable;
     std::vector<uint64_t> m_rowOffsets; // Start offset of each row
     
+    // Background indexing
+    mutable std::shared_mutex m_indexMutex; // Guards m_rowOffsets while the worker publishes
+    std::thread m_indexThread;
+    CancellationToken m_indexCancel;
+    std::atomic<bool> m_indexing{false};
+    std::atomic<bool> m_fullyIndexed{true};
+    uint64_t m_indexResumeOffset = 0; // Where a cancelled index pass picks up again
+    CsvScanState m_indexResumeState; // Scanner state at m_indexResumeOffset
+    
+    uint64_t m_sampledBytes = 0; // Row length samples for GetEstimatedRowCount
+    uint64_t m_sampledRows = 0;
+    
+    // Rows located ahead of the index (Tail mode, SeekToFraction). Their row numbers are estimated
+    // until the index reaches the window and pins them down.
+    struct RowWindow {
+        size_t firstRow = 0;           // Row number of offsets[0]
+        bool exact = false;            // firstRow confirmed by the index
+        std::vector<uint64_t> offsets; // Row starts, plus the end of the last row
+    };
+    RowWindow m_window; // Guarded by m_indexMutex
+    
+    // Column statistics (guarded by m_indexMutex)
+    std::map<size_t, size_t> m_columnHistogram;
+    std::vector<size_t> m_irregularRows; // Sorted
+    size_t m_headerColumns = 0;
+    
+    // Decoded rows for painting and editing. Rows rewritten in place are invalidated
+    // individually; anything that renumbers rows bumps m_version instead.
+    RowCache m_rowCache;
+    std::atomic<uint64_t> m_version{0};
+    
+    // Viewport prefetch: rows parsed by the worker wait here until GetCachedRow claims them
+    struct PrefetchedRow {
+        uint64_t version = 0;
+        ParsedRow row;
+    };
+    std::mutex m_prefetchMutex;
+    std::unordered_map<size_t, PrefetchedRow> m_prefetched;
+    std::thread m_prefetchThread;
+    CancellationToken m_prefetchCancel;
+    size_t m_prefetchHits = 0;
+    
+    // Field checkpoints of wide rows, built lazily by GetRowView: entry k-1 is the row-relative
+    // offset of field k * kFieldCheckpointInterval. Cleared when they outgrow their budget.
+    static const size_t kFieldCheckpointInterval = 64;
+    static const size_t kFieldCheckpointBudget = 8 * 1024 * 1024; // Bytes
+    mutable std::mutex m_checkpointMutex;
+    mutable std::unordered_map<size_t, std::vector<uint32_t>> m_fieldCheckpoints;
+    mutable size_t m_checkpointBytes = 0;
+    mutable uint64_t m_checkpointVersion = 0;
+    
+    // Find All: m_matches holds every match in rows [0, m_matchedRows), sorted. The worker appends
+    // a batch at a time; edits pause it and patch the list.
+    std::shared_ptr<SearchPlan> m_findAllPlan; // nullptr when no Find All is active
+    std::wstring m_findAllQuery;
+    SearchOptions m_findAllOptions;
+    std::function<void(size_t)> m_findAllProgress;
+    std::function<void()> m_findAllCompleted;
+    mutable std::mutex m_matchMutex;
+    std::vector<Match> m_matches;   // Guarded by m_matchMutex
+    size_t m_matchedRows = 0;       // Guarded by m_matchMutex
+    bool m_matchesComplete = false; // Guarded by m_matchMutex
+    std::thread m_findAllThread;
+    CancellationToken m_findAllCancel;
+    // Refining: the cells a shorter query matched in rows [0, m_refineEnd), re-checked before the
+    // scan goes on from m_refineEnd. Owned by the worker; others touch them only while it is paused.
+    std::vector<std::pair<size_t, size_t>> m_refineCells; // (row, col), sorted
+    size_t m_refineNext = 0;
+    size_t m_refineEnd = 0;
+    
     // Configuration
     LineEnding m_lineEnding = LineEnding::LF;
     FileEncoding m_encoding = FileEncoding::UTF8;
     wchar_t m_delimiter = L',';
+    const CsvDialect* m_dialect; // Scanning loops for m_encoding and m_delimiter
+    unsigned m_searchThreads = 0;
+    EncodingReport m_encodingReport;
 
     // Helpers
 };
@@ -19,6 +19,25 @@ void EditorState::SetColumnWidth(size_t col, float width) {
     m_colWidths[col] = width;
 }
 
+void EditorState::SetScrollRow(size_t row)
+{
+    if (row != m_scrollRow) {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - m_lastScrollTime).count();
+        double delta = (double)row - (double)m_scrollRow;
+        double instant = delta / (std::max)(seconds, 0.001);
+        int direction = delta > 0 ? 1 : -1;
+        
+        // A pause or a reversal restarts the estimate
+        if (seconds > 0.5 || direction != m_scrollDirection) m_scrollVelocity = instant;
+        else m_scrollVelocity = 0.5 * m_scrollVelocity + 0.5 * instant;
+        
+        m_scrollDirection = direction;
+        m_lastScrollTime = now;
+    }
+    m_scrollRow = row;
+}
+
 void EditorState::SelectCell(size_t row, size_t col, bool multiSelect)
 {
     if (!multiSelect) m_selections.clear();
@@ -3,6 +3,7 @@
 #include <vector>
 #include <map>
 #include <cstdint>
+#include <chrono>
 
 struct CellPos {
     size_t row;
@@ -46,7 +47,10 @@ public:
 
     // Scroll Position
     size_t GetScrollRow() const { return m_scrollRow; }
-    void SetScrollRow(size_t row) { m_scrollRow = row; }
+    void SetScrollRow(size_t row); // Also tracks scroll velocity
+    // Smoothed scroll speed in rows per second (negative = upward) and last direction (-1, 0, 1)
+    double GetScrollVelocity() const { return m_scrollVelocity; }
+    int GetScrollDirection() const { return m_scrollDirection; }
     
     float GetScrollX() const { return m_scrollX; }
     void SetScrollX(float x) { m_scrollX = x; }
@@ -63,6 +67,9 @@ private:
 
     size_t m_scrollRow = 0;
     float m_scrollX = 0.0f;
+    std::chrono::steady_clock::time_point m_lastScrollTime;
+    double m_scrollVelocity = 0.0;
+    int m_scrollDirection = 0;
 
     // Layout
     std::map<size_t, float> m_colWidths;
@@ -7,6 +7,8 @@ Language Localization::s_currentLanguage = Language::English;
 static std::map<StringId, std::wstring> s_stringsJP = {
     { StringId::Menu_File, L"\u30D5\u30A1\u30A4\u30EB(&F)" }, // File
     { StringId::Menu_File_Open, L"\u958B\u304F(&O)...\tCtrl+O" }, // Open
+    { StringId::Menu_File_OpenHead, L"\u5148\u982D\u884C\u3092\u958B\u304F(&H)..." }, // Open Head
+    { StringId::Menu_File_OpenTail, L"\u672B\u5C3E\u884C\u3092\u958B\u304F(&T)..." }, // Open Tail
     { StringId::Menu_File_Reopen, L"\u518D\u8AAD\u307F\u8FBC\u307F(&R)" }, // Reopen
     { StringId::Menu_File_Import, L"\u30A4\u30F3\u30DD\u30FC\u30C8(\u8FFD\u52A0)(&I)..." }, // Import (Append)...
     { StringId::Menu_File_Save, L"\u4FDD\u5B58(&S)\tCtrl+S" }, // Save
@@ -35,6 +37,7 @@ static std::map<StringId, std::wstring> s_stringsJP = {
     { StringId::Menu_Search_FindNext, L"\u6B21\u3092\u691C\u7D22(&N)\tF3" }, // Find Next
     { StringId::Menu_Search_FindPrev, L"\u524D\u3092\u691C\u7D22(&P)\tShift+F3" }, // Find Prev
     { StringId::Menu_Search_Replace, L"\u7F6E\u63DB(&R)...\tCtrl+H" }, // Replace
+    { StringId::Menu_Search_NextMalformed, L"\u6B21\u306E\u4E0D\u6B63\u306A\u884C(&M)" }, // Next Malformed Row
 
     { StringId::Menu_Config, L"\u8A2D\u5B9A(&C)" }, // Config
     { StringId::Menu_Config_Delimiter, L"\u533A\u5207\u308A\u6587\u5B57(&D)" }, // Delimiter
@@ -64,6 +67,7 @@ static std::map<StringId, std::wstring> s_stringsJP = {
     { StringId::Msg_OpenFailed, L"\u30D5\u30A1\u30A4\u30EB\u3092\u958B\u3051\u307E\u305B\u3093\u3067\u3057\u305F\u3002" }, // Failed to open
     { StringId::Msg_SaveSuccess, L"\u4FDD\u5B58\u3057\u307E\u3057\u305F\u3002" }, // Saved
     { StringId::Msg_SaveFailed, L"\u4FDD\u5B58\u306B\u5931\u6557\u3057\u307E\u3057\u305F\u3002" }, // Save failed
+    { StringId::Msg_NoMalformedRows, L"\u4E0D\u6B63\u306A\u884C\u306F\u3042\u308A\u307E\u305B\u3093\u3002" }, // No malformed rows
 
     { StringId::File_Filter_CSV, L"CSV \u30D5\u30A1\u30A4\u30EB" }, // CSV Files
     { StringId::File_Filter_TSV, L"TSV \u30D5\u30A1\u30A4\u30EB" }, // TSV Files
@@ -73,6 +77,8 @@ static std::map<StringId, std::wstring> s_stringsJP = {
 static std::map<StringId, std::wstring> s_stringsEN = {
     { StringId::Menu_File, L"&File" },
     { StringId::Menu_File_Open, L"&Open...\tCtrl+O" },
+    { StringId::Menu_File_OpenHead, L"Open &Head..." },
+    { StringId::Menu_File_OpenTail, L"Open &Tail..." },
     { StringId::Menu_File_Reopen, L"Re&open" },
     { StringId::Menu_File_Import, L"&Import (Append)..." },
     { StringId::Menu_File_Save, L"&Save\tCtrl+S" },
@@ -102,6 +108,7 @@ static std::map<StringId, std::wstring> s_stringsEN = {
     { StringId::Menu_Search_FindNext, L"Find &Next\tF3" },
     { StringId::Menu_Search_FindPrev, L"Find &Previous\tShift+F3" },
     { StringId::Menu_Search_Replace, L"&Replace...\tCtrl+H" },
+    { StringId::Menu_Search_NextMalformed, L"Next &Malformed Row" },
 
     { StringId::Menu_Config, L"&Config" },
     { StringId::Menu_Config_Delimiter, L"&Delimiter" },
@@ -131,6 +138,7 @@ static std::map<StringId, std::wstring> s_stringsEN = {
     { StringId::Msg_OpenFailed, L"Failed to open file." },
     { StringId::Msg_SaveSuccess, L"File saved." },
     { StringId::Msg_SaveFailed, L"Failed to save file." },
+    { StringId::Msg_NoMalformedRows, L"No rows with a different column count than the header." },
 
     { StringId::File_Filter_CSV, L"CSV Files" },
     { StringId::File_Filter_TSV, L"TSV Files" },
@@ -12,6 +12,8 @@ enum class StringId {
     // Menu: File
     Menu_File,
     Menu_File_Open,
+    Menu_File_OpenHead,
+    Menu_File_OpenTail,
     Menu_File_Reopen,
     Menu_File_Import,
     Menu_File_Save,
@@ -42,6 +44,7 @@ enum class StringId {
     Menu_Search_FindNext,
     Menu_Search_FindPrev,
     Menu_Search_Replace,
+    Menu_Search_NextMalformed,
 
     // Menu: Config
     Menu_Config,
@@ -75,6 +78,7 @@ enum class StringId {
     Msg_OpenFailed,
     Msg_SaveSuccess,
     Msg_SaveFailed,
+    Msg_NoMalformedRows,
 
     // File Dialog
     File_Filter_CSV,
@@ -5,6 +5,7 @@
 #include <tchar.h>
 #include <string>
 #include <algorithm>
+#include <cmath>
 #include <commctrl.h>
 #pragma comment(lib, "comctl32.lib")
 
@@ -23,7 +24,7 @@ MainWindow::DocumentTab& MainWindow::GetActiveTab() {
         return empty; 
     }
     if (m_activeTabIndex >= m_tabs.size()) m_activeTabIndex = 0;
-    return m_tabs[m_activeTabIndex];
+    return *m_tabs[m_activeTabIndex];
 }
 
 const MainWindow::DocumentTab& MainWindow::GetActiveTab() const {
@@ -33,18 +34,18 @@ const MainWindow::DocumentTab& MainWindow::GetActiveTab() const {
     }
     auto index = m_activeTabIndex;
     if (index >= m_tabs.size()) index = 0;
-    return m_tabs[index];
+    return *m_tabs[index];
 }
 
 void MainWindow::AddTab(const std::wstring& filePath, bool setActive) {
-    DocumentTab tab;
-    tab.filePath = filePath;
-    tab.title = filePath.empty() ? L"Untitled" : filePath.substr(filePath.find_last_of(L"\\/") + 1);
+    auto tab = std::make_unique<DocumentTab>();
+    tab->filePath = filePath;
+    tab->title = filePath.empty() ? L"Untitled" : filePath.substr(filePath.find_last_of(L"\\/") + 1);
     
     // Initialize default column width in state?
     // tab.state.SetDefaultColWidth(m_defaultColWidth); // If needed
     
-    m_tabs.push_back(tab); // removed std::move for simpler copy, struct is copyable
+    m_tabs.push_back(std::move(tab));
     
     if (setActive) {
         SetActiveTab(m_tabs.size() - 1);
@@ -75,6 +76,7 @@ void MainWindow::SetActiveTab(size_t index) {
         m_activeTabIndex = index;
         if (m_hwnd) {
             UpdateScrollBars();
+            if (m_hProgressBar) ShowWindow(m_hProgressBar, GetActiveTab().document.IsIndexing() ? SW_SHOW : SW_HIDE);
             // UpdateFormulaBar(); // TODO: Add this method to update UI from Model
             SetWindowText(m_hwnd, GetActiveTab().filePath.empty() ? L"CSV Editor - Untitled" : (L"CSV Editor - " + GetActiveTab().filePath).c_str());
             InvalidateRect(m_hwnd, NULL, FALSE);
@@ -167,7 +169,7 @@ bool MainWindow::Create(HINSTANCE hInstance, int nCmdShow)
     return true;
 }
 
-bool MainWindow::OpenFile(const std::wstring& filePath)
+bool MainWindow::OpenFile(const std::wstring& filePath, CsvDocument::OpenMode mode)
 {
     // Reuse current tab if empty/untitled, otherwise add new
     bool reuse = false;
@@ -181,13 +183,43 @@ bool MainWindow::OpenFile(const std::wstring& filePath)
     }
     
     DocumentTab& tab = GetActiveTab();
-    if (tab.document.Load(filePath)) {
+    
+    // Index on a worker thread; progress is marshalled back to the UI thread
+    HWND hwnd = m_hwnd;
+    CsvDocument* document = &tab.document;
+    auto onProgress = [hwnd, document](float progress) {
+        PostMessage(hwnd, WM_APP_LOAD_PROGRESS, (WPARAM)(progress * 100.0f), (LPARAM)document);
+    };
+    auto onCompleted = [hwnd, document](bool finished) {
+        PostMessage(hwnd, WM_APP_LOAD_COMPLETE, (WPARAM)(finished ? TRUE : FALSE), (LPARAM)document);
+    };
+    
+    CsvDocument::LoadOptions options;
+    options.mode = mode;
+    options.rowLimit = (size_t)(std::max)(1, ConfigManager::Instance().GetInt(L"Open", L"PartialRows", 5000));
+    
+    if (tab.document.LoadAsync(filePath, onProgress, onCompleted, CancellationToken(), options)) {
         tab.filePath = filePath;
         tab.title = filePath.empty() ? L"Untitled" : filePath.substr(filePath.find_last_of(L"\\/") + 1);
         tab.state.SetScrollRow(0);
         
+        if (mode == CsvDocument::OpenMode::Tail) {
+            // Start at the last page
+            RECT rc;
+            GetClientRect(m_hwnd, &rc);
+            int visibleRows = (int)((rc.bottom - rc.top - m_headerHeight) / m_rowHeight);
+            size_t rowCount = tab.document.GetRowCount();
+            if (visibleRows > 0 && rowCount > (size_t)visibleRows) {
+                tab.state.SetScrollRow(rowCount - visibleRows);
+            }
+        }
+        
         // m_currentFilePath = filePath; // Deprecated
         SetWindowText(m_hwnd, (L"CSV Editor - " + filePath).c_str());
+        if (m_hProgressBar) {
+            SendMessage(m_hProgressBar, PBM_SETPOS, 0, 0);
+            ShowWindow(m_hProgressBar, tab.document.IsIndexing() ? SW_SHOW : SW_HIDE);
+        }
         UpdateScrollBars();
         InvalidateRect(m_hwnd, NULL, FALSE);
         return true;
@@ -318,6 +350,21 @@ LRESULT MainWindow::HandleMessage(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lP
     case WM_ERASEBKGND:
         return 1; // Prevent flickering
 
+    case WM_COMPACTING:
+        // System memory is low: drop what can be rebuilt on demand
+        for (auto& tab : m_tabs) tab->document.DropFieldCheckpoints();
+        return 0;
+
+    case WM_APP_LOAD_PROGRESS:
+    case WM_APP_LOAD_COMPLETE:
+        OnLoadProgress((CsvDocument*)lParam, (int)wParam, uMsg == WM_APP_LOAD_COMPLETE);
+        return 0;
+
+    case WM_APP_FIND_PROGRESS:
+    case WM_APP_FIND_COMPLETE:
+        OnFindProgress((CsvDocument*)lParam, uMsg == WM_APP_FIND_COMPLETE);
+        return 0;
+
     case WM_DESTROY:
         ConfigManager::Instance().SetFloat(L"Layout", L"RowHeight", m_rowHeight);
         ConfigManager::Instance().SetFloat(L"Layout", L"DefaultColWidth", GetActiveTab().state.GetDefaultColumnWidth());
@@ -340,6 +387,8 @@ void MainWindow::InitializeMenu(HWND hwnd)
     // File Menu
     HMENU hFileMenu = CreatePopupMenu();
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_OPEN, Localization::GetString(StringId::Menu_File_Open));
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_OPEN_HEAD, Localization::GetString(StringId::Menu_File_OpenHead));
+    AppendMenu(hFileMenu, MF_STRING, IDM_FILE_OPEN_TAIL, Localization::GetString(StringId::Menu_File_OpenTail));
     AppendMenu(hFileMenu, MF_STRING | MF_GRAYED, IDM_FILE_REOPEN, Localization::GetString(StringId::Menu_File_Reopen));
     AppendMenu(hFileMenu, MF_STRING, IDM_FILE_IMPORT, Localization::GetString(StringId::Menu_File_Import));
     AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
@@ -374,6 +423,8 @@ void MainWindow::InitializeMenu(HWND hwnd)
     AppendMenu(hSearchMenu, MF_STRING, ID_SEARCH_PREV, Localization::GetString(StringId::Menu_Search_FindPrev));
     AppendMenu(hSearchMenu, MF_SEPARATOR, 0, NULL);
     AppendMenu(hSearchMenu, MF_STRING, ID_SEARCH_REPLACE, Localization::GetString(StringId::Menu_Search_Replace));
+    AppendMenu(hSearchMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(hSearchMenu, MF_STRING, IDM_SEARCH_NEXT_MALFORMED, Localization::GetString(StringId::Menu_Search_NextMalformed));
     AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hSearchMenu, Localization::GetString(StringId::Menu_Search));
 
     // Config Menu
@@ -449,6 +500,12 @@ void MainWindow::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify)
     case IDM_FILE_OPEN:
         OnFileOpen();
         break;
+    case IDM_FILE_OPEN_HEAD:
+        OnFileOpen(CsvDocument::OpenMode::Head);
+        break;
+    case IDM_FILE_OPEN_TAIL:
+        OnFileOpen(CsvDocument::OpenMode::Tail);
+        break;
     case IDM_FILE_IMPORT:
         OnFileImport();
         break;
@@ -563,9 +620,16 @@ void MainWindow::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify)
         InvalidateRect(m_hwnd, NULL, FALSE);
         break;
 
+    case ID_SEARCH_EDIT:
+        if (codeNotify == EN_CHANGE) OnSearchTextChanged();
+        break;
     case ID_SEARCH_CLOSE:
         m_showSearch = false;
         m_showReplace = false;
+        m_jumpToFirstMatch = false;
+        m_searchScope.clear();
+        GetActiveTab().document.StopFindAll();
+        if (m_hMatchCountLabel) SetWindowText(m_hMatchCountLabel, _T(""));
         UpdateSearchBar();
         break;
     case ID_SEARCH_NEXT:
@@ -574,6 +638,9 @@ void MainWindow::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify)
     case ID_SEARCH_PREV:
         OnSearchPrev();
         break;
+    case IDM_SEARCH_NEXT_MALFORMED:
+        OnNextMalformedRow();
+        break;
 
     case ID_SEARCH_REPLACE:
         OnSearchReplace();
@@ -619,7 +686,7 @@ void MainWindow::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify)
     }
 }
 
-void MainWindow::OnFileOpen()
+void MainWindow::OnFileOpen(CsvDocument::OpenMode mode)
 {
     OPENFILENAME ofn;
     TCHAR szFile[260] = {0};
@@ -648,7 +715,7 @@ void MainWindow::OnFileOpen()
 
     if (GetOpenFileName(&ofn) == TRUE) {
         WaitCursor wait;
-        if (OpenFile(szFile)) {
+        if (OpenFile(szFile, mode)) {
             // Update window title or status
             // SetWindowText(m_hwnd, szFile);
         } else {
@@ -893,7 +960,7 @@ void MainWindow::OnEditCopy()
 
     // If Row selection, handle max col
     if (range.mode == SelectionMode::Row) {
-         endCol = 100; // HACK: Should ideally find max cols in rows
+         endCol = tab.document.GetMaxColumnCount() - 1;
     }
     // If Column selection, handle max row
     else if (range.mode == SelectionMode::Column) {
@@ -902,7 +969,7 @@ void MainWindow::OnEditCopy()
     // If All selection
     else if (range.mode == SelectionMode::All) {
          endRow = tab.document.GetRowCount() > 0 ? tab.document.GetRowCount() - 1 : 0;
-         endCol = 100; // HACK: Max cols
+         endCol = tab.document.GetMaxColumnCount() - 1;
     }
 
     std::wstring text = tab.document.GetRangeAsText(startRow, startCol, endRow, endCol);
@@ -1008,7 +1075,8 @@ void MainWindow::UpdateScrollBars()
     int clientWidth = rc.right - rc.left;
 
     // Vertical Scrollbar
-    size_t rowCount = tab.document.GetRowCount();
+    // While indexing, span the whole file so the thumb can reach rows not indexed yet
+    size_t rowCount = tab.document.GetEstimatedRowCount();
     int visibleRows = (int)((clientHeight - m_headerHeight) / m_rowHeight);
     if (visibleRows < 0) visibleRows = 0;
 
@@ -1034,6 +1102,24 @@ void MainWindow::UpdateScrollBars()
     SetScrollInfo(m_hwnd, SB_HORZ, &si, TRUE);
 }
 
+void MainWindow::OnLoadProgress(CsvDocument* document, int percent, bool completed)
+{
+    // The tab may have been closed since the worker posted this
+    if (document != &GetActiveTab().document) return;
+    
+    if (m_hProgressBar) {
+        if (completed) {
+            ShowWindow(m_hProgressBar, SW_HIDE);
+        } else {
+            SendMessage(m_hProgressBar, PBM_SETPOS, (WPARAM)percent, 0);
+        }
+    }
+    
+    // Row count grew: extend the scroll range and show any newly available rows
+    UpdateScrollBars();
+    InvalidateRect(m_hwnd, NULL, FALSE);
+}
+
 void MainWindow::OnVScroll(WPARAM wParam)
 {
     SCROLLINFO si = {0};
@@ -1058,8 +1144,16 @@ void MainWindow::OnVScroll(WPARAM wParam)
     if (newPos > (int)(si.nMax - si.nPage + 1)) newPos = (si.nMax - si.nPage + 1);
     if (newPos < 0) newPos = 0;
 
+    CsvDocument& doc = GetActiveTab().document;
+    if (!doc.IsRowAvailable((size_t)newPos) && si.nMax > 0) {
+        // Not indexed yet: jump to the same relative position in the file
+        size_t row = 0;
+        if (doc.SeekToFraction((double)newPos / si.nMax, row)) newPos = (int)row;
+    }
+
     GetActiveTab().state.SetScrollRow((size_t)newPos);
     UpdateScrollBars();
+    UpdatePrefetch();
     InvalidateRect(m_hwnd, NULL, FALSE);
 }
 
@@ -1104,9 +1198,38 @@ void MainWindow::OnMouseWheel(short delta)
     
     tab.state.SetScrollRow((size_t)newRow);
     UpdateScrollBars();
+    UpdatePrefetch();
     InvalidateRect(m_hwnd, NULL, FALSE);
 }
 
+void MainWindow::UpdatePrefetch()
+{
+    DocumentTab& tab = GetActiveTab();
+    int direction = tab.state.GetScrollDirection();
+    if (direction == 0) return;
+
+    RECT rc;
+    GetClientRect(m_hwnd, &rc);
+    size_t visibleRows = (size_t)(std::max)(1, (int)((rc.bottom - rc.top - m_headerHeight) / m_rowHeight));
+    
+    // Cover half a second of scrolling at the current speed: 2 to 8 screens
+    double aheadRows = std::abs(tab.state.GetScrollVelocity()) * 0.5;
+    size_t screens = (std::min)((size_t)8, (std::max)((size_t)2, (size_t)(aheadRows / visibleRows) + 1));
+    size_t count = screens * visibleRows;
+    
+    // The column range OnPaint asks for (plus a margin for DPI scaling), so prefetched rows are hits there
+    size_t firstCol = GetColumnAtX(tab.state.GetScrollX());
+    size_t colCount = GetVisibleColumnCount(firstCol, (float)(rc.right - rc.left)) + 2;
+    
+    size_t scrollRow = tab.state.GetScrollRow();
+    if (direction > 0) {
+        tab.document.PrefetchRows(scrollRow + visibleRows, count, true, firstCol, colCount);
+    } else if (scrollRow > 0) {
+        size_t first = scrollRow > count ? scrollRow - count : 0;
+        tab.document.PrefetchRows(first, scrollRow - first, false, firstCol, colCount);
+    }
+}
+
 bool MainWindow::HitTest(int x, int y, size_t& outRow, size_t& outCol, bool& outIsRowHeader, bool& outIsColHeader)
 {
     float fx = (float)x;
@@ -1474,8 +1597,8 @@ void MainWindow::ShowCellEditor(size_t row, size_t col)
     
     // Get Cell Value
     std::wstring text;
-    auto cells = tab.document.GetRowCells(row);
-    if (col < cells.size()) text = cells[col];
+    const ParsedRow* cells = tab.document.GetCachedRow(row, col, 1);
+    if (cells && col - cells->GetFirstColumn() < cells->GetCellCount()) text = cells->GetCell(col - cells->GetFirstColumn());
     
     m_hEdit = CreateWindowEx(
         0, _T("EDIT"), text.c_str(),
@@ -1533,6 +1656,10 @@ void MainWindow::CreateSearchBar()
     m_hCloseSearchBtn = CreateWindowEx(0, _T("BUTTON"), _T("X"), WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
         315, y, 25, h, m_hwnd, (HMENU)ID_SEARCH_CLOSE, GetModuleHandle(NULL), NULL);
 
+    m_hMatchCountLabel = CreateWindowEx(0, _T("STATIC"), _T(""), WS_CHILD | WS_VISIBLE | SS_LEFT | SS_CENTERIMAGE,
+        345, y, 200, h, m_hwnd, NULL, GetModuleHandle(NULL), NULL);
+    SendMessage(m_hMatchCountLabel, WM_SETFONT, (WPARAM)GetStockObject(DEFAULT_GUI_FONT), TRUE);
+
     // Replace Controls (Row 2)
     int y2 = y + h;
     m_hReplaceEdit = CreateWindowEx(0, _T("EDIT"), _T(""), WS_CHILD | WS_BORDER | ES_AUTOHSCROLL, 
@@ -1547,6 +1674,42 @@ void MainWindow::CreateSearchBar()
     // Subclass Edit for Enter key? (Optional)
 }
 
+// Like spreadsheets, a selection of more than one cell limits the search to it
+static std::vector<CsvDocument::CellRange> SelectionScope(const std::vector<SelectionRange>& selections)
+{
+    std::vector<CsvDocument::CellRange> scope;
+    bool single = selections.size() == 1 && selections[0].mode == SelectionMode::Cell &&
+                  selections[0].start == selections[0].end;
+    if (single) return scope;
+    for (const auto& selection : selections) {
+        CsvDocument::CellRange range;
+        size_t minRow = (std::min)(selection.start.row, selection.end.row);
+        size_t maxRow = (std::max)(selection.start.row, selection.end.row);
+        size_t minCol = (std::min)(selection.start.col, selection.end.col);
+        size_t maxCol = (std::max)(selection.start.col, selection.end.col);
+        switch (selection.mode) {
+        case SelectionMode::All:
+            return std::vector<CsvDocument::CellRange>(); // Everything
+        case SelectionMode::Row:
+            range.firstRow = minRow;
+            range.lastRow = maxRow;
+            break;
+        case SelectionMode::Column:
+            range.firstCol = minCol;
+            range.lastCol = maxCol;
+            break;
+        default:
+            range.firstRow = minRow;
+            range.lastRow = maxRow;
+            range.firstCol = minCol;
+            range.lastCol = maxCol;
+            break;
+        }
+        scope.push_back(range);
+    }
+    return scope;
+}
+
 void MainWindow::UpdateSearchBar()
 {
     if (m_showSearch) {
@@ -1555,6 +1718,16 @@ void MainWindow::UpdateSearchBar()
         ShowWindow(m_hNextBtn, SW_SHOW);
         ShowWindow(m_hPrevBtn, SW_SHOW);
         ShowWindow(m_hCloseSearchBtn, SW_SHOW);
+        ShowWindow(m_hMatchCountLabel, SW_SHOW);
+        
+        // Ctrl+F / Ctrl+H on an open bar keep the anchor and scope it opened with
+        if (!m_searchBarShown) {
+            auto selections = GetActiveTab().state.GetSelections();
+            m_searchAnchorRow = selections.empty() ? 0 : selections[0].start.row;
+            m_searchAnchorCol = selections.empty() ? 0 : selections[0].start.col;
+            m_searchScope = SelectionScope(selections);
+            SetWindowText(m_hMatchCountLabel, m_searchScope.empty() ? _T("") : _T("In selection"));
+        }
         
         if (m_showReplace) {
              ShowWindow(m_hReplaceEdit, SW_SHOW);
@@ -1572,6 +1745,7 @@ void MainWindow::UpdateSearchBar()
         if (m_hNextBtn) ShowWindow(m_hNextBtn, SW_HIDE);
         if (m_hPrevBtn) ShowWindow(m_hPrevBtn, SW_HIDE);
         if (m_hCloseSearchBtn) ShowWindow(m_hCloseSearchBtn, SW_HIDE);
+        if (m_hMatchCountLabel) ShowWindow(m_hMatchCountLabel, SW_HIDE);
         
         if (m_hReplaceEdit) ShowWindow(m_hReplaceEdit, SW_HIDE);
         if (m_hReplaceBtn) ShowWindow(m_hReplaceBtn, SW_HIDE);
@@ -1580,6 +1754,7 @@ void MainWindow::UpdateSearchBar()
         // Restore focus to grid/main
         if (m_hwnd) SetFocus(m_hwnd);
     }
+    m_searchBarShown = m_showSearch;
     
     // Adjust layout
     m_headerHeight = 25.0f; // Base
@@ -1628,6 +1803,7 @@ void MainWindow::OnReplace()
     CsvDocument::SearchOptions opts;
     opts.forward = true;
     opts.mode = CsvDocument::SearchMode::Contains;
+    opts.scope = m_searchScope;
     
     // Try Replace
     bool replaced = false;
@@ -1675,6 +1851,7 @@ void MainWindow::OnReplaceAll()
 
     CsvDocument::SearchOptions opts;
     opts.mode = CsvDocument::SearchMode::Contains;
+    opts.scope = m_searchScope;
     
     int count = 0;
     {
@@ -1710,14 +1887,9 @@ void MainWindow::OnSearchNext()
     opts.forward = true;
     opts.matchCase = false; 
     opts.mode = CsvDocument::SearchMode::Contains;
+    opts.scope = m_searchScope;
 
-    bool found = false;
-    {
-         WaitCursor wait;
-         found = tab.document.Search(query, r, c, opts);
-    }
-
-    if (found) {
+    if (FindMatch(tab, query, opts, r, c)) {
         tab.state.SelectCell(r, c, false);
         // Ensure visible
         tab.state.SetScrollRow(r > 5 ? r - 5 : 0); // Center roughly
@@ -1728,6 +1900,107 @@ void MainWindow::OnSearchNext()
     }
 }
 
+// Each keystroke replaces the Find All scan (cancelling the last one); a query that extends the
+// previous one only re-checks the cells that already matched. Nothing here waits for the scan.
+void MainWindow::OnSearchTextChanged()
+{
+    int len = GetWindowTextLength(m_hSearchEdit);
+    std::wstring query;
+    query.resize(len+1);
+    GetWindowText(m_hSearchEdit, &query[0], len+1);
+    query.resize(len);
+    
+    DocumentTab& tab = GetActiveTab();
+    if (query.empty()) {
+        m_jumpToFirstMatch = false;
+        tab.document.StopFindAll();
+        SetWindowText(m_hMatchCountLabel, m_searchScope.empty() ? _T("") : _T("In selection"));
+        return;
+    }
+    
+    CsvDocument::SearchOptions opts;
+    opts.matchCase = false;
+    opts.mode = CsvDocument::SearchMode::Contains;
+    opts.scope = m_searchScope;
+    StartFindAll(tab, query, opts);
+    m_jumpToFirstMatch = true;
+    OnFindProgress(&tab.document, false);
+}
+
+void MainWindow::StartFindAll(DocumentTab& tab, const std::wstring& query, const CsvDocument::SearchOptions& opts)
+{
+    HWND hwnd = m_hwnd;
+    CsvDocument* target = &tab.document;
+    auto onProgress = [hwnd, target](size_t count) {
+        PostMessage(hwnd, WM_APP_FIND_PROGRESS, (WPARAM)count, (LPARAM)target);
+    };
+    auto onCompleted = [hwnd, target]() {
+        PostMessage(hwnd, WM_APP_FIND_COMPLETE, 0, (LPARAM)target);
+    };
+    tab.document.StartFindAll(query, opts, onProgress, onCompleted);
+}
+
+// Next/previous come from the document's Find All list, which is started for a new query and
+// fills in the background. Until it has covered the rows in question, the document is scanned.
+bool MainWindow::FindMatch(DocumentTab& tab, const std::wstring& query, const CsvDocument::SearchOptions& opts, size_t& row, size_t& col)
+{
+    CsvDocument& document = tab.document;
+    if (!document.IsFindAllFor(query, opts)) StartFindAll(tab, query, opts);
+    
+    if (document.FindMatch(row, col, opts.forward, opts.includeStart)) return true;
+    if (document.IsFindAllComplete()) return false;
+    
+    WaitCursor wait;
+    return document.Search(query, row, col, opts);
+}
+
+void MainWindow::OnFindProgress(CsvDocument* document, bool completed)
+{
+    // The tab may have been closed or switched since the worker posted this
+    if (document != &GetActiveTab().document || !m_hMatchCountLabel) return;
+    
+    std::wstring text = std::to_wstring(document->GetMatchCount()) + _T(" matches");
+    if (!m_searchScope.empty()) text += _T(" in selection");
+    if (!completed && !document->IsFindAllComplete()) text += _T("...");
+    SetWindowText(m_hMatchCountLabel, text.c_str());
+    
+    if (m_jumpToFirstMatch) {
+        // Wrap to the top once the scan has passed the end without a match below the anchor
+        size_t r = m_searchAnchorRow, c = m_searchAnchorCol;
+        bool found = document->FindMatch(r, c, true, true);
+        if (!found && document->IsFindAllComplete()) {
+            r = 0; c = 0;
+            found = document->FindMatch(r, c, true, true);
+            m_jumpToFirstMatch = false;
+        }
+        if (found) {
+            m_jumpToFirstMatch = false;
+            DocumentTab& tab = GetActiveTab();
+            tab.state.SelectCell(r, c, false);
+            tab.state.SetScrollRow(r > 5 ? r - 5 : 0);
+            UpdateScrollBars();
+            InvalidateRect(m_hwnd, NULL, FALSE);
+        }
+    }
+}
+
+void MainWindow::OnNextMalformedRow()
+{
+    DocumentTab& tab = GetActiveTab();
+    auto selections = tab.state.GetSelections();
+    size_t r = selections.empty() ? 0 : selections[0].start.row;
+    
+    // Wrap around to the first one after the last
+    if (tab.document.FindIrregularRow(r) || (r = 0, tab.document.FindIrregularRow(r))) {
+        tab.state.SelectCell(r, 0, false);
+        tab.state.SetScrollRow(r > 5 ? r - 5 : 0);
+        UpdateScrollBars();
+        InvalidateRect(m_hwnd, NULL, FALSE);
+    } else {
+        MessageBox(m_hwnd, Localization::GetString(StringId::Msg_NoMalformedRows), Localization::GetString(StringId::Msg_Info), MB_OK);
+    }
+}
+
 void MainWindow::OnSearchPrev()
 {
     if (!m_hSearchEdit) return;
@@ -1750,14 +2023,9 @@ void MainWindow::OnSearchPrev()
     opts.forward = false;
     opts.matchCase = false;
     opts.mode = CsvDocument::SearchMode::Contains;
+    opts.scope = m_searchScope;
 
-    bool found = false;
-    {
-         WaitCursor wait;
-         found = tab.document.Search(query, r, c, opts);
-    }
-    
-    if (found) {
+    if (FindMatch(tab, query, opts, r, c)) {
         tab.state.SelectCell(r, c, false);
         tab.state.SetScrollRow(r > 5 ? r - 5 : 0);
         UpdateScrollBars();
@@ -1822,9 +2090,10 @@ void MainWindow::UpdateFormulaBar()
     }
     
     if (r < tab.document.GetRowCount()) {
-        auto cells = tab.document.GetRowCells(r);
-        if (c < cells.size()) {
-            SetWindowText(m_hFormulaEdit, cells[c].c_str());
+        const ParsedRow* cells = tab.document.GetCachedRow(r, c, 1);
+        if (cells && c - cells->GetFirstColumn() < cells->GetCellCount()) {
+            std::wstring text(cells->GetCell(c - cells->GetFirstColumn()));
+            SetWindowText(m_hFormulaEdit, text.c_str());
             m_isUpdatingFormula = false;
             return;
         }
@@ -1876,7 +2145,7 @@ void MainWindow::OnPaint(HWND hwnd)
             pRT->FillRectangle(tabRect, (i == m_activeTabIndex) ? pBrushTabActive : pBrushTabInactive);
             pRT->DrawRectangle(tabRect, pBrushGrid);
             
-            std::wstring title = m_tabs[i].title;
+            std::wstring title = m_tabs[i]->title;
             D2D1_RECT_F textRect = D2D1::RectF(tabX + 5, 5, tabX + tabW - 5, tabH - 5);
             
             // Allow clipping
@@ -1915,8 +2184,13 @@ void MainWindow::OnPaint(HWND hwnd)
         auto& activeDoc = GetActiveTab().document;
         const auto& activeState = GetActiveTab().state;
         
+        // Only the visible columns are parsed, so wide rows cost no more than narrow ones
+        size_t firstVisibleCol = GetColumnAtX(activeState.GetScrollX());
+        size_t visibleCols = GetVisibleColumnCount(firstVisibleCol, size.width);
+        
         for (size_t i = startRow; i < rowCount && i < startRow + visibleRows; ++i) {
-            std::vector<std::wstring> cells = activeDoc.GetRowCells(i);
+            // Repaints of unchanged rows parse nothing
+            const ParsedRow* row = activeDoc.GetCachedRow(i, firstVisibleCol, visibleCols);
             float y = startY + (i - startRow) * m_rowHeight;
             
             // Draw Row Header
@@ -1926,6 +2200,7 @@ void MainWindow::OnPaint(HWND hwnd)
             
             // Row Number
             std::wstring rowNum = std::to_wstring(i + 1);
+            if (!activeDoc.IsRowNumberExact(i)) rowNum = L"~" + rowNum; // Estimated (Tail mode)
             pRT->DrawText(rowNum.c_str(), (UINT32)rowNum.length(), pTF, headerRect, pBrushBlack);
 
             float scrollX = activeState.GetScrollX();
@@ -1933,10 +2208,10 @@ void MainWindow::OnPaint(HWND hwnd)
             
             float x = m_headerWidth + GetColumnX(startCol) - scrollX;
             
-            size_t colCount = cells.size(); 
+            size_t colCount = row ? row->GetFirstColumn() + row->GetCellCount() : 0; 
 
             for (size_t col = startCol; col < colCount; ++col) {
-                const auto& cell = cells[col];
+                std::wstring_view cell = row->GetCell(col - row->GetFirstColumn());
                 float colW = GetColumnWidth(col);
                 
                 D2D1_RECT_F cellRect = D2D1::RectF(x, y, x + colW, y + m_rowHeight);
@@ -1949,7 +2224,7 @@ void MainWindow::OnPaint(HWND hwnd)
                 // Draw text with Layout for Folding support
                 CComPtr<IDWriteTextLayout> pLayout;
                 HRESULT hrLayout = m_dxResources.GetWriteFactory()->CreateTextLayout(
-                    cell.c_str(),
+                    cell.data(),
                     (UINT32)cell.length(),
                     pTF,
                     colW,         // Max Width
@@ -2062,6 +2337,18 @@ size_t MainWindow::GetColumnAtX(float targetX) const
     }
     return c;
 }
+
+size_t MainWindow::GetVisibleColumnCount(size_t firstCol, float clientWidth) const
+{
+    size_t count = 0;
+    float x = m_headerWidth + GetColumnX(firstCol) - GetActiveTab().state.GetScrollX();
+    while (x < clientWidth) {
+        x += GetColumnWidth(firstCol + count);
+        count++;
+    }
+    return count;
+}
+
 int MainWindow::HitTestTabBar(int x, int y)
 {
     float fx = (float)x;
@@ -2081,4 +2368,4 @@ int MainWindow::HitTestTabBar(int x, int y)
     }
     
     return -1;
-}
+}
@@ -6,10 +6,17 @@
 
 #include <windows.h>
 #include <map>
+#include <memory>
 #include "DirectXResources.h"
 #include "CsvDocument.h"
 #include "EditorState.h"
 
+// Posted from document worker threads (lParam = CsvDocument*)
+#define WM_APP_LOAD_PROGRESS (WM_APP + 1) // wParam = percent
+#define WM_APP_LOAD_COMPLETE (WM_APP + 2) // wParam = TRUE if fully indexed
+#define WM_APP_FIND_PROGRESS (WM_APP + 3) // wParam = match count
+#define WM_APP_FIND_COMPLETE (WM_APP + 4)
+
 // Helper for wait cursor
 struct WaitCursor {
     HCURSOR hOld;
@@ -23,7 +30,7 @@ public:
     ~MainWindow();
 
     bool Create(HINSTANCE hInstance, int nCmdShow);
-    bool OpenFile(const std::wstring& filePath);
+    bool OpenFile(const std::wstring& filePath, CsvDocument::OpenMode mode = CsvDocument::OpenMode::Full);
 
 protected:
     static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
@@ -35,7 +42,7 @@ protected:
     void OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify);
 
     void InitializeMenu(HWND hwnd);
-    void OnFileOpen();
+    void OnFileOpen(CsvDocument::OpenMode mode = CsvDocument::OpenMode::Full);
     void OnFileImport();
     void OnFileSave();
     void OnFileSaveAs();
@@ -73,7 +80,8 @@ private:
         std::wstring title;    // Filename or "Untitled"
     };
     
-    std::vector<DocumentTab> m_tabs;
+    std::vector<std::unique_ptr<DocumentTab>> m_tabs; // Heap-allocated: documents own worker threads
+
     size_t m_activeTabIndex = 0;
     
     DocumentTab& GetActiveTab();
@@ -89,6 +97,8 @@ private:
 
 private:
     void UpdateScrollBars();
+    void UpdatePrefetch(); // Parses rows ahead of the scroll direction in the background
+    void OnLoadProgress(CsvDocument* document, int percent, bool completed);
     std::wstring m_currentFilePath; // Deprecated, use GetActiveTab().filePath
     HWND m_hwnd;
     DirectXResources m_dxResources;
@@ -117,6 +127,16 @@ private:
     HWND m_hNextBtn = NULL;
     HWND m_hPrevBtn = NULL;
     HWND m_hCloseSearchBtn = NULL;
+    HWND m_hMatchCountLabel = NULL; // Live Find All count
+    // Search as you type: the first match at or after the anchor (the selection when the bar
+    // opened) is selected once the scan has reached it
+    size_t m_searchAnchorRow = 0;
+    size_t m_searchAnchorCol = 0;
+    bool m_jumpToFirstMatch = false;
+    // The selection when the bar opened, if it spans cells. Kept while the bar stays open:
+    // Next and the first-match jump select single cells.
+    std::vector<CsvDocument::CellRange> m_searchScope;
+    bool m_searchBarShown = false; // m_showSearch as of the last UpdateSearchBar
     
     // Formula Bar
     HWND m_hFormulaEdit = NULL;
@@ -133,6 +153,11 @@ private:
     void CreateSearchBar();
     void OnSearchNext();
     void OnSearchPrev();
+    void OnSearchTextChanged();
+    void StartFindAll(DocumentTab& tab, const std::wstring& query, const CsvDocument::SearchOptions& opts);
+    bool FindMatch(DocumentTab& tab, const std::wstring& query, const CsvDocument::SearchOptions& opts, size_t& row, size_t& col);
+    void OnFindProgress(CsvDocument* document, bool completed);
+    void OnNextMalformedRow();
     
     // Replace UI
     bool m_showReplace = false;
@@ -157,6 +182,7 @@ private:
     float GetColumnWidth(size_t col) const;
     float GetColumnX(size_t col) const; // Absolute X position
     size_t GetColumnAtX(float x) const;
+    size_t GetVisibleColumnCount(size_t firstCol, float clientWidth) const; // Columns from firstCol on screen
     
     // Cursor
     HCURSOR m_hCursorArrow = NULL;
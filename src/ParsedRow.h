@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Decoded cells of one row, kept in a single arena: one character buffer plus
+// (offset, length) descriptors. Clear() keeps the capacity, so a reused ParsedRow
+// parses row after row without per-cell heap allocations.
+class ParsedRow {
+public:
+    size_t GetCellCount() const { return m_cells.size(); }
+
+    std::wstring_view GetCell(size_t index) const {
+        const CellSpan& cell = m_cells[index];
+        return std::wstring_view(m_chars.data() + cell.offset, cell.length);
+    }
+
+    // Column of GetCell(0), and whether the cells run to the end of the row
+    size_t GetFirstColumn() const { return m_firstColumn; }
+    bool IsComplete() const { return m_complete; }
+    // True if columns [firstColumn, firstColumn + count) are all here (or past the row's end)
+    bool Covers(size_t firstColumn, size_t count) const {
+        if (firstColumn < m_firstColumn) return false;
+        if (m_complete) return true;
+        size_t end = m_firstColumn + m_cells.size();
+        return firstColumn <= end && count <= end - firstColumn;
+    }
+
+    void Clear() {
+        m_chars.clear();
+        m_cells.clear();
+        m_cellStart = 0;
+        m_firstColumn = 0;
+        m_complete = true;
+    }
+
+    // Building: characters go to the open cell until EndCell()
+    void Append(wchar_t ch) { m_chars.push_back(ch); }
+    void Append(std::wstring_view text) { m_chars.append(text.data(), text.size()); }
+    void EndCell() {
+        m_cells.push_back({ m_cellStart, m_chars.size() - m_cellStart });
+        m_cellStart = m_chars.size();
+    }
+    void AddCell(std::wstring_view text) { Append(text); EndCell(); }
+
+    std::vector<std::wstring> ToVector() const {
+        std::vector<std::wstring> cells;
+        cells.reserve(m_cells.size());
+        for (size_t i = 0; i < m_cells.size(); ++i) cells.emplace_back(GetCell(i));
+        return cells;
+    }
+
+    // Scratch row for leaf functions on the calling thread
+    static ParsedRow& ForThread() {
+        thread_local ParsedRow row;
+        return row;
+    }
+
+private:
+    friend class CsvDocument; // Decodes straight into m_chars
+
+    struct CellSpan {
+        size_t offset;
+        size_t length;
+    };
+    std::wstring m_chars;
+    std::vector<CellSpan> m_cells;
+    size_t m_cellStart = 0;
+    size_t m_firstColumn = 0;
+    bool m_complete = true;
+};
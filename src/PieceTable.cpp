@@ -1,5 +1,7 @@
 #include "PieceTable.h"
+#include "BufferedWriter.h"
 #include <algorithm>
+#include <cstring>
 
 PieceTable::PieceTable()
     : m_totalSize(0)
@@ -28,38 +30,31 @@ bool PieceTable::LoadFromFile(const std::wstring& filePath)
     }
 
     m_totalSize = m_file.GetSize();
+    UpdateStarts();
     return true;
 }
 
 void PieceTable::SetPieces(const std::vector<Piece>& pieces)
 {
     m_pieces = pieces;
+    UpdateStarts();
+}
+
+void PieceTable::UpdateStarts()
+{
+    m_starts.resize(m_pieces.size());
     m_totalSize = 0;
-    for (const auto& p : m_pieces) {
-        m_totalSize += p.length;
+    for (size_t i = 0; i < m_pieces.size(); ++i) {
+        m_starts[i] = m_totalSize;
+        m_totalSize += m_pieces[i].length;
     }
 }
 
 bool PieceTable::Save(const std::wstring& filePath)
 {
-    // For large files, we should stream this. 
-    // Creating a new file and writing piece by piece.
-    
-    HANDLE hFile = CreateFileW(
-        filePath.c_str(),
-        GENERIC_WRITE,
-        0, NULL,
-        CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
-
-    if (hFile == INVALID_HANDLE_VALUE) return false;
-
-    // TODO: Write buffer in chunks for speed? For now, piece by piece is okay.
-    // If piece is huge, nice. If many small pieces, many WriteFile calls.
-    // Buffering would be better.
-
+    // Piece by piece through one buffer: after many edits most pieces are a few bytes long
+    BufferedWriter writer;
+    if (!writer.Open(filePath)) return false;
     for (const auto& piece : m_pieces) {
         const uint8_t* dataStart = nullptr;
         if (piece.source == Piece::ORIGINAL) {
@@ -67,26 +62,9 @@ bool PieceTable::Save(const std::wstring& filePath)
         } else {
             dataStart = m_addBuffer.data() + piece.offset;
         }
-
-        DWORD written = 0;
-        // Handle >4GB writing in chunks if piece.length is huge? 
-        // WriteFile takes DWORD (32-bit).
-        uint64_t remaining = piece.length;
-        uint64_t currentOffset = 0;
-
-        while (remaining > 0) {
-            DWORD toWrite = (remaining > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD)remaining;
-            if (!WriteFile(hFile, dataStart + currentOffset, toWrite, &written, NULL)) {
-                CloseHandle(hFile);
-                return false;
-            }
-            remaining -= written;
-            currentOffset += written;
-        }
+        if (!writer.Write(dataStart, piece.length)) return false;
     }
-
-    CloseHandle(hFile);
-    return true;
+    return writer.Close();
 }
 
 uint8_t PieceTable::GetAt(uint64_t index) const
@@ -109,21 +87,53 @@ uint64_t PieceTable::GetSize() const
     return m_totalSize;
 }
 
+const uint8_t* PieceTable::GetContiguous(uint64_t offset, uint64_t length) const
+{
+    size_t pieceIndex;
+    uint64_t relativeOffset;
+    if (!FindPiece(offset, pieceIndex, relativeOffset)) return nullptr;
+
+    const Piece& p = m_pieces[pieceIndex];
+    if (relativeOffset + length > p.length) return nullptr;
+
+    const uint8_t* base = (p.source == Piece::ORIGINAL) ? m_file.GetData() : m_addBuffer.data();
+    return base + p.offset + relativeOffset;
+}
+
+void PieceTable::CopyRange(uint64_t offset, uint64_t length, uint8_t* out) const
+{
+    size_t pieceIndex;
+    uint64_t relativeOffset;
+    if (length == 0 || !FindPiece(offset, pieceIndex, relativeOffset)) return;
+
+    for (; pieceIndex < m_pieces.size() && length > 0; ++pieceIndex) {
+        const Piece& p = m_pieces[pieceIndex];
+        const uint8_t* base = (p.source == Piece::ORIGINAL) ? m_file.GetData() : m_addBuffer.data();
+        uint64_t chunk = (std::min)(length, p.length - relativeOffset);
+        memcpy(out, base + p.offset + relativeOffset, (size_t)chunk);
+        out += chunk;
+        length -= chunk;
+        relativeOffset = 0;
+    }
+}
+
 bool PieceTable::FindPiece(uint64_t logicalOffset, size_t& outPieceIndex, uint64_t& outRelativeOffset) const
 {
     if (logicalOffset >= m_totalSize) return false;
 
-    uint64_t currentPos = 0;
-    for (size_t i = 0; i < m_pieces.size(); ++i) {
-        const Piece& p = m_pieces[i];
-        if (logicalOffset < currentPos + p.length) {
-            outPieceIndex = i;
-            outRelativeOffset = logicalOffset - currentPos;
-            return true;
-        }
-        currentPos += p.length;
-    }
-    return false;
+    // The last piece starting at or before the offset (empty pieces share a start with the next)
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), logicalOffset);
+    if (it == m_starts.begin()) return false;
+    outPieceIndex = (size_t)(it - m_starts.begin()) - 1;
+    outRelativeOffset = logicalOffset - m_starts[outPieceIndex];
+    return true;
+}
+
+size_t PieceTable::GetPieceIndex(uint64_t offset) const
+{
+    size_t pieceIndex = 0;
+    uint64_t relativeOffset = 0;
+    return FindPiece(offset, pieceIndex, relativeOffset) ? pieceIndex : m_pieces.size();
 }
 
 void PieceTable::Insert(uint64_t offset, const uint8_t* data, size_t length)
@@ -167,7 +177,7 @@ void PieceTable::Insert(uint64_t offset, const uint8_t* data, size_t length)
         }
     }
 
-    m_totalSize += length;
+    UpdateStarts();
 }
 
 void PieceTable::Delete(uint64_t offset, uint64_t length)
@@ -176,7 +186,6 @@ void PieceTable::Delete(uint64_t offset, uint64_t length)
 
     uint64_t endDelete = offset + length;
     if (endDelete > m_totalSize) endDelete = m_totalSize;
-    uint64_t actualDeleteLength = endDelete - offset;
 
     // 1. Find start piece
     size_t startPieceIndex;
@@ -213,85 +222,79 @@ void PieceTable::Delete(uint64_t offset, uint64_t length)
         if (right.length > 0) {
             m_pieces.insert(m_pieces.begin() + startPieceIndex + 1, right);
         }
+        if (m_pieces[startPieceIndex].length == 0) {
+            m_pieces.erase(m_pieces.begin() + startPieceIndex);
+        }
     } 
     else {
-        // Handle Start Piece
+        // Keep the left part of the start piece, if the cut falls inside it
+        size_t firstToRemove = startPieceIndex;
         if (startRelOffset > 0) {
-            // Keep left part
             m_pieces[startPieceIndex].length = startRelOffset;
-            startPieceIndex++; // The ones to delete start AFTER this
-        } else {
-            // Remove this piece entirely, so include it in deletion range
+            firstToRemove++;
         }
 
-        // Handle End Piece
-        // If endRelOffset > 0, it means the cut is in the middle of endPiece.
-        // We need to keep the RIGHT part of endPiece.
-        // But startPieceIndex...endPieceIndex are the pieces touched.
-        // Actually, let's look at the range of pieces to REMOVE.
-        
-        // It's easier to handle split of end piece first?
-        // If endPieceIndex < m_pieces.size(), we are entering it at endRelOffset.
-        // We need to keep from endRelOffset to end.
-        
-        if (endPieceIndex < m_pieces.size()) {
-            Piece& endP = m_pieces[endPieceIndex];
-            if (endRelOffset > 0) {
-                 endP.offset += endRelOffset;
-                 endP.length -= endRelOffset;
-                 // This piece stays!
-            } else {
-                 // endRelOffset == 0 means we delete up to the START of this piece,
-                 // so this piece is NOT touched/removed. (It's outside the range)
-            }
-        }
-        
-        // Remove pieces between startPieceIndex and endPieceIndex
-        // Wait, indices map to the ORIGINAL array.
-        // If we modified startPieceIndex (truncated it), we incremented startPieceIndex.
-        // If we modified endPieceIndex (truncated left), effectively we just kept it but modified props.
-        
-        // Range to erase: [startPieceIndex, endPieceIndex) 
-        // Logic check:
-        // Case: Delete [10, 20). 
-        // Piece 0: [0, 100). 
-        // Start: idx 0, rel 10. Split -> P0[0, 10]. New P1[20, 80] inserted? 
-        // My same-piece logic above handles this.
-        
-        // Case: Delete [10, 150).
-        // Piece 0: [0, 100). Piece 1: [0, 100).
-        // Start: idx 0, rel 10. Keep P0[0,10]. Increment startIdx -> 1.
-        // End: idx 1, rel 50. Delete P1[0, 50). Keep P1[50, 50).
-        // P1 modified to start+50, len 50.
-        // Range to remove: pieces completely inside.
-        
-        // Implementation:
-        // 1. If startRelOffset > 0, we split start piece. The "deletion" starts at startPieceIndex + 1.
-        //    Else, deletion starts at startPieceIndex.
-        size_t firstToRemove = (startRelOffset > 0) ? startPieceIndex + 1 : startPieceIndex;
-        
-        // 2. If endRelOffset == 0, we stop BEFORE endPieceIndex.
-        //    If endRelOffset > 0, we must adjust endPieceIndex logic.
-        //    Actually, if endRelOffset > 0, we are "keeping" the tail of endPieceIndex. 
-        //    So we don't remove endPieceIndex, we just modify it.
-        //    So we remove up to endPieceIndex.
-        size_t lastToRemove = endPieceIndex; // Exclusive?
-        
+        // Keep the right part of the end piece, if the cut falls inside it.
+        // endRelOffset == 0 means endPieceIndex is the first piece after the deletion.
         if (endPieceIndex < m_pieces.size() && endRelOffset > 0) {
-            // We need to keep the tail of this piece.
             Piece& p = m_pieces[endPieceIndex];
             p.offset += endRelOffset;
             p.length -= endRelOffset;
-            // It stays.
-        } else {
-            // If endRelOffset == 0, endPieceIndex is the first one *after* deletion. 
-            // So we remove up to endPieceIndex. Correct.
         }
-        
-        if (firstToRemove < lastToRemove) {
-             m_pieces.erase(m_pieces.begin() + firstToRemove, m_pieces.begin() + lastToRemove);
+
+        // Pieces entirely inside the deletion: [firstToRemove, endPieceIndex)
+        if (firstToRemove < endPieceIndex) {
+             m_pieces.erase(m_pieces.begin() + firstToRemove, m_pieces.begin() + endPieceIndex);
+        }
+    }
+
+    UpdateStarts();
+}
+
+void PieceTable::ReplaceRanges(const std::vector<Edit>& edits, const uint8_t* data, size_t dataLength)
+{
+    if (edits.empty()) return;
+    const uint64_t addBase = m_addBuffer.size();
+    m_addBuffer.insert(m_addBuffer.end(), data, data + dataLength);
+
+    std::vector<Piece> pieces;
+    pieces.reserve(m_pieces.size() + 2 * edits.size());
+    auto append = [&](const Piece& piece) {
+        if (piece.length == 0) return;
+        // Runs that continue the previous piece's bytes are joined
+        if (!pieces.empty()) {
+            Piece& last = pieces.back();
+            if (last.source == piece.source && last.offset + last.length == piece.offset) {
+                last.length += piece.length;
+                return;
+            }
+        }
+        pieces.push_back(piece);
+    };
+
+    // Walks the old pieces up to 'end', keeping or dropping what it passes
+    size_t index = 0;
+    uint64_t within = 0, cursor = 0;
+    auto advance = [&](uint64_t end, bool keep) {
+        while (cursor < end && index < m_pieces.size()) {
+            const Piece& piece = m_pieces[index];
+            uint64_t take = (std::min)(piece.length - within, end - cursor);
+            if (keep) append({ piece.source, piece.offset + within, take });
+            within += take;
+            cursor += take;
+            if (within == piece.length) {
+                index++;
+                within = 0;
+            }
         }
+    };
+    for (const Edit& edit : edits) {
+        advance(edit.offset, true);
+        append({ Piece::ADD_BUFFER, addBase + edit.dataOffset, edit.dataLength });
+        advance(edit.offset + edit.length, false);
     }
+    advance(UINT64_MAX, true);
 
-    m_totalSize -= actualDeleteLength;
+    m_pieces.swap(pieces);
+    UpdateStarts();
 }
@@ -25,6 +25,16 @@ public:
     void Insert(uint64_t offset, const uint8_t* data, size_t length);
     void Delete(uint64_t offset, uint64_t length);
 
+    // Replaces many ranges in one pass over the pieces. Edits are sorted by offset and do not
+    // overlap; edit i's new bytes are data[dataOffset, dataOffset + dataLength).
+    struct Edit {
+        uint64_t offset;
+        uint64_t length;
+        size_t dataOffset;
+        size_t dataLength;
+    };
+    void ReplaceRanges(const std::vector<Edit>& edits, const uint8_t* data, size_t dataLength);
+
     // Data Access
     // Get byte at index (slow, for testing/small access)
     uint8_t GetAt(uint64_t index) const;
@@ -32,8 +42,17 @@ public:
     // Get total size of the content
     uint64_t GetSize() const;
 
+    // Pointer to [offset, offset + length) if it lies inside a single piece, otherwise nullptr
+    const uint8_t* GetContiguous(uint64_t offset, uint64_t length) const;
+    // Copies a range that may span several pieces
+    void CopyRange(uint64_t offset, uint64_t length, uint8_t* out) const;
+
     // Direct access to pieces for line indexing
     const std::vector<Piece>& GetPieces() const { return m_pieces; }
+    // Logical offset of piece 'index' (GetSize() past the last piece), and the index of the piece
+    // holding 'offset' (the piece count past the end), without walking the pieces
+    uint64_t GetPieceStart(size_t index) const { return index < m_starts.size() ? m_starts[index] : m_totalSize; }
+    size_t GetPieceIndex(uint64_t offset) const;
     void SetPieces(const std::vector<Piece>& pieces);
     const MemoryMappedFile& GetOriginalFile() const { return m_file; }
     const std::vector<uint8_t>& GetAddBuffer() const { return m_addBuffer; }
@@ -42,8 +61,11 @@ private:
     MemoryMappedFile m_file;
     std::vector<uint8_t> m_addBuffer;
     std::vector<Piece> m_pieces;
+    std::vector<uint64_t> m_starts; // Logical offset of each piece, for binary search
     uint64_t m_totalSize;
 
+    void UpdateStarts(); // After m_pieces changed
+
     // Helper to find which piece contains the logical offset
     // Returns index in m_pieces and the relative offset within that piece
     bool FindPiece(uint64_t logicalOffset, size_t& outPieceIndex, uint64_t& outRelativeOffset) const;
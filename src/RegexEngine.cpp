@@ -0,0 +1,583 @@
+#include "RegexEngine.h"
+#include "TextCodec.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+
+const int kMaxNfaStates = 20000;
+const size_t kMaxDfaStates = 4096; // The cache is dropped and rebuilt past this
+const int kMaxRepeat = 1000;
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> Ranges; // Inclusive code unit ranges
+
+void Normalize(Ranges& ranges)
+{
+    std::sort(ranges.begin(), ranges.end());
+    Ranges merged;
+    for (const auto& range : ranges) {
+        if (!merged.empty() && range.first <= merged.back().second + 1) {
+            merged.back().second = (std::max)(merged.back().second, range.second);
+        } else {
+            merged.push_back(range);
+        }
+    }
+    ranges.swap(merged);
+}
+
+Ranges Complement(const Ranges& ranges)
+{
+    Ranges result;
+    uint32_t next = 0;
+    for (const auto& range : ranges) {
+        if (range.first > next) result.push_back({ next, range.first - 1 });
+        next = range.second + 1;
+    }
+    if (next <= 0xFFFF) result.push_back({ next, 0xFFFF });
+    return result;
+}
+
+// Adds the other case of every character, as icase comparisons do
+void AddCaseVariants(Ranges& ranges)
+{
+    Ranges extra;
+    for (const auto& range : ranges) {
+        for (uint32_t ch = range.first; ch <= range.second; ++ch) {
+            uint32_t lower = (uint32_t)towlower((wint_t)ch);
+            uint32_t upper = (uint32_t)towupper((wint_t)ch);
+            if (lower != ch && lower <= 0xFFFF) extra.push_back({ lower, lower });
+            if (upper != ch && upper <= 0xFFFF) extra.push_back({ upper, upper });
+        }
+    }
+    ranges.insert(ranges.end(), extra.begin(), extra.end());
+    Normalize(ranges);
+}
+
+Ranges DigitRanges() { return { { '0', '9' } }; }
+Ranges WordRanges() { return { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } }; }
+Ranges SpaceRanges()
+{
+    Ranges ranges = { { 0x09, 0x0D }, { 0x20, 0x20 }, { 0xA0, 0xA0 }, { 0x1680, 0x1680 }, { 0x2000, 0x200A },
+                      { 0x2028, 0x2029 }, { 0x202F, 0x202F }, { 0x205F, 0x205F }, { 0x3000, 0x3000 }, { 0xFEFF, 0xFEFF } };
+    return ranges;
+}
+
+struct Node {
+    enum Kind { Set, Concat, Alt, Repeat, Begin, End, Empty };
+    Kind kind;
+    int set = -1;
+    std::vector<int> children;
+    int min = 0;
+    int max = -1; // -1: unbounded
+};
+
+// Recursive descent over the pattern; 'ok' turns false on anything unsupported or malformed
+class Parser {
+public:
+    Parser(const std::wstring& pattern, bool ignoreCase) : m_pattern(pattern), m_ignoreCase(ignoreCase) {}
+
+    bool Parse(int& root) {
+        root = ParseAlternation();
+        return m_ok && m_pos == m_pattern.size();
+    }
+
+    std::vector<Node> nodes;
+    std::vector<Ranges> sets;
+
+private:
+    int NewNode(Node::Kind kind) {
+        nodes.push_back(Node());
+        nodes.back().kind = kind;
+        return (int)nodes.size() - 1;
+    }
+
+    int NewSet(Ranges ranges, bool negate) {
+        Normalize(ranges);
+        if (m_ignoreCase) AddCaseVariants(ranges);
+        if (negate) ranges = Complement(ranges);
+        sets.push_back(ranges);
+        int node = NewNode(Node::Set);
+        nodes[node].set = (int)sets.size() - 1;
+        return node;
+    }
+
+    bool AtEnd() const { return m_pos >= m_pattern.size(); }
+    wchar_t Peek() const { return m_pattern[m_pos]; }
+
+    int ParseAlternation() {
+        int first = ParseConcat();
+        if (AtEnd() || Peek() != L'|') return first;
+        int alt = NewNode(Node::Alt);
+        nodes[alt].children.push_back(first);
+        while (m_ok && !AtEnd() && Peek() == L'|') {
+            m_pos++;
+            int next = ParseConcat();
+            nodes[alt].children.push_back(next);
+        }
+        return alt;
+    }
+
+    int ParseConcat() {
+        int concat = NewNode(Node::Concat);
+        while (m_ok && !AtEnd() && Peek() != L'|' && Peek() != L')') {
+            int item = ParseRepeat();
+            nodes[concat].children.push_back(item);
+        }
+        return concat;
+    }
+
+    int ParseRepeat() {
+        int atom = ParseAtom();
+        while (m_ok && !AtEnd()) {
+            int min = 0, max = -1;
+            wchar_t ch = Peek();
+            if (ch == L'*') { m_pos++; }
+            else if (ch == L'+') { m_pos++; min = 1; }
+            else if (ch == L'?') { m_pos++; max = 1; }
+            else if (ch == L'{' && ParseBounds(min, max)) {}
+            else break;
+            if (!AtEnd() && Peek() == L'?') m_pos++; // Lazy: same cells match
+            Node::Kind kind = nodes[atom].kind;
+            if (kind == Node::Begin || kind == Node::End || (max != -1 && max < min) || min > kMaxRepeat || max > kMaxRepeat) {
+                m_ok = false;
+                return atom;
+            }
+            int repeat = NewNode(Node::Repeat);
+            nodes[repeat].children.push_back(atom);
+            nodes[repeat].min = min;
+            nodes[repeat].max = max;
+            atom = repeat;
+        }
+        return atom;
+    }
+
+    // {n}, {n,} or {n,m}; otherwise '{' is a literal (Annex B)
+    bool ParseBounds(int& min, int& max) {
+        size_t pos = m_pos + 1;
+        auto number = [&](int& value) {
+            size_t begin = pos;
+            value = 0;
+            // Every digit is consumed; past kMaxRepeat the value sticks there + 1, which ParseRepeat rejects
+            while (pos < m_pattern.size() && iswdigit(m_pattern[pos])) {
+                value = (std::min)(value * 10 + (m_pattern[pos++] - L'0'), kMaxRepeat + 1);
+            }
+            return pos > begin;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (pos < m_pattern.size() && m_pattern[pos] == L',') {
+            pos++;
+            if (!number(max)) max = -1;
+        }
+        if (pos >= m_pattern.size() || m_pattern[pos] != L'}') return false;
+        m_pos = pos + 1;
+        return true;
+    }
+
+    int ParseAtom() {
+        wchar_t ch = m_pattern[m_pos++];
+        switch (ch) {
+        case L'(': {
+            if (!AtEnd() && Peek() == L'?') {
+                if (m_pos + 1 < m_pattern.size() && m_pattern[m_pos + 1] == L':') {
+                    m_pos += 2;
+                } else {
+                    m_ok = false; // Lookarounds
+                    return NewNode(Node::Empty);
+                }
+            }
+            int inner = ParseAlternation();
+            if (AtEnd() || Peek() != L')') {
+                m_ok = false;
+                return inner;
+            }
+            m_pos++;
+            return inner;
+        }
+        case L'[': return ParseClass();
+        case L'.': return NewSet({ { L'\n', L'\n' }, { L'\r', L'\r' }, { 0x2028, 0x2029 } }, true);
+        case L'^': return NewNode(Node::Begin);
+        case L'$': return NewNode(Node::End);
+        case L'*': case L'+': case L'?': case L')':
+            m_ok = false; // Nothing to repeat, or unbalanced
+            return NewNode(Node::Empty);
+        case L'\\': {
+            Ranges ranges;
+            bool negate = false;
+            if (!ParseEscape(ranges, negate, false)) return NewNode(Node::Empty);
+            return NewSet(ranges, negate);
+        }
+        default:
+            return NewSet({ { (uint32_t)ch, (uint32_t)ch } }, false);
+        }
+    }
+
+    // After '\': a class escape or a single character
+    bool ParseEscape(Ranges& ranges, bool& negate, bool inClass) {
+        if (AtEnd()) return m_ok = false;
+        wchar_t ch = m_pattern[m_pos++];
+        auto single = [&](uint32_t value) { ranges.push_back({ value, value }); return true; };
+        auto hex = [&](size_t digits) {
+            uint32_t value = 0;
+            for (size_t i = 0; i < digits; ++i) {
+                if (AtEnd() || !iswxdigit(Peek())) return m_ok = false;
+                wchar_t d = m_pattern[m_pos++];
+                value = value * 16 + (iswdigit(d) ? d - L'0' : (towlower(d) - L'a' + 10));
+            }
+            return single(value);
+        };
+        switch (ch) {
+        case L'd': ranges = DigitRanges(); return true;
+        case L'D': ranges = DigitRanges(); negate = true; return true;
+        case L'w': ranges = WordRanges(); return true;
+        case L'W': ranges = WordRanges(); negate = true; return true;
+        case L's': ranges = SpaceRanges(); return true;
+        case L'S': ranges = SpaceRanges(); negate = true; return true;
+        case L't': return single(L'\t');
+        case L'n': return single(L'\n');
+        case L'r': return single(L'\r');
+        case L'v': return single(L'\v');
+        case L'f': return single(L'\f');
+        case L'0': return single(0);
+        case L'x': return hex(2);
+        case L'u': return hex(4);
+        case L'b': if (inClass) return single(L'\b');
+                   return m_ok = false; // Word boundary
+        default:
+            if (iswalnum(ch)) return m_ok = false; // Backreferences, \B, \c and unknown letters
+            return single(ch); // Escaped punctuation
+        }
+    }
+
+    int ParseClass() {
+        bool negate = false;
+        if (!AtEnd() && Peek() == L'^') {
+            negate = true;
+            m_pos++;
+        }
+        Ranges ranges;
+        while (m_ok && !AtEnd() && Peek() != L']') {
+            uint32_t low = 0;
+            if (!ParseClassAtom(ranges, low)) continue; // A class escape, already added
+            if (m_pos + 1 < m_pattern.size() && Peek() == L'-' && m_pattern[m_pos + 1] != L']') {
+                m_pos++;
+                uint32_t high = 0;
+                if (!ParseClassAtom(ranges, high) || high < low) {
+                    m_ok = false;
+                    break;
+                }
+                ranges.push_back({ low, high });
+            } else {
+                ranges.push_back({ low, low });
+            }
+        }
+        if (AtEnd()) m_ok = false;
+        else m_pos++;
+        if (negate && ranges.empty()) return NewSet({ { 0, 0xFFFF } }, false); // [^] matches anything
+        return NewSet(ranges, negate);
+    }
+
+    // One character of a class into 'value'; false (with the ranges added) for \d-like escapes
+    bool ParseClassAtom(Ranges& ranges, uint32_t& value) {
+        wchar_t ch = m_pattern[m_pos++];
+        if (ch != L'\\') {
+            value = ch;
+            return true;
+        }
+        Ranges escaped;
+        bool negate = false;
+        if (!ParseEscape(escaped, negate, true)) return false;
+        if (negate) escaped = Complement(escaped);
+        if (escaped.size() == 1 && escaped[0].first == escaped[0].second && !negate) {
+            value = escaped[0].first;
+            return true;
+        }
+        ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+        return false;
+    }
+
+    const std::wstring& m_pattern;
+    bool m_ignoreCase;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+} // namespace
+
+struct RegexEngine::Program {
+    enum Type { Set, Split, Epsilon, Begin, End, Match };
+    struct State {
+        Type type;
+        int out = -1;
+        int out1 = -1;
+        int set = -1;
+    };
+    std::vector<State> states;
+    std::vector<uint16_t> classOf;               // Code unit -> character class
+    int classCount = 0;
+    std::vector<std::vector<uint8_t>> setMatches; // [set][class]
+    std::vector<int> initialClosure;              // At the start of the text (^ passes)
+    std::vector<int> restartClosure;              // At any later position: search is unanchored
+
+    int NewState(Type type, int out = -1, int out1 = -1) {
+        State state;
+        state.type = type;
+        state.out = out;
+        state.out1 = out1;
+        states.push_back(state);
+        return (int)states.size() - 1;
+    }
+
+    // Builds the NFA backwards: returns the start of 'node' whose matches continue at 'next'
+    int Build(const std::vector<Node>& nodes, int node, int next) {
+        if ((int)states.size() > kMaxNfaStates) return next;
+        const Node& n = nodes[node];
+        switch (n.kind) {
+        case Node::Set: {
+            int state = NewState(Set, next);
+            states[state].set = n.set;
+            return state;
+        }
+        case Node::Concat:
+            for (size_t i = n.children.size(); i-- > 0;) next = Build(nodes, n.children[i], next);
+            return next;
+        case Node::Alt: {
+            int start = Build(nodes, n.children.back(), next);
+            for (size_t i = n.children.size() - 1; i-- > 0;) {
+                int branch = Build(nodes, n.children[i], next);
+                start = NewState(Split, branch, start);
+            }
+            return start;
+        }
+        case Node::Repeat: {
+            int start = next;
+            if (n.max == -1) {
+                int loop = NewState(Split);
+                int body = Build(nodes, n.children[0], loop);
+                states[loop].out = body;
+                states[loop].out1 = next;
+                start = loop;
+            } else {
+                for (int i = n.min; i < n.max; ++i) {
+                    int body = Build(nodes, n.children[0], start);
+                    start = NewState(Split, body, next);
+                }
+            }
+            for (int i = 0; i < n.min; ++i) start = Build(nodes, n.children[0], start);
+            return start;
+        }
+        case Node::Begin: return NewState(Begin, next);
+        case Node::End: return NewState(End, next);
+        default: return next;
+        }
+    }
+
+    // States reachable without input: character sets, Match, and End assertions still pending
+    void Closure(int state, bool atStart, bool atEnd, std::vector<int>& out, std::vector<uint8_t>& seen) const {
+        std::vector<int> stack(1, state);
+        while (!stack.empty()) {
+            int s = stack.back();
+            stack.pop_back();
+            if (s < 0 || seen[s]) continue;
+            seen[s] = 1;
+            const State& st = states[s];
+            switch (st.type) {
+            case Split: stack.push_back(st.out1); stack.push_back(st.out); break;
+            case Epsilon: stack.push_back(st.out); break;
+            case Begin: if (atStart) stack.push_back(st.out); break;
+            case End:
+                if (atEnd) stack.push_back(st.out);
+                else out.push_back(s);
+                break;
+            default: out.push_back(s); break;
+            }
+        }
+    }
+};
+
+RegexEngine& RegexEngine::operator=(const RegexEngine& other)
+{
+    if (this != &other) {
+        m_program = other.m_program;
+        ResetCache();
+    }
+    return *this;
+}
+
+bool RegexEngine::Compile(const std::wstring& pattern, bool ignoreCase)
+{
+    m_program.reset();
+    ResetCache();
+
+    Parser parser(pattern, ignoreCase);
+    int root = -1;
+    if (!parser.Parse(root)) return false;
+
+    auto program = std::make_shared<Program>();
+    int match = program->NewState(Program::Match);
+    int start = program->Build(parser.nodes, root, match);
+    if ((int)program->states.size() > kMaxNfaStates) return false;
+
+    // Character classes: maximal runs of code units that every set treats alike
+    std::vector<uint32_t> bounds(1, 0);
+    for (const Ranges& ranges : parser.sets) {
+        for (const auto& range : ranges) {
+            bounds.push_back(range.first);
+            bounds.push_back(range.second + 1);
+        }
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    if (bounds.back() <= 0xFFFF) bounds.push_back(0x10000);
+    else bounds.back() = 0x10000;
+    program->classCount = (int)bounds.size() - 1;
+    program->classOf.resize(0x10000);
+    for (int k = 0; k < program->classCount; ++k) {
+        for (uint32_t ch = bounds[k]; ch < bounds[k + 1] && ch <= 0xFFFF; ++ch) program->classOf[ch] = (uint16_t)k;
+    }
+    for (const Ranges& ranges : parser.sets) {
+        std::vector<uint8_t> matches(program->classCount, 0);
+        for (const auto& range : ranges) {
+            for (int k = program->classOf[range.first]; k < program->classCount && bounds[k] <= range.second; ++k) matches[k] = 1;
+        }
+        program->setMatches.push_back(matches);
+    }
+
+    std::vector<uint8_t> seen(program->states.size(), 0);
+    program->Closure(start, true, false, program->initialClosure, seen);
+    std::fill(seen.begin(), seen.end(), 0);
+    program->Closure(start, false, false, program->restartClosure, seen);
+    m_program = program;
+    return true;
+}
+
+void RegexEngine::ResetCache()
+{
+    m_states.clear();
+    m_stateIds.clear();
+    m_initial = -1;
+}
+
+int RegexEngine::AddState(std::vector<int>& nfaStates)
+{
+    std::sort(nfaStates.begin(), nfaStates.end());
+    nfaStates.erase(std::unique(nfaStates.begin(), nfaStates.end()), nfaStates.end());
+    auto it = m_stateIds.find(nfaStates);
+    if (it != m_stateIds.end()) return it->second;
+
+    const Program& program = *m_program;
+    DfaState state;
+    state.nfaStates = nfaStates;
+    state.next.assign(program.classCount, -1);
+    std::vector<uint8_t> seen(program.states.size(), 0);
+    for (int s : nfaStates) {
+        if (program.states[s].type == Program::Match) {
+            state.accept = true;
+        } else if (program.states[s].type == Program::End && !state.acceptAtEnd) {
+            std::vector<int> reached;
+            std::fill(seen.begin(), seen.end(), 0);
+            program.Closure(program.states[s].out, false, true, reached, seen);
+            for (int r : reached) {
+                if (program.states[r].type == Program::Match) state.acceptAtEnd = true;
+            }
+        }
+    }
+    state.acceptAtEnd = state.acceptAtEnd || state.accept;
+    m_states.push_back(std::move(state));
+    int id = (int)m_states.size() - 1;
+    m_stateIds.emplace(nfaStates, id);
+    return id;
+}
+
+int RegexEngine::GetInitialState()
+{
+    if (m_initial < 0) {
+        std::vector<int> initial = m_program->initialClosure;
+        m_initial = AddState(initial);
+    }
+    return m_initial;
+}
+
+int RegexEngine::Transition(int state, int charClass)
+{
+    const Program& program = *m_program;
+    std::vector<int> target = program.restartClosure;
+    std::vector<uint8_t> seen(program.states.size(), 0);
+    for (int s : m_states[state].nfaStates) {
+        const Program::State& st = program.states[s];
+        if (st.type == Program::Set && program.setMatches[st.set][charClass]) {
+            program.Closure(st.out, false, false, target, seen);
+        }
+    }
+
+    if (m_states.size() >= kMaxDfaStates) {
+        // Bound the cache: start over, keeping only the state we move to
+        ResetCache();
+        return AddState(target);
+    }
+    int next = AddState(target);
+    m_states[state].next[charClass] = next;
+    return next;
+}
+
+template <typename NextUnit>
+bool RegexEngine::Run(NextUnit nextUnit)
+{
+    if (!m_program) return false;
+    int state = GetInitialState();
+    if (m_states[state].accept) return true;
+    uint32_t unit = 0;
+    while (nextUnit(unit)) {
+        int charClass = m_program->classOf[unit];
+        int next = m_states[state].next[charClass];
+        state = (next >= 0) ? next : Transition(state, charClass);
+        if (m_states[state].accept) return true;
+    }
+    return m_states[state].acceptAtEnd;
+}
+
+bool RegexEngine::Search(const wchar_t* text, size_t length)
+{
+    size_t i = 0;
+    return Run([&](uint32_t& unit) {
+        if (i >= length) return false;
+        unit = (uint16_t)text[i++];
+        return true;
+    });
+}
+
+bool RegexEngine::SearchUtf8(const uint8_t* data, size_t length)
+{
+    // Decodes code points on the fly; astral ones become surrogate pairs, as in UTF-16 text
+    size_t i = 0;
+    uint32_t pendingLow = 0;
+    return Run([&](uint32_t& unit) {
+        if (pendingLow) {
+            unit = pendingLow;
+            pendingLow = 0;
+            return true;
+        }
+        if (i >= length) return false;
+        uint32_t cp = 0;
+        i += TextCodec::NextCodePoint(data, length, i, cp);
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            unit = 0xD800 + (cp >> 10);
+            pendingLow = 0xDC00 + (cp & 0x3FF);
+        } else {
+            unit = cp;
+        }
+        return true;
+    });
+}
+
+bool RegexEngine::SearchUtf16(const uint8_t* data, size_t length, bool bigEndian)
+{
+    size_t i = 0;
+    return Run([&](uint32_t& unit) {
+        if (i + 1 >= length) return false;
+        unit = bigEndian ? (uint32_t)((data[i] << 8) | data[i + 1]) : (uint32_t)(data[i] | (data[i + 1] << 8));
+        i += 2;
+        return true;
+    });
+}
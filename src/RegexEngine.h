@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Linear-time regex search for SearchMode::Regex.
+// Compiles an ECMAScript subset (literals, '.', classes and \d \w \s escapes, groups, '|',
+// greedy or lazy * + ? {m,n}, ^ and $) to an NFA over UTF-16 code units, and answers
+// "does the pattern occur in this text" with a DFA built lazily from it and cached.
+// Cells are read in place: UTF-8 is turned into code units on the fly, UTF-16 is read in either byte order.
+// Backreferences, lookarounds and \b are not supported: Compile returns false and callers
+// use std::wregex. Captures are not tracked; replacing resolves them with std::wregex on
+// cells this engine reported as matching.
+// Copies share the compiled program but build their own DFA, so give each thread its own copy.
+class RegexEngine {
+public:
+    RegexEngine() = default;
+    RegexEngine(const RegexEngine& other) : m_program(other.m_program) {}
+    RegexEngine& operator=(const RegexEngine& other);
+
+    bool Compile(const std::wstring& pattern, bool ignoreCase);
+    bool IsCompiled() const { return m_program != nullptr; }
+
+    bool Search(const wchar_t* text, size_t length);
+    bool SearchUtf8(const uint8_t* data, size_t length);
+    bool SearchUtf16(const uint8_t* data, size_t length, bool bigEndian);
+
+    size_t GetDfaStateCount() const { return m_states.size(); }
+
+private:
+    struct Program;
+
+    struct DfaState {
+        std::vector<int> nfaStates; // Sorted
+        bool accept = false;        // A match ends here
+        bool acceptAtEnd = false;   // A match ends here if the text ends here ($)
+        std::vector<int> next;      // Per character class; -1 until computed
+    };
+
+    int GetInitialState();
+    int AddState(std::vector<int>& nfaStates);
+    int Transition(int state, int charClass);
+    void ResetCache();
+    template <typename NextUnit>
+    bool Run(NextUnit nextUnit);
+
+    std::shared_ptr<const Program> m_program;
+    std::vector<DfaState> m_states;
+    std::map<std::vector<int>, int> m_stateIds;
+    int m_initial = -1;
+};
@@ -7,6 +7,8 @@
 #define IDI_APP_ICON     101
 #define IDM_FILE_REOPEN  1002
 #define IDM_FILE_IMPORT  1008
+#define IDM_FILE_OPEN_HEAD 1009
+#define IDM_FILE_OPEN_TAIL 1010
 #define IDM_FILE_SAVE    1003
 #define IDM_FILE_SAVEAS  1004
 #define IDM_FILE_EXPORT_HTML 1006
@@ -55,3 +57,4 @@
 #define ID_REPLACE_EDIT   5006
 #define ID_REPLACE_BTN    5007
 #define ID_REPLACE_ALL_BTN 5008
+#define IDM_SEARCH_NEXT_MALFORMED 5009
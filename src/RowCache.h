@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ParsedRow.h"
+#include <list>
+#include <unordered_map>
+#include <iterator>
+#include <cstdint>
+
+// Bounded LRU cache of decoded rows, keyed by row index and document version.
+// An entry whose version differs from the current one is stale and counts as a miss.
+// Evicted entries are recycled, so their ParsedRow arenas are reused.
+// Not synchronized: owned by CsvDocument and used from the UI thread.
+class RowCache {
+public:
+    explicit RowCache(size_t capacity = 1024) : m_capacity(capacity ? capacity : 1) {}
+
+    // Returns the cached row if it holds the requested columns, or nullptr (counted as a miss)
+    const ParsedRow* Find(size_t row, uint64_t version, size_t firstColumn = 0, size_t count = SIZE_MAX) {
+        auto it = m_index.find(row);
+        if (it == m_index.end() || it->second->version != version || !it->second->row.Covers(firstColumn, count)) {
+            m_misses++;
+            return nullptr;
+        }
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        m_hits++;
+        return &it->second->row;
+    }
+
+    // Returns an empty slot for 'row', recycling the least recently used entry if full
+    ParsedRow& Insert(size_t row, uint64_t version) {
+        auto it = m_index.find(row);
+        if (it != m_index.end()) {
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+        } else if (m_entries.size() >= m_capacity) {
+            m_index.erase(m_entries.back().rowIndex);
+            m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+            it = m_index.emplace(row, m_entries.begin()).first;
+        } else {
+            m_entries.emplace_front();
+            it = m_index.emplace(row, m_entries.begin()).first;
+        }
+        Entry& entry = m_entries.front();
+        entry.rowIndex = row;
+        entry.version = version;
+        entry.row.Clear();
+        return entry.row;
+    }
+
+    // Drops rows [firstRow, firstRow + count), e.g. after they were rewritten in place
+    void Invalidate(size_t firstRow, size_t count) {
+        if (count <= m_index.size()) {
+            for (size_t row = firstRow; row < firstRow + count; ++row) Erase(row);
+            return;
+        }
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            auto next = std::next(it);
+            if (it->rowIndex >= firstRow && it->rowIndex - firstRow < count) Erase(it->rowIndex);
+            it = next;
+        }
+    }
+
+    bool Contains(size_t row, uint64_t version, size_t firstColumn = 0, size_t count = SIZE_MAX) const {
+        auto it = m_index.find(row);
+        return it != m_index.end() && it->second->version == version && it->second->row.Covers(firstColumn, count);
+    }
+
+    void Clear() {
+        m_entries.clear();
+        m_index.clear();
+    }
+
+    size_t GetSize() const { return m_entries.size(); }
+    size_t GetCapacity() const { return m_capacity; }
+    size_t GetHitCount() const { return m_hits; }
+    size_t GetMissCount() const { return m_misses; }
+    void ResetCounters() { m_hits = 0; m_misses = 0; }
+
+private:
+    struct Entry {
+        size_t rowIndex = 0;
+        uint64_t version = 0;
+        ParsedRow row;
+    };
+
+    void Erase(size_t row) {
+        auto it = m_index.find(row);
+        if (it == m_index.end()) return;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    size_t m_capacity;
+    std::list<Entry> m_entries; // Most recently used first
+    std::unordered_map<size_t, std::list<Entry>::iterator> m_index;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
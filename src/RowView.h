@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Zero-copy view of one row's cells (filled by CsvDocument::GetRowView).
+// Each cell is a span of raw bytes in the document's encoding, already unescaped.
+// Plain cells point straight into the file mapping or add buffer; quoted cells and rows
+// that straddle piece boundaries are materialized into storage owned by the view.
+// Spans stay valid until the view is refilled or the document is edited.
+// Reuse one view across rows: its buffers are kept, so steady-state parsing does not allocate.
+class RowView {
+public:
+    size_t GetCellCount() const { return m_cells.size(); }
+
+    std::string_view GetCell(size_t index) const {
+        const Cell& cell = m_cells[index];
+        const char* base = cell.data ? cell.data : m_owned.data();
+        return std::string_view(base + cell.offset, cell.length);
+    }
+
+    // UTF-16LE documents where wchar_t is a UTF-16 unit: cells as text, without copying
+    bool HasWideCells() const { return m_wide; }
+    std::wstring_view GetWideCell(size_t index) const {
+        std::string_view cell = GetCell(index);
+        return std::wstring_view(reinterpret_cast<const wchar_t*>(cell.data()), cell.size() / sizeof(wchar_t));
+    }
+
+    // Column of GetCell(0); non-zero when only a column range was parsed
+    size_t GetFirstColumn() const { return m_firstColumn; }
+    // False if parsing stopped before the end of the row
+    bool IsComplete() const { return m_complete; }
+
+    // True if the cell had to be copied (quoted, or the row spans pieces)
+    bool IsCellOwned(size_t index) const { return m_cells[index].data == nullptr || m_copied; }
+
+    void Clear() {
+        m_cells.clear();
+        m_owned.clear();
+        m_rowCopy.clear();
+        m_copied = false;
+        m_wide = false;
+        m_firstColumn = 0;
+        m_complete = true;
+    }
+
+private:
+    friend class CsvDocument;
+
+    struct Cell {
+        const char* data; // Borrowed base, or nullptr for m_owned
+        size_t offset;
+        size_t length;
+        size_t rawOffset; // Row-relative bytes as stored, including quotes
+        size_t rawLength;
+    };
+    std::vector<Cell> m_cells;
+    std::string m_owned;   // Unescaped quoted cells
+    std::string m_rowCopy; // Row bytes when the row spans pieces
+    bool m_copied = false;
+    bool m_wide = false;
+    size_t m_firstColumn = 0;
+    bool m_complete = true;
+};
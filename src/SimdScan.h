@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMDSCAN_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Inline searches for the first of three byte / UTF-16 unit values, and for byte strings,
+// 16 bytes per SSE2 step. Called with constant needles (as the per-dialect parsers do),
+// the compares are compiled in.
+namespace SimdScan {
+
+#ifdef SIMDSCAN_SSE2
+inline unsigned LowestSetBit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline unsigned HighestSetBit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return index;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+#endif
+
+// Index of the first byte equal to a, b or c, or 'length' if none
+inline size_t FindAny(const uint8_t* data, size_t length, uint8_t a, uint8_t b, uint8_t c)
+{
+    size_t i = 0;
+#ifdef SIMDSCAN_SSE2
+    const __m128i va = _mm_set1_epi8((char)a);
+    const __m128i vb = _mm_set1_epi8((char)b);
+    const __m128i vc = _mm_set1_epi8((char)c);
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) return i + LowestSetBit(mask);
+    }
+#endif
+    for (; i < length; ++i) {
+        if (data[i] == a || data[i] == b || data[i] == c) return i;
+    }
+    return length;
+}
+
+// Index of the first UTF-16 unit equal to a, b or c, or 'units' if none. Units are compared
+// in the given byte order: the needles are swapped instead of the data.
+inline size_t FindAnyUtf16(const uint8_t* data, size_t units, bool bigEndian, uint16_t a, uint16_t b, uint16_t c)
+{
+    size_t i = 0;
+#ifdef SIMDSCAN_SSE2
+    auto needle = [&](uint16_t ch) {
+        return _mm_set1_epi16((short)(bigEndian ? (uint16_t)((ch << 8) | (ch >> 8)) : ch));
+    };
+    const __m128i va = needle(a);
+    const __m128i vb = needle(b);
+    const __m128i vc = needle(c);
+    for (; i + 8 <= units; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, va), _mm_cmpeq_epi16(v, vb)), _mm_cmpeq_epi16(v, vc));
+        int mask = _mm_movemask_epi8(hit); // Two bits per unit
+        if (mask != 0) return i + LowestSetBit(mask) / 2;
+    }
+#endif
+    for (; i < units; ++i) {
+        const uint8_t* p = data + i * 2;
+        uint16_t ch = bigEndian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)(p[0] | (p[1] << 8));
+        if (ch == a || ch == b || ch == c) return i;
+    }
+    return units;
+}
+
+// Whether data[0, n) equals the needle once each byte j is OR'ed with foldMask[j] (exact without a mask)
+inline bool MatchesAt(const uint8_t* data, const uint8_t* needle, const uint8_t* foldMask, size_t n)
+{
+    if (!foldMask) return memcmp(data, needle, n) == 0;
+    for (size_t j = 0; j < n; ++j) {
+        if ((uint8_t)(data[j] | foldMask[j]) != needle[j]) return false;
+    }
+    return true;
+}
+
+// Substring search: candidates are positions where both the first and the last byte of the
+// needle match (16 positions per step), then the middle is compared.
+// Returns the start of the first (or last) occurrence, or 'length' if none.
+// With a fold mask, 0x20 at the position of a lowercase ASCII letter in the needle lets the
+// uppercase letter match too (case-insensitive search for ASCII letters).
+inline size_t FindSubstring(const uint8_t* data, size_t length, const uint8_t* needle, size_t n,
+                            const uint8_t* foldMask = nullptr)
+{
+    if (n == 0) return 0;
+    if (length < n) return length;
+    const size_t starts = length - n + 1;
+    const uint8_t firstFold = foldMask ? foldMask[0] : 0;
+    const uint8_t lastFold = foldMask ? foldMask[n - 1] : 0;
+    size_t i = 0;
+#ifdef SIMDSCAN_SSE2
+    const __m128i first = _mm_set1_epi8((char)needle[0]);
+    const __m128i last = _mm_set1_epi8((char)needle[n - 1]);
+    const __m128i firstMask = _mm_set1_epi8((char)firstFold);
+    const __m128i lastMask = _mm_set1_epi8((char)lastFold);
+    for (; i + 16 <= starts; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), firstMask);
+        __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1)), lastMask);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            unsigned bit = LowestSetBit(mask);
+            if (n <= 2 || MatchesAt(data + i + bit + 1, needle + 1, foldMask ? foldMask + 1 : nullptr, n - 2)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < starts; ++i) {
+        if ((uint8_t)(data[i] | firstFold) == needle[0] && (uint8_t)(data[i + n - 1] | lastFold) == needle[n - 1] &&
+            (n <= 2 || MatchesAt(data + i + 1, needle + 1, foldMask ? foldMask + 1 : nullptr, n - 2))) return i;
+    }
+    return length;
+}
+
+inline size_t FindLastSubstring(const uint8_t* data, size_t length, const uint8_t* needle, size_t n,
+                                const uint8_t* foldMask = nullptr)
+{
+    if (n == 0) return length;
+    if (length < n) return length;
+    const uint8_t firstFold = foldMask ? foldMask[0] : 0;
+    const uint8_t lastFold = foldMask ? foldMask[n - 1] : 0;
+    size_t end = length - n + 1; // Candidate starts left to check: [0, end)
+#ifdef SIMDSCAN_SSE2
+    const __m128i first = _mm_set1_epi8((char)needle[0]);
+    const __m128i last = _mm_set1_epi8((char)needle[n - 1]);
+    const __m128i firstMask = _mm_set1_epi8((char)firstFold);
+    const __m128i lastMask = _mm_set1_epi8((char)lastFold);
+    while (end >= 16) {
+        size_t i = end - 16;
+        __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), firstMask);
+        __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + n - 1)), lastMask);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            unsigned bit = HighestSetBit(mask);
+            if (n <= 2 || MatchesAt(data + i + bit + 1, needle + 1, foldMask ? foldMask + 1 : nullptr, n - 2)) return i + bit;
+            mask &= ~(1u << bit);
+        }
+        end = i;
+    }
+#endif
+    while (end > 0) {
+        size_t i = --end;
+        if ((uint8_t)(data[i] | firstFold) == needle[0] && (uint8_t)(data[i + n - 1] | lastFold) == needle[n - 1] &&
+            (n <= 2 || MatchesAt(data + i + 1, needle + 1, foldMask ? foldMask + 1 : nullptr, n - 2))) return i;
+    }
+    return length;
+}
+
+} // namespace SimdScan
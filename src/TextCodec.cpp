@@ -0,0 +1,299 @@
+#include "TextCodec.h"
+#include "SimdScan.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTCODEC_SSE2 1
+#endif
+
+namespace {
+
+const wchar_t kReplacement = 0xFFFD;
+
+// Widens 'count' ASCII bytes (known < 0x80)
+inline void WidenAscii(const uint8_t* in, size_t count, wchar_t* out)
+{
+    for (size_t i = 0; i < count; ++i) out[i] = (wchar_t)in[i];
+}
+
+// Length of the ASCII run at the start of [data, data + length)
+inline size_t AsciiPrefix(const uint8_t* data, size_t length)
+{
+    size_t i = 0;
+#ifdef TEXTCODEC_SSE2
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(v); // High bit of each byte
+        if (mask != 0) return i + SimdScan::LowestSetBit(mask);
+    }
+#else
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        if (word & 0x8080808080808080ULL) break;
+    }
+#endif
+    while (i < length && data[i] < 0x80) ++i;
+    return i;
+}
+
+const uint32_t kInvalid = 0xFFFFFFFF;
+
+// Decodes the multi-byte sequence at data[i] (lead >= 0x80), rejecting overlongs, surrogates,
+// values above U+10FFFF and truncation. Returns the bytes consumed: the whole sequence, or
+// its maximal invalid subpart (then cp = kInvalid).
+inline size_t ScanSequence(const uint8_t* data, size_t length, size_t i, uint32_t& cp)
+{
+    uint8_t lead = data[i];
+    size_t need = 0;
+    uint8_t lo = 0x80, hi = 0xBF; // Allowed range of the first continuation byte
+    if (lead >= 0xC2 && lead <= 0xDF) { need = 1; cp = lead & 0x1F; }
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        need = 2; cp = lead & 0x0F;
+        if (lead == 0xE0) lo = 0xA0;      // Overlong
+        else if (lead == 0xED) hi = 0x9F; // Surrogates
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        need = 3; cp = lead & 0x07;
+        if (lead == 0xF0) lo = 0x90;      // Overlong
+        else if (lead == 0xF4) hi = 0x8F; // Above U+10FFFF
+    }
+    else {
+        cp = kInvalid; // Stray continuation or invalid lead
+        return 1;
+    }
+
+    size_t j = 1;
+    for (; j <= need && i + j < length; ++j) {
+        uint8_t c = data[i + j];
+        if (c < (j == 1 ? lo : 0x80) || c > (j == 1 ? hi : 0xBF)) break;
+        cp = (cp << 6) | (c & 0x3F);
+    }
+    if (j <= need) {
+        cp = kInvalid; // Truncated: consume the valid prefix only
+        return j;
+    }
+    return need + 1;
+}
+
+} // namespace
+
+size_t TextCodec::ValidateUtf8(const uint8_t* data, size_t length, size_t readable, uint64_t baseOffset,
+                               Utf8Stats& stats, std::vector<uint64_t>* invalidOffsets, size_t maxOffsets)
+{
+    size_t i = 0;
+    size_t invalid = 0;
+    while (i < length) {
+        if (data[i] < 0x80) {
+            i += AsciiPrefix(data + i, length - i);
+            continue;
+        }
+        uint32_t cp = 0;
+        size_t used = ScanSequence(data, readable, i, cp);
+        if (cp == kInvalid) {
+            invalid++;
+            if (invalidOffsets && invalidOffsets->size() < maxOffsets) invalidOffsets->push_back(baseOffset + i);
+        } else {
+            stats.multiByte++;
+        }
+        i += used;
+    }
+    stats.invalid += invalid;
+    return i; // May run past 'length' by the tail of the last sequence
+}
+
+size_t TextCodec::NextCodePoint(const uint8_t* data, size_t length, size_t i, uint32_t& cp)
+{
+    if (data[i] < 0x80) {
+        cp = data[i];
+        return 1;
+    }
+    size_t used = ScanSequence(data, length, i, cp);
+    if (cp == kInvalid) cp = kReplacement;
+    return used;
+}
+
+size_t TextCodec::Utf8ToUtf16(const uint8_t* data, size_t length, wchar_t* out)
+{
+    size_t i = 0;
+    wchar_t* o = out;
+    while (i < length) {
+        // ASCII fast path
+        if (data[i] < 0x80) {
+#ifdef TEXTCODEC_SSE2
+            if (sizeof(wchar_t) == 2) {
+                const __m128i zero = _mm_setzero_si128();
+                while (i + 16 <= length) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    if (_mm_movemask_epi8(v) != 0) break;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(o), _mm_unpacklo_epi8(v, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 8), _mm_unpackhi_epi8(v, zero));
+                    i += 16;
+                    o += 16;
+                }
+            }
+#endif
+            size_t run = AsciiPrefix(data + i, length - i);
+            WidenAscii(data + i, run, o);
+            i += run;
+            o += run;
+            continue;
+        }
+
+        // Multi-byte sequence
+        uint32_t cp = 0;
+        size_t used = ScanSequence(data, length, i, cp);
+        i += used;
+        if (cp == kInvalid) {
+            *o++ = kReplacement;
+            continue;
+        }
+
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            *o++ = (wchar_t)(0xD800 + (cp >> 10));
+            *o++ = (wchar_t)(0xDC00 + (cp & 0x3FF));
+        } else {
+            *o++ = (wchar_t)cp;
+        }
+    }
+    return o - out;
+}
+
+size_t TextCodec::Utf16ToUtf8(const wchar_t* text, size_t length, uint8_t* out)
+{
+    size_t i = 0;
+    uint8_t* o = out;
+    while (i < length) {
+#ifdef TEXTCODEC_SSE2
+        if (sizeof(wchar_t) == 2) {
+            // ASCII fast path: 8 units at a time
+            const __m128i highBits = _mm_set1_epi16((short)0xFF80);
+            while (i + 8 <= length) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, highBits), _mm_setzero_si128())) != 0xFFFF) break;
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(o), _mm_packus_epi16(v, v));
+                i += 8;
+                o += 8;
+            }
+            if (i >= length) break;
+        }
+#endif
+        uint32_t cp = (uint16_t)text[i++];
+        if (cp < 0x80) {
+            *o++ = (uint8_t)cp;
+            continue;
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF) {
+            uint32_t next = (i < length) ? (uint16_t)text[i] : 0;
+            if (cp <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (next - 0xDC00);
+                i++;
+            } else {
+                cp = kReplacement; // Unpaired surrogate
+            }
+        }
+        if (cp < 0x800) {
+            *o++ = (uint8_t)(0xC0 | (cp >> 6));
+            *o++ = (uint8_t)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *o++ = (uint8_t)(0xE0 | (cp >> 12));
+            *o++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+            *o++ = (uint8_t)(0x80 | (cp & 0x3F));
+        } else {
+            *o++ = (uint8_t)(0xF0 | (cp >> 18));
+            *o++ = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+            *o++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+            *o++ = (uint8_t)(0x80 | (cp & 0x3F));
+        }
+    }
+    return o - out;
+}
+
+void TextCodec::Utf16BytesToUnits(const uint8_t* data, size_t units, bool bigEndian, wchar_t* out)
+{
+    size_t i = 0;
+    if (sizeof(wchar_t) == 2) {
+        if (!bigEndian) {
+            memcpy(out, data, units * 2); // Little-endian host
+            return;
+        }
+#ifdef TEXTCODEC_SSE2
+        // Swap the bytes of 8 units at a time
+        for (; i + 8 <= units; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+#endif
+    }
+    for (; i < units; ++i) {
+        const uint8_t* p = data + i * 2;
+        out[i] = bigEndian ? (wchar_t)((p[0] << 8) | p[1]) : (wchar_t)(p[0] | (p[1] << 8));
+    }
+}
+
+void TextCodec::UnitsToUtf16Bytes(const wchar_t* text, size_t units, bool bigEndian, uint8_t* out)
+{
+    size_t i = 0;
+    if (sizeof(wchar_t) == 2) {
+        if (!bigEndian) {
+            memcpy(out, text, units * 2);
+            return;
+        }
+#ifdef TEXTCODEC_SSE2
+        for (; i + 8 <= units; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), v);
+        }
+#endif
+    }
+    for (; i < units; ++i) {
+        uint16_t ch = (uint16_t)text[i];
+        out[i * 2] = bigEndian ? (uint8_t)(ch >> 8) : (uint8_t)(ch & 0xFF);
+        out[i * 2 + 1] = bigEndian ? (uint8_t)(ch & 0xFF) : (uint8_t)(ch >> 8);
+    }
+}
+
+void TextCodec::AppendUtf8(const uint8_t* data, size_t length, std::wstring& out)
+{
+    if (length == 0) return;
+    size_t pos = out.size();
+    out.resize(pos + MaxUtf16Length(length));
+    out.resize(pos + Utf8ToUtf16(data, length, &out[pos]));
+}
+
+void TextCodec::AppendUtf16(const uint8_t* data, size_t length, bool bigEndian, std::wstring& out)
+{
+    size_t units = length / 2;
+    if (units == 0) return;
+    size_t pos = out.size();
+    out.resize(pos + units);
+    Utf16BytesToUnits(data, units, bigEndian, &out[pos]);
+}
+
+void TextCodec::AppendAsUtf8(const wchar_t* text, size_t length, std::string& out)
+{
+    if (length == 0) return;
+    size_t pos = out.size();
+    out.resize(pos + MaxUtf8Length(length));
+    out.resize(pos + Utf16ToUtf8(text, length, reinterpret_cast<uint8_t*>(&out[pos])));
+}
+
+void TextCodec::AppendAsUtf8(const wchar_t* text, size_t length, std::vector<uint8_t>& out)
+{
+    if (length == 0) return;
+    size_t pos = out.size();
+    out.resize(pos + MaxUtf8Length(length));
+    out.resize(pos + Utf16ToUtf8(text, length, out.data() + pos));
+}
+
+void TextCodec::AppendAsUtf16(const wchar_t* text, size_t length, bool bigEndian, std::vector<uint8_t>& out)
+{
+    if (length == 0) return;
+    size_t pos = out.size();
+    out.resize(pos + length * 2);
+    UnitsToUtf16Bytes(text, length, bigEndian, out.data() + pos);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Portable UTF-8 / UTF-16 transcoding for cell text.
+// ASCII runs are converted 16 bytes at a time (SSE2 where available), multi-byte sequences
+// are validated, and output is sized in a single pass from the worst case, then trimmed.
+// Malformed input becomes U+FFFD, one per maximal invalid subpart (as MultiByteToWideChar does).
+// wchar_t holds one UTF-16 code unit per element.
+class TextCodec {
+public:
+    // Validation: counts well-formed multi-byte sequences and invalid subparts of those starting
+    // in [0, length); the last one may extend up to 'readable'. Offsets of the first 'maxOffsets'
+    // invalid subparts are recorded as baseOffset + index. Returns where scanning stopped.
+    struct Utf8Stats {
+        uint64_t multiByte = 0;
+        uint64_t invalid = 0;
+    };
+    static size_t ValidateUtf8(const uint8_t* data, size_t length, size_t readable, uint64_t baseOffset,
+                               Utf8Stats& stats, std::vector<uint64_t>* invalidOffsets = nullptr, size_t maxOffsets = 0);
+
+    // Decodes the code point at data[i] (U+FFFD for a maximal invalid subpart). Returns the bytes used.
+    static size_t NextCodePoint(const uint8_t* data, size_t length, size_t i, uint32_t& cp);
+
+    // Worst-case output sizes
+    static size_t MaxUtf16Length(size_t utf8Bytes) { return utf8Bytes; }
+    static size_t MaxUtf8Length(size_t utf16Units) { return utf16Units * 3; }
+
+    // Raw kernels: 'out' must hold the worst case. Return the number of units/bytes written.
+    static size_t Utf8ToUtf16(const uint8_t* data, size_t length, wchar_t* out);
+    static size_t Utf16ToUtf8(const wchar_t* text, size_t length, uint8_t* out);
+    static void Utf16BytesToUnits(const uint8_t* data, size_t units, bool bigEndian, wchar_t* out);
+    static void UnitsToUtf16Bytes(const wchar_t* text, size_t units, bool bigEndian, uint8_t* out);
+
+    // Appending wrappers
+    static void AppendUtf8(const uint8_t* data, size_t length, std::wstring& out);
+    static void AppendUtf16(const uint8_t* data, size_t length, bool bigEndian, std::wstring& out); // Odd trailing byte ignored
+    static void AppendAsUtf8(const wchar_t* text, size_t length, std::string& out);
+    static void AppendAsUtf8(const wchar_t* text, size_t length, std::vector<uint8_t>& out);
+    static void AppendAsUtf16(const wchar_t* text, size_t length, bool bigEndian, std::vector<uint8_t>& out);
+};
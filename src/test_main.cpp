@@ -3,9 +3,19 @@
 #include <vector>
 #include <cassert>
 #include <string>
+#include <atomic>
+#include <thread>
 #include "MemoryMappedFile.h"
 #include "PieceTable.h"
 #include "CsvDocument.h"
+#include "EditorState.h"
+#include "TextCodec.h"
+#include "SimdScan.h"
+#include "RegexEngine.h"
+#include "CaseFold.h"
+#include "AhoCorasick.h"
+#include "BufferedWriter.h"
+#include <regex>
 #include "Localization.h"
 
 void CreateDummyFile(const std::wstring& path, const std::string& content) {
@@ -57,6 +67,11 @@ void TestPieceTable() {
     assert(pt.GetAt(3) == 'B');
     assert(pt.GetAt(4) == 'C');
 
+    // Pieces "A", "12", "BC"
+    assert(pt.GetPieceIndex(0) == 0 && pt.GetPieceIndex(2) == 1 && pt.GetPieceIndex(3) == 2);
+    assert(pt.GetPieceIndex(5) == 3);
+    assert(pt.GetPieceStart(1) == 1 && pt.GetPieceStart(2) == 3 && pt.GetPieceStart(3) == 5);
+
     std::cout << "  Passed." << std::endl;
 }
 
@@ -807,6 +822,1672 @@ void TestImport()
     std::cout << "  Passed." << std::endl;
 }
 
+void TestAsyncLoad()
+{
+    std::cout << "Testing Async Load..." << std::endl;
+    {
+        std::ofstream out("async_load.csv", std::ios::binary);
+        out << "ID,Text\n";
+        for (int i = 0; i < 200000; ++i) {
+            out << i << ",\"Line " << i << "\nsecond part\"\n";
+        }
+    }
+    
+    // 1. Full background load
+    {
+        CsvDocument doc;
+        std::atomic<bool> completed(false);
+        std::atomic<bool> finishedFlag(false);
+        float lastProgress = 0.0f;
+        assert(doc.LoadAsync(L"async_load.csv",
+            [&](float p) { lastProgress = p; },
+            [&](bool finished) { finishedFlag = finished; completed = true; }));
+        
+        // Rows are readable as soon as they are published
+        while (doc.GetRowCount() == 0 && !completed) std::this_thread::yield();
+        assert(doc.GetRowCells(0)[0] == L"ID");
+        
+        doc.WaitForIndexing();
+        assert(completed && finishedFlag);
+        assert(lastProgress == 1.0f);
+        assert(doc.IsFullyIndexed());
+        assert(doc.GetRowCount() == 200001);
+        auto last = doc.GetRowCells(200000);
+        assert(last[0] == L"199999");
+        assert(last[1] == L"Line 199999\nsecond part");
+    }
+    
+    // 2. Cancelled load, then finish on demand
+    {
+        CsvDocument doc;
+        CancellationToken token;
+        std::atomic<bool> finishedFlag(true);
+        token.Cancel();
+        assert(doc.LoadAsync(L"async_load.csv", nullptr, [&](bool finished) { finishedFlag = finished; }, token));
+        doc.WaitForIndexing();
+        assert(!finishedFlag);
+        assert(!doc.IsFullyIndexed());
+        assert(doc.GetRowCount() < 200001);
+        
+        doc.EnsureFullyIndexed();
+        assert(doc.IsFullyIndexed());
+        assert(doc.GetRowCount() == 200001);
+        assert(doc.GetRowCells(100000)[0] == L"99999");
+    }
+    
+    DeleteFile(L"async_load.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestHeadTailOpen()
+{
+    std::cout << "Testing Head/Tail Open..." << std::endl;
+    {
+        std::ofstream out("head_tail.csv", std::ios::binary);
+        out << "ID,Text\n";
+        for (int i = 0; i < 200000; ++i) {
+            out << i << ",\"Line " << i << "\nsecond part\"\n";
+        }
+    }
+    
+    CsvDocument::LoadOptions options;
+    options.rowLimit = 1000;
+    options.continueInBackground = false;
+    
+    // 1. Head: first rows are indexed before LoadAsync returns
+    {
+        CsvDocument doc;
+        options.mode = CsvDocument::OpenMode::Head;
+        assert(doc.LoadAsync(L"head_tail.csv", nullptr, nullptr, CancellationToken(), options));
+        assert(!doc.IsIndexing());
+        assert(doc.GetRowCount() >= 1000 && doc.GetRowCount() < 200001);
+        assert(doc.GetRowCells(0)[0] == L"ID");
+        assert(doc.GetRowCells(999)[0] == L"998");
+        assert(doc.IsRowNumberExact(999));
+        
+        doc.EnsureFullyIndexed();
+        assert(doc.GetRowCount() == 200001);
+    }
+    
+    // 2. Tail: last rows are available with estimated numbers
+    {
+        CsvDocument doc;
+        options.mode = CsvDocument::OpenMode::Tail;
+        assert(doc.LoadAsync(L"head_tail.csv", nullptr, nullptr, CancellationToken(), options));
+        assert(!doc.IsIndexing());
+        size_t rows = doc.GetRowCount();
+        assert(rows > 1000);
+        auto last = doc.GetRowCells(rows - 1);
+        assert(last[0] == L"199999");
+        assert(last[1] == L"Line 199999\nsecond part");
+        assert(doc.GetRowCells(rows - 1000)[0] == L"199000");
+        
+        // Editing an estimated row edits the same row once numbers are exact
+        doc.UpdateCell(rows - 1, 1, L"Edited");
+        assert(doc.IsFullyIndexed());
+        assert(doc.GetRowCount() == 200001);
+        assert(doc.GetRowCells(200000)[1] == L"Edited");
+        assert(doc.GetRowCells(199999)[1] == L"Line 199998\nsecond part");
+    }
+    
+    // 3. Tail, then index in the background until numbers are exact
+    {
+        CsvDocument doc;
+        options.continueInBackground = true;
+        std::atomic<bool> finishedFlag(false);
+        assert(doc.LoadAsync(L"head_tail.csv", nullptr, [&](bool finished) { finishedFlag = finished; },
+                             CancellationToken(), options));
+        doc.WaitForIndexing();
+        assert(finishedFlag);
+        assert(doc.GetRowCount() == 200001);
+        assert(doc.IsRowNumberExact(200000));
+        assert(doc.GetRowCells(200000)[0] == L"199999");
+    }
+    
+    DeleteFile(L"head_tail.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestSeekByFraction()
+{
+    std::cout << "Testing Seek By Fraction..." << std::endl;
+    {
+        std::ofstream out("seek_fraction.csv", std::ios::binary);
+        out << "ID,Text\n";
+        for (int i = 0; i < 200000; ++i) {
+            out << i << ",\"Line " << i << "\nsecond part\"\n";
+        }
+    }
+    
+    CsvDocument doc;
+    CsvDocument::LoadOptions options;
+    options.mode = CsvDocument::OpenMode::Head;
+    options.rowLimit = 100;
+    options.continueInBackground = false;
+    assert(doc.LoadAsync(L"seek_fraction.csv", nullptr, nullptr, CancellationToken(), options));
+    
+    // Row count is extrapolated from sampled row lengths
+    size_t estimate = doc.GetEstimatedRowCount();
+    assert(estimate > 180000 && estimate < 220000);
+    
+    // Middle of the file: a real record, numbered approximately
+    size_t row = 0;
+    assert(doc.SeekToFraction(0.5, row));
+    assert(doc.IsRowAvailable(row));
+    assert(!doc.IsRowNumberExact(row));
+    auto cells = doc.GetRowCells(row);
+    int id = std::stoi(cells[0]);
+    assert(cells[1] == L"Line " + std::to_wstring(id) + L"\nsecond part");
+    assert(id > 95000 && id < 105000);
+    assert((size_t)std::abs((long long)row - (id + 1)) < 10000);
+    
+    // Within the indexed head, seeking is exact
+    assert(doc.SeekToFraction(0.0, row));
+    assert(row == 0 && doc.IsRowNumberExact(0));
+    
+    // End of the file
+    assert(doc.SeekToFraction(1.0, row));
+    assert(doc.GetRowCells(row)[0] == L"199999");
+    
+    doc.EnsureFullyIndexed();
+    assert(doc.GetEstimatedRowCount() == 200001);
+    assert(doc.SeekToFraction(1.0, row) && row == 200000);
+    
+    DeleteFile(L"seek_fraction.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestColumnStats()
+{
+    std::cout << "Testing Column Stats..." << std::endl;
+    {
+        std::ofstream out("column_stats.csv", std::ios::binary);
+        out << "A,B,C\n";
+        for (int i = 1; i < 5000; ++i) {
+            if (i == 10) out << "1,\"x,y\",3,4\n";          // Too wide (quoted delimiter not counted)
+            else if (i == 20) out << "1,2\n";                // Too narrow
+            else if (i == 4000) out << "1,2,3,4,5,6,7\n";    // Wide row far down
+            else out << i << ",\"multi\nline\"," << i << "\n";
+        }
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"column_stats.csv"));
+    assert(doc.GetRowCount() == 5000);
+    assert(doc.GetHeaderColumnCount() == 3);
+    assert(doc.GetMaxColumnCount() == 7);
+    auto hist = doc.GetColumnCountHistogram();
+    assert(hist.size() == 4 && hist[2] == 1 && hist[3] == 4997 && hist[4] == 1 && hist[7] == 1);
+    
+    // Jump between malformed rows
+    assert(doc.GetIrregularRowCount() == 3);
+    size_t row = 0;
+    assert(doc.FindIrregularRow(row) && row == 10);
+    assert(doc.FindIrregularRow(row) && row == 20);
+    assert(doc.FindIrregularRow(row) && row == 4000);
+    assert(!doc.FindIrregularRow(row));
+    assert(doc.FindIrregularRow(row, false) && row == 20);
+    
+    // Edits keep the statistics current without a full re-index
+    doc.UpdateCell(20, 2, L"fixed");
+    assert(doc.GetIrregularRowCount() == 2);
+    doc.DeleteRow(4000);
+    assert(doc.GetMaxColumnCount() == 4);
+    doc.InsertRow(5, { L"a", L"b", L"c", L"d", L"e" });
+    assert(doc.GetMaxColumnCount() == 5);
+    row = 0;
+    assert(doc.FindIrregularRow(row) && row == 5);
+    assert(doc.FindIrregularRow(row) && row == 11);
+    doc.InsertRow(doc.GetRowCount(), { L"x" });
+    assert(doc.GetIrregularRowCount() == 3);
+    
+    // Same result as indexing from scratch
+    auto incrementalHist = doc.GetColumnCountHistogram();
+    std::vector<std::vector<std::wstring>> incrementalRows;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) incrementalRows.push_back(doc.GetRowCells(r));
+    doc.RebuildRowIndex();
+    assert(doc.GetColumnCountHistogram() == incrementalHist);
+    assert(doc.GetIrregularRowCount() == 3);
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) assert(doc.GetRowCells(r) == incrementalRows[r]);
+    
+    DeleteFile(L"column_stats.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestRowView()
+{
+    std::cout << "Testing Row View..." << std::endl;
+    {
+        std::ofstream out("row_view.csv", std::ios::binary);
+        out << "Name,Note,Value\r\n";
+        out << "plain,\"say \"\"hi\"\", twice\",42\r\n";
+        out << "last,\"multi\nline\",7"; // No trailing newline
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"row_view.csv"));
+    assert(doc.GetRowCount() == 3);
+    
+    RowView view;
+    assert(doc.GetRowView(0, view));
+    assert(view.GetCellCount() == 3);
+    assert(view.GetCell(0) == "Name" && view.GetCell(2) == "Value"); // Line ending excluded
+    assert(!view.IsCellOwned(0));
+    
+    // Unquoted cells borrow the mapping, quoted ones are unescaped into the view
+    assert(doc.GetRowView(1, view));
+    assert(view.GetCell(0) == "plain" && !view.IsCellOwned(0));
+    assert(view.GetCell(1) == "say \"hi\", twice" && view.IsCellOwned(1));
+    assert(view.GetCell(2) == "42" && !view.IsCellOwned(2));
+    assert(doc.DecodeCell(view.GetCell(1)) == L"say \"hi\", twice");
+    
+    assert(doc.GetRowView(2, view));
+    assert(view.GetCell(1) == "multi\nline");
+    
+    // Appending gives the old last row a newline in the add buffer: the row now spans pieces
+    doc.InsertRow(3, { L"new", L"", L"1" });
+    assert(doc.GetRowCount() == 4);
+    assert(doc.GetRowView(2, view));
+    assert(view.GetCellCount() == 3 && view.IsCellOwned(0));
+    assert(view.GetCell(0) == "last" && view.GetCell(2) == "7");
+    assert(doc.GetRowCells(3) == std::vector<std::wstring>({ L"new", L"", L"1" }));
+    
+    // Unavailable rows
+    assert(!doc.GetRowView(100, view));
+    
+    DeleteFile(L"row_view.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestParsedRow()
+{
+    std::cout << "Testing Parsed Row..." << std::endl;
+    {
+        std::ofstream out("parsed_row.csv", std::ios::binary);
+        out << "a,b,c\n";
+        out << "1,\"x,y\",3\n";
+        out << "short\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"parsed_row.csv"));
+    
+    ParsedRow row;
+    assert(doc.GetParsedRow(1, row));
+    assert(row.GetCellCount() == 3);
+    assert(row.GetCell(0) == L"1" && row.GetCell(1) == L"x,y" && row.GetCell(2) == L"3");
+    assert(row.ToVector() == doc.GetRowCells(1));
+    
+    // Reuse keeps the arena
+    assert(doc.GetParsedRow(2, row));
+    assert(row.GetCellCount() == 1 && row.GetCell(0) == L"short");
+    assert(!doc.GetParsedRow(100, row));
+    assert(row.GetCellCount() == 0);
+    
+    // Column operations and paste go through the same arena parser
+    doc.InsertColumn(1, L"n,ew");
+    assert(doc.GetRowCells(0) == std::vector<std::wstring>({ L"a", L"n,ew", L"b", L"c" }));
+    assert(doc.GetRowCells(1) == std::vector<std::wstring>({ L"1", L"n,ew", L"x,y", L"3" }));
+    assert(doc.GetRowCells(2) == std::vector<std::wstring>({ L"short", L"n,ew" }));
+    doc.DeleteColumn(1);
+    assert(doc.GetRowCells(1) == std::vector<std::wstring>({ L"1", L"x,y", L"3" }));
+    
+    doc.PasteCells(2, 2, L"p\t\"q\"\"r\"\nz");
+    assert(doc.GetRowCells(2) == std::vector<std::wstring>({ L"short", L"", L"p", L"q\"r" }));
+    assert(doc.GetRowCount() == 4);
+    assert(doc.GetRowCells(3) == std::vector<std::wstring>({ L"", L"", L"z" }));
+    
+    DeleteFile(L"parsed_row.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestRowCache()
+{
+    std::cout << "Testing Row Cache..." << std::endl;
+    {
+        std::ofstream out("row_cache.csv", std::ios::binary);
+        for (int i = 0; i < 10; ++i) out << "r" << i << ",v" << i << "\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"row_cache.csv"));
+    
+    // First pass misses, repeated passes hit
+    for (int pass = 0; pass < 3; ++pass) {
+        for (size_t r = 0; r < 5; ++r) {
+            const ParsedRow* row = doc.GetCachedRow(r);
+            assert(row && row->GetCell(0) == L"r" + std::to_wstring(r));
+        }
+    }
+    assert(doc.GetRowCacheMisses() == 5);
+    assert(doc.GetRowCacheHits() == 10);
+    
+    // An in-place edit invalidates only its row
+    uint64_t version = doc.GetVersion();
+    doc.UpdateCell(2, 1, L"changed");
+    assert(doc.GetVersion() == version);
+    size_t misses = doc.GetRowCacheMisses();
+    assert(doc.GetCachedRow(2)->GetCell(1) == L"changed");
+    assert(doc.GetCachedRow(3)->GetCell(1) == L"v3");
+    assert(doc.GetRowCacheMisses() == misses + 1);
+    
+    // Inserting a row renumbers the rest
+    doc.InsertRow(1, { L"new", L"row" });
+    assert(doc.GetVersion() != version);
+    assert(doc.GetCachedRow(1)->GetCell(0) == L"new");
+    assert(doc.GetCachedRow(3)->GetCell(1) == L"changed");
+    
+    doc.Undo();
+    assert(doc.GetCachedRow(1)->GetCell(0) == L"r1");
+    
+    assert(doc.GetCachedRow(100) == nullptr);
+    
+    // Eviction recycles the least recently used entry
+    RowCache cache(2);
+    cache.Insert(0, 1).AddCell(L"a");
+    cache.Insert(1, 1).AddCell(L"b");
+    assert(cache.Find(0, 1));
+    cache.Insert(2, 1).AddCell(L"c");
+    assert(cache.GetSize() == 2);
+    assert(!cache.Find(1, 1));
+    assert(cache.Find(0, 1)->GetCell(0) == L"a");
+    assert(!cache.Find(0, 2)); // Stale version
+    cache.Invalidate(0, 3);
+    assert(cache.GetSize() == 0);
+    
+    DeleteFile(L"row_cache.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestPrefetch()
+{
+    std::cout << "Testing Prefetch..." << std::endl;
+    {
+        std::ofstream out("prefetch.csv", std::ios::binary);
+        for (int i = 0; i < 1000; ++i) out << "r" << i << ",v" << i << "\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"prefetch.csv"));
+    
+    // Rows prefetched ahead are claimed by the cache without parsing
+    doc.PrefetchRows(100, 50, true);
+    doc.WaitForPrefetch();
+    for (size_t r = 100; r < 150; ++r) {
+        assert(doc.GetCachedRow(r)->GetCell(0) == L"r" + std::to_wstring(r));
+    }
+    assert(doc.GetPrefetchHits() == 50);
+    
+    // Backward, skipping rows already cached
+    doc.PrefetchRows(80, 40, false);
+    doc.WaitForPrefetch();
+    for (size_t r = 80; r < 120; ++r) assert(doc.GetCachedRow(r));
+    assert(doc.GetPrefetchHits() == 70);
+    
+    // Edits drop prefetched rows
+    doc.PrefetchRows(500, 10, true);
+    doc.WaitForPrefetch();
+    doc.UpdateCell(505, 0, L"edited");
+    assert(doc.GetCachedRow(505)->GetCell(0) == L"edited");
+    assert(doc.GetPrefetchHits() == 70);
+    
+    // Cancelling mid-way is safe
+    doc.PrefetchRows(0, 1000, true);
+    doc.PrefetchRows(0, 1000, false);
+    doc.StopPrefetch();
+    
+    EditorState state;
+    state.SetScrollRow(10);
+    assert(state.GetScrollDirection() == 1 && state.GetScrollVelocity() > 0);
+    state.SetScrollRow(5);
+    assert(state.GetScrollDirection() == -1 && state.GetScrollVelocity() < 0);
+    
+    DeleteFile(L"prefetch.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestColumnRange()
+{
+    std::cout << "Testing Column Range..." << std::endl;
+    {
+        std::ofstream out("column_range.csv", std::ios::binary);
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 2000; ++c) {
+                if (c > 0) out << ",";
+                if (c % 7 == 3) out << "\"q," << r << "_" << c << "\"";
+                else out << r << "_" << c;
+            }
+            out << "\n";
+        }
+        out << "short,row\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"column_range.csv"));
+    
+    std::vector<std::wstring> all = doc.GetRowCells(1);
+    assert(all.size() == 2000);
+    std::vector<std::wstring> part = doc.GetRowCells(1, 1500, 15);
+    assert(part.size() == 15);
+    for (size_t i = 0; i < part.size(); ++i) assert(part[i] == all[1500 + i]);
+    assert(doc.GetRowCells(1, 1995, 100).size() == 5);
+    assert(doc.GetRowCells(1, 3, 1)[0] == L"q,1_3");
+    assert(doc.GetRowCells(3, 1, 5) == std::vector<std::wstring>({ L"row" }));
+    assert(doc.GetRowCells(3, 5, 5).empty());
+    
+    // Cached ranges are reused when they cover the request
+    const ParsedRow* row = doc.GetCachedRow(0, 100, 20);
+    assert(row->GetFirstColumn() == 100 && row->GetCellCount() == 20 && !row->IsComplete());
+    assert(row->GetCell(5) == L"0_105");
+    size_t misses = doc.GetRowCacheMisses();
+    assert(doc.GetCachedRow(0, 105, 10) && doc.GetRowCacheMisses() == misses);
+    row = doc.GetCachedRow(0, 90, 20);
+    assert(doc.GetRowCacheMisses() == misses + 1 && row->GetFirstColumn() == 90);
+    row = doc.GetCachedRow(3, 0, 10);
+    assert(row->IsComplete() && row->Covers(1, 100));
+    
+    // An empty request (a window too narrow for a column) caches no claim about the row
+    row = doc.GetCachedRow(2, 50, 0);
+    assert(row && row->GetCellCount() == 0 && !row->IsComplete());
+    row = doc.GetCachedRow(2, 50, 3);
+    assert(row->GetCellCount() == 3 && row->GetCell(0) == L"2_50");
+    
+    // Copy only parses the selected columns
+    std::wstring text = doc.GetRangeAsText(0, 1003, 1, 1004);
+    assert(text == L"0_1003\tq,0_1004\r\n1_1003\tq,1_1004");
+    
+    DeleteFile(L"column_range.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestFieldCheckpoints()
+{
+    std::cout << "Testing Field Checkpoints..." << std::endl;
+    {
+        std::ofstream out("checkpoints.csv", std::ios::binary);
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 1000; ++c) {
+                if (c > 0) out << ",";
+                if (c % 64 == 0) out << "\"a,\"\"" << r << "_" << c << "\""; // Quoted cells at checkpoint fields
+                else out << r << "_" << c;
+            }
+            out << "\n";
+        }
+        out << "narrow,row\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"checkpoints.csv"));
+    std::vector<std::wstring> all = doc.GetRowCells(1);
+    assert(all.size() == 1000 && all[128] == L"a,\"1_128");
+    
+    // The full parse left checkpoints behind; ranged reads now start from them
+    size_t bytes = doc.GetFieldCheckpointBytes();
+    assert(bytes == (1000 / 64) * sizeof(uint32_t));
+    for (size_t c = 0; c < 1000; c += 37) {
+        assert(doc.GetRowCells(1, c, 3) == std::vector<std::wstring>(all.begin() + c, all.begin() + (std::min)(c + 3, all.size())));
+    }
+    assert(doc.GetRowCells(1, 960, 1)[0] == L"a,\"1_960");
+    
+    // A ranged read extends them lazily
+    assert(doc.GetRowCells(2, 500, 1)[0] == L"2_500");
+    assert(doc.GetFieldCheckpointBytes() == bytes + (500 / 64) * sizeof(uint32_t));
+    assert(doc.GetRowCells(2, 990, 1)[0] == L"2_990");
+    assert(doc.GetFieldCheckpointBytes() == 2 * bytes);
+    assert(doc.GetRowCells(3, 100, 1).empty());
+    
+    // Editing a row drops its checkpoints
+    doc.UpdateCell(1, 900, L"edited,");
+    assert(doc.GetFieldCheckpointBytes() == bytes);
+    assert(doc.GetRowCells(1, 900, 2) == std::vector<std::wstring>({ L"edited,", L"1_901" }));
+    
+    doc.DropFieldCheckpoints();
+    assert(doc.GetFieldCheckpointBytes() == 0);
+    assert(doc.GetRowCells(0, 999, 1)[0] == L"0_999");
+    
+    DeleteFile(L"checkpoints.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestInPlaceCellUpdate()
+{
+    std::cout << "Testing In-Place Cell Update..." << std::endl;
+    {
+        std::ofstream out("in_place.csv", std::ios::binary);
+        out << "id,\"name\",note\r\n";
+        out << "1,\"Ann\",\"x\"\r\n";
+        out << "2,Bob,y\r\n";
+    }
+    
+    CsvDocument doc;
+    assert(doc.Load(L"in_place.csv"));
+    
+    // Only the cell's bytes change: other cells keep their original quoting
+    doc.UpdateCell(1, 1, L"Ann, Jr.");
+    std::vector<uint8_t> raw = doc.GetRowRaw(1);
+    assert(std::string(raw.begin(), raw.end()) == "1,\"Ann, Jr.\",\"x\"");
+    assert(doc.GetRowCells(2) == std::vector<std::wstring>({ L"2", L"Bob", L"y" }));
+    
+    doc.UpdateCell(2, 2, L"");
+    raw = doc.GetRowRaw(2);
+    assert(std::string(raw.begin(), raw.end()) == "2,Bob,");
+    doc.UpdateCell(0, 0, L"say \"id\"");
+    assert(doc.GetRowCells(0)[0] == L"say \"id\"");
+    assert(doc.GetIrregularRowCount() == 0);
+    
+    // Past the end of the row: padded
+    doc.UpdateCell(2, 4, L"z");
+    assert(doc.GetRowCells(2) == std::vector<std::wstring>({ L"2", L"Bob", L"", L"", L"z" }));
+    assert(doc.GetIrregularRowCount() == 1);
+    
+    // Row index stays consistent with a full rebuild
+    std::vector<std::vector<std::wstring>> before;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) before.push_back(doc.GetRowCells(r));
+    doc.RebuildRowIndex();
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) assert(doc.GetRowCells(r) == before[r]);
+    
+    // Deleting across pieces that both start and end mid-piece
+    PieceTable pt;
+    pt.Insert(0, (const uint8_t*)"abcdef", 6);
+    pt.Insert(6, (const uint8_t*)"ghijkl", 6);
+    pt.Insert(12, (const uint8_t*)"mnopqr", 6);
+    pt.Delete(4, 10); // "efghijklmn"
+    assert(pt.GetSize() == 8);
+    std::string rest;
+    for (uint64_t i = 0; i < pt.GetSize(); ++i) rest += (char)pt.GetAt(i);
+    assert(rest == "abcdopqr");
+    
+    DeleteFile(L"in_place.csv");
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestTextCodec()
+{
+    std::cout << "Testing Text Codec..." << std::endl;
+    auto decode = [](const std::string& bytes) {
+        std::wstring out;
+        TextCodec::AppendUtf8((const uint8_t*)bytes.data(), bytes.size(), out);
+        return out;
+    };
+    auto encode = [](const std::wstring& text) {
+        std::string out;
+        TextCodec::AppendAsUtf8(text.data(), text.size(), out);
+        return out;
+    };
+    
+    // ASCII runs longer than a vector, with multi-byte text around the boundaries
+    std::string ascii(100, 'a');
+    assert(decode(ascii) == std::wstring(100, L'a'));
+    std::string mixed = ascii.substr(0, 15) + "\xC3\xA9" + ascii.substr(0, 17) + "\xE3\x81\x82" + "\xF0\x9F\x98\x80" + "z";
+    std::wstring wide = std::wstring(15, L'a') + L"\u00E9" + std::wstring(17, L'a') + L"\u3042";
+    wide += (wchar_t)0xD83D;
+    wide += (wchar_t)0xDE00;
+    wide += L'z';
+    assert(decode(mixed) == wide);
+    assert(encode(wide) == mixed);
+    
+    // Invalid input becomes U+FFFD per maximal subpart
+    std::wstring bad = decode("a\x80" "b\xC0\xAF" "c\xE3\x81" "d\xED\xA0\x80" "e\xF4\x90\x80\x80");
+    std::wstring expected = L"a\uFFFDb\uFFFD\uFFFDc\uFFFDd\uFFFD\uFFFD\uFFFDe\uFFFD\uFFFD\uFFFD\uFFFD";
+    assert(bad == expected);
+    std::wstring lone = L"x";
+    lone += (wchar_t)0xD800; // Unpaired surrogate
+    assert(encode(lone) == "x\xEF\xBF\xBD");
+    
+    // UTF-16 big-endian swaps across the vector width
+    std::wstring text = std::wstring(20, L'b') + L"\u3042";
+    std::vector<uint8_t> be;
+    TextCodec::AppendAsUtf16(text.data(), text.size(), true, be);
+    assert(be.size() == 42 && be[0] == 0 && be[1] == 'b' && be[40] == 0x30 && be[41] == 0x42);
+    std::wstring back;
+    TextCodec::AppendUtf16(be.data(), be.size(), true, back);
+    assert(back == text);
+    std::vector<uint8_t> le;
+    TextCodec::AppendAsUtf16(text.data(), text.size(), false, le);
+    assert(le[0] == 'b' && le[1] == 0);
+    back.clear();
+    TextCodec::AppendUtf16(le.data(), le.size(), false, back);
+    assert(back == text);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestEncodingDetection()
+{
+    std::cout << "Testing Encoding Detection..." << std::endl;
+    
+    // UTF-8 without BOM
+    CreateDummyFile(L"test_detect_utf8.csv", "name,city\nJos\xC3\xA9,M\xC3\xBCnchen\n");
+    CsvDocument utf8;
+    utf8.Load(L"test_detect_utf8.csv");
+    assert(utf8.GetEncoding() == FileEncoding::UTF8);
+    assert(!utf8.GetEncodingReport().hasBom && utf8.GetEncodingReport().confidence >= 0.9);
+    assert(utf8.GetEncodingReport().invalidCount == 0);
+    assert(utf8.GetRowCells(1)[0] == L"Jos\u00E9");
+    
+    // Latin-1 bytes are not UTF-8
+    CreateDummyFile(L"test_detect_ansi.csv", "name,city\nJos\xE9,M\xFCnchen\nna\xEFve,caf\xE9\n");
+    CsvDocument ansi;
+    ansi.Load(L"test_detect_ansi.csv");
+    assert(ansi.GetEncoding() == FileEncoding::ANSI);
+    assert(ansi.GetEncodingReport().invalidCount == 4);
+    assert(ansi.GetEncodingReport().invalidOffsets[0] == 13);
+    
+    // In a double-byte code page 0x7C can be a trail byte ("\x83|" is one Shift-JIS character):
+    // the indexer's column counts agree with the parsed rows either way
+    CreateDummyFile(L"test_detect_dbcs.csv", "a|b\n\x83|x|y\nc\x83|\n\"\x83|\"|z\n");
+    CsvDocument dbcs;
+    dbcs.Load(L"test_detect_dbcs.csv");
+    assert(dbcs.GetEncoding() == FileEncoding::ANSI);
+    dbcs.SetDelimiter(L'|');
+    dbcs.RebuildRowIndex();
+    size_t maxColumns = 0, irregular = 0;
+    for (size_t r = 0; r < dbcs.GetRowCount(); ++r) {
+        size_t columns = dbcs.GetRowCells(r).size();
+        maxColumns = (std::max)(maxColumns, columns);
+        irregular += columns != dbcs.GetRowCells(0).size();
+    }
+    assert(dbcs.GetRowCount() == 4);
+    assert(dbcs.GetMaxColumnCount() == maxColumns && dbcs.GetIrregularRowCount() == irregular);
+    
+    // UTF-16 LE without BOM: "A,B\nC,D\n"
+    std::string utf16;
+    for (char c : std::string("A,B\nC,D\n")) { utf16 += c; utf16 += '\0'; }
+    CreateDummyFile(L"test_detect_utf16.csv", utf16);
+    CsvDocument wide;
+    wide.Load(L"test_detect_utf16.csv");
+    assert(wide.GetEncoding() == FileEncoding::UTF16_LE);
+    assert(wide.GetRowCount() == 2 && wide.GetRowCells(1)[1] == L"D");
+    
+    // Large file: load samples it, the whole-file pass finds every invalid byte across chunk boundaries
+    std::string big;
+    const std::string line = "ab\xC3\xA9,cd\n"; // 8 bytes
+    while (big.size() < 6 * 1024 * 1024) big += line;
+    big[1000] = '\xFF';
+    big[4000000] = '\xFF';
+    CreateDummyFile(L"test_detect_big.csv", big);
+    CsvDocument large;
+    large.Load(L"test_detect_big.csv");
+    assert(large.GetEncoding() == FileEncoding::UTF8);
+    const CsvDocument::EncodingReport& sampled = large.GetEncodingReport();
+    assert(!sampled.wholeFile && sampled.bytesChecked < big.size());
+    assert(sampled.invalidCount == 1 && sampled.invalidOffsets[0] == 1000);
+    CsvDocument::EncodingReport full = large.AnalyzeEncoding(true);
+    assert(full.wholeFile && full.bytesChecked == big.size());
+    assert(full.encoding == FileEncoding::UTF8 && full.confidence > 0.8);
+    assert(full.invalidCount == 2);
+    assert(full.invalidOffsets.size() == 2 && full.invalidOffsets[0] == 1000 && full.invalidOffsets[1] == 4000000);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestUtf16FastPath()
+{
+    std::cout << "Testing UTF-16 Fast Path..." << std::endl;
+    
+    // Scanners find needles on both sides of the vector width, in either byte order
+    std::string bytes(40, 'x');
+    bytes[37] = ',';
+    assert(SimdScan::FindAny((const uint8_t*)bytes.data(), bytes.size(), '"', ',', '\n') == 37);
+    assert(SimdScan::FindAny((const uint8_t*)bytes.data(), 30, '"', ',', '\n') == 30);
+    std::wstring units = std::wstring(19, L'y') + L"\u3042\n";
+    for (bool bigEndian : { false, true }) {
+        std::vector<uint8_t> encoded;
+        TextCodec::AppendAsUtf16(units.data(), units.size(), bigEndian, encoded);
+        assert(SimdScan::FindAnyUtf16(encoded.data(), units.size(), bigEndian, L'"', L',', L'\n') == 20);
+        assert(SimdScan::FindAnyUtf16(encoded.data(), units.size(), bigEndian, L'"', 0x3042, L'\n') == 19);
+        assert(SimdScan::FindAnyUtf16(encoded.data(), 19, bigEndian, L'"', L',', L'\n') == 19);
+        // Units whose bytes are a comma and a newline are neither
+        std::wstring tricky = L"\u0A2C\u2C0A";
+        encoded.clear();
+        TextCodec::AppendAsUtf16(tricky.data(), tricky.size(), bigEndian, encoded);
+        assert(SimdScan::FindAnyUtf16(encoded.data(), 2, bigEndian, L'"', L',', L'\n') == 2);
+    }
+    
+    // Documents with long fields, quoted delimiters and newlines, and characters whose bytes
+    // are a comma and a newline
+    std::wstring longField(50, L'z');
+    std::wstring content = L"id,text\r\n1," + longField + L"\r\n2,\"a,b\nc \"\"q\"\"\"\r\n3,\u0A2C\u2C0A\r\n";
+    for (bool bigEndian : { false, true }) {
+        std::vector<uint8_t> encoded = bigEndian ? std::vector<uint8_t>{ 0xFE, 0xFF } : std::vector<uint8_t>{ 0xFF, 0xFE };
+        TextCodec::AppendAsUtf16(content.data(), content.size(), bigEndian, encoded);
+        CreateDummyFile(L"test_utf16_fast.csv", std::string(encoded.begin(), encoded.end()));
+        
+        CsvDocument doc;
+        doc.Load(L"test_utf16_fast.csv");
+        assert(doc.GetEncoding() == (bigEndian ? FileEncoding::UTF16_BE : FileEncoding::UTF16_LE));
+        assert(doc.GetRowCount() == 4);
+        assert(doc.GetRowCells(1)[1] == longField);
+        assert(doc.GetRowCells(2)[1] == L"a,b\nc \"q\"");
+        assert(doc.GetRowCells(3)[1] == L"\u0A2C\u2C0A");
+        assert(doc.GetRowCells(2, 1, 1)[0] == L"a,b\nc \"q\"");
+        
+        RowView view;
+        assert(doc.GetRowView(1, view) && view.GetCellCount() == 2);
+        if (view.HasWideCells()) {
+            assert(!bigEndian && view.GetWideCell(1) == longField);
+            assert(!view.IsCellOwned(1)); // Points into the file mapping
+        }
+    }
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestDialects()
+{
+    std::cout << "Testing Dialect Parsers..." << std::endl;
+    
+    // Common delimiters get their own instantiation; others share the generic one
+    assert(SelectCsvDialect(FileEncoding::UTF8, L'\t').delimiter == L'\t');
+    assert(SelectCsvDialect(FileEncoding::UTF16_LE, L'|').delimiter == L'|');
+    assert(SelectCsvDialect(FileEncoding::UTF8, L'^').delimiter == 0);
+    assert(SelectCsvDialect(FileEncoding::UTF16_BE, L',').delimiter == 0);
+    assert(&SelectCsvDialect(FileEncoding::UTF8, L';') != &SelectCsvDialect(FileEncoding::UTF16_LE, L';'));
+    
+    // Same table in every dialect: quoted delimiters and newlines, and the other delimiters as text
+    for (wchar_t delimiter : { L',', L'\t', L';', L'|', L'^' }) {
+        for (FileEncoding encoding : { FileEncoding::UTF8, FileEncoding::UTF16_LE, FileEncoding::UTF16_BE }) {
+            std::wstring d(1, delimiter);
+            std::wstring other = L",;|\t^";
+            other.erase(other.find(delimiter), 1);
+            std::wstring content = L"a" + d + L"b" + other + d + L"c\r\n\"x" + d + L"\ny\"" + d + d + L"z\n";
+            std::vector<uint8_t> bytes;
+            if (encoding == FileEncoding::UTF8) {
+                TextCodec::AppendAsUtf8(content.data(), content.size(), bytes);
+            } else {
+                bool bigEndian = (encoding == FileEncoding::UTF16_BE);
+                bytes = bigEndian ? std::vector<uint8_t>{ 0xFE, 0xFF } : std::vector<uint8_t>{ 0xFF, 0xFE };
+                TextCodec::AppendAsUtf16(content.data(), content.size(), bigEndian, bytes);
+            }
+            CreateDummyFile(L"test_dialect.csv", std::string(bytes.begin(), bytes.end()));
+            
+            CsvDocument doc;
+            doc.SetDelimiter(delimiter);
+            doc.Load(L"test_dialect.csv");
+            assert(doc.GetRowCount() == 2);
+            assert(doc.GetMaxColumnCount() == 3);
+            std::vector<std::wstring> row0 = doc.GetRowCells(0);
+            assert(row0.size() == 3 && row0[1] == L"b" + other && row0[2] == L"c");
+            std::vector<std::wstring> row1 = doc.GetRowCells(1);
+            assert(row1.size() == 3 && row1[0] == L"x" + d + L"\ny" && row1[1].empty() && row1[2] == L"z");
+            assert(doc.GetRowCells(1, 2, 1)[0] == L"z");
+        }
+    }
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+// Row-major reference for Search: first matching cell from (row, col), honouring includeStart
+bool ReferenceSearch(CsvDocument& doc, const std::wstring& query, size_t& row, size_t& col,
+                     const CsvDocument::SearchOptions& options)
+{
+    auto fold = [&](std::wstring text) {
+        if (!options.matchCase) for (auto& ch : text) ch = towlower(ch);
+        return text;
+    };
+    auto matches = [&](const std::wstring& cell) {
+        if (options.mode == CsvDocument::SearchMode::Exact) return fold(cell) == fold(query);
+        return fold(cell).find(fold(query)) != std::wstring::npos;
+    };
+    std::vector<std::pair<size_t, size_t>> cells;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) {
+        auto rowCells = doc.GetRowCells(r);
+        for (size_t c = 0; c < rowCells.size(); ++c) {
+            if (matches(rowCells[c])) cells.push_back({ r, c });
+        }
+    }
+    std::pair<size_t, size_t> start(row, col);
+    if (options.forward) {
+        for (auto& cell : cells) {
+            if (cell > start || (options.includeStart && cell == start)) { row = cell.first; col = cell.second; return true; }
+        }
+    } else {
+        for (auto it = cells.rbegin(); it != cells.rend(); ++it) {
+            if (*it < start || (options.includeStart && *it == start)) { row = it->first; col = it->second; return true; }
+        }
+    }
+    return false;
+}
+
+void TestByteSearch()
+{
+    std::cout << "Testing Byte-Level Search..." << std::endl;
+    
+    // Kernels: first and last occurrence, on both sides of the vector width
+    std::string hay = std::string(20, 'a') + "needle" + std::string(20, 'b') + "needle" + "c";
+    const uint8_t* data = (const uint8_t*)hay.data();
+    assert(SimdScan::FindSubstring(data, hay.size(), (const uint8_t*)"needle", 6) == 20);
+    assert(SimdScan::FindLastSubstring(data, hay.size(), (const uint8_t*)"needle", 6) == 46);
+    assert(SimdScan::FindSubstring(data, 25, (const uint8_t*)"needle", 6) == 25);
+    assert(SimdScan::FindLastSubstring(data, hay.size(), (const uint8_t*)"c", 1) == hay.size() - 1);
+    
+    // Quoted cells, escaped quotes, delimiters inside quotes, multi-byte text
+    std::string content = "id,name,note\n";
+    const char* words[] = { "needle", "\"hay, needle\"", "N\xC3\xA9" "edle", "\"say \"\"needle\"\"\"", "12", "x12y", "hay" };
+    for (int r = 1; r < 120; ++r) {
+        content += std::to_string(r) + "," + words[r % 7 == 0 ? 6 : (r * 5) % 7] + "," + words[(r * 3) % 7] + "\n";
+    }
+    CreateDummyFile(L"test_bytesearch.csv", content);
+    
+    for (bool wide : { false, true }) {
+        CsvDocument doc;
+        if (wide) {
+            // Same table as UTF-16 LE
+            CsvDocument utf8;
+            utf8.Load(L"test_bytesearch.csv");
+            std::wstring text;
+            for (size_t r = 0; r < utf8.GetRowCount(); ++r) {
+                std::vector<uint8_t> raw = utf8.GetRowRaw(r);
+                text += utf8.DecodeCell(std::string_view((const char*)raw.data(), raw.size())) + L"\n";
+            }
+            std::vector<uint8_t> bytes = { 0xFF, 0xFE };
+            TextCodec::AppendAsUtf16(text.data(), text.size(), false, bytes);
+            CreateDummyFile(L"test_bytesearch16.csv", std::string(bytes.begin(), bytes.end()));
+            doc.Load(L"test_bytesearch16.csv");
+        } else {
+            doc.Load(L"test_bytesearch.csv");
+        }
+        assert(doc.IsFullyIndexed()); // The byte-level path needs the complete index
+        doc.UpdateCell(40, 1, L"edited needle"); // Matches in the add buffer too
+        
+        const wchar_t* queries[] = { L"needle", L"N\u00E9edle", L"12", L"hay, needle", L"\"needle\"", L"absent" };
+        for (const wchar_t* query : queries) {
+            for (int mode = 0; mode < 4; ++mode) {
+                CsvDocument::SearchOptions options;
+                options.matchCase = (mode & 1) == 0;
+                options.mode = (mode & 2) ? CsvDocument::SearchMode::Exact : CsvDocument::SearchMode::Contains;
+                for (bool forward : { true, false }) {
+                    options.forward = forward;
+                    for (size_t startRow : { (size_t)0, (size_t)5, (size_t)40, (size_t)119 }) {
+                        for (size_t startCol : { (size_t)0, (size_t)1, (size_t)2 }) {
+                            options.includeStart = (startCol == 1);
+                            size_t r = startRow, c = startCol, refR = startRow, refC = startCol;
+                            bool found = doc.Search(query, r, c, options);
+                            bool expected = ReferenceSearch(doc, query, refR, refC, options);
+                            assert(found == expected);
+                            if (found) assert(r == refR && c == refC);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestParallelSearch()
+{
+    std::cout << "Testing Parallel Search..." << std::endl;
+    
+    // Matches are sparse and clustered, so several chunks hold one
+    std::string content = "id,value\n";
+    for (int r = 1; r < 30000; ++r) {
+        bool hit = (r % 7000 == 13) || (r % 7000 == 14) || r == 29990;
+        content += std::to_string(r) + "," + (hit ? "Target" : "filler") + "\n";
+    }
+    CreateDummyFile(L"test_parallel_search.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_parallel_search.csv");
+    
+    for (unsigned threads : { 1u, 4u }) {
+        doc.SetSearchThreadCount(threads);
+        for (bool matchCase : { true, false }) { // Byte-level scan, exact and ASCII-caseless
+            CsvDocument::SearchOptions options;
+            options.matchCase = matchCase;
+            for (bool forward : { true, false }) {
+                options.forward = forward;
+                for (size_t startRow : { (size_t)0, (size_t)13, (size_t)7013, (size_t)20000, (size_t)29999 }) {
+                    for (bool includeStart : { true, false }) {
+                        options.includeStart = includeStart;
+                        size_t r = startRow, c = 1, refR = startRow, refC = 1;
+                        bool found = doc.Search(L"Target", r, c, options);
+                        assert(found == ReferenceSearch(doc, L"Target", refR, refC, options));
+                        if (found) assert(r == refR && c == refC);
+                    }
+                }
+            }
+        }
+    }
+    
+    // Walking through every match gives them in order
+    doc.SetSearchThreadCount(4);
+    CsvDocument::SearchOptions options;
+    size_t r = 0, c = 0, count = 0, lastRow = 0;
+    while (doc.Search(L"Target", r, c, options)) {
+        assert(count == 0 || r > lastRow);
+        lastRow = r;
+        count++;
+    }
+    assert(count == 11);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestRegexEngine()
+{
+    std::cout << "Testing Regex Engine..." << std::endl;
+    
+    // Same answers as std::wregex
+    const wchar_t* patterns[] = {
+        L"abc", L"^abc", L"abc$", L"^$", L"a|bc|", L"a(b|c)*d", L"(?:ab)+c", L"colou?r", L"x{2,3}y", L"x{2}",
+        L"x{2,}", L"[a-c]+\\d", L"[^a-z]", L"\\w+@\\w+\\.com", L"\\s", L"\\S+$", L".", L"a.c", L"[\\d.]+%",
+        L"\\(\\d+\\)", L"(a|ab)(c|bcd)(d*)", L"^(\\d{3})-\\d{4}$", L"[-a]", L"[a-]", L"\\u00e9", L"\u00e9+",
+        L"a*?b", L"[\\]x]", L"\\x41"
+    };
+    const wchar_t* subjects[] = {
+        L"", L"abc", L"xabcx", L"ABC", L"abd", L"acbd", L"ababc", L"color", L"COLOUR", L"xxy", L"xxxxy",
+        L"cab1", L"123", L"mail me at joe@example.com", L"tab\there", L"a\nc", L"a.c", L"12.5%", L"(42)",
+        L"a{b", L"abcd", L"555-1234", L"-", L"Caf\u00e9", L"CAF\u00c9", L"aaab", L"]", L"A"
+    };
+    for (const wchar_t* pattern : patterns) {
+        for (bool icase : { false, true }) {
+            auto flags = icase ? (std::regex_constants::ECMAScript | std::regex_constants::icase) : std::regex_constants::ECMAScript;
+            std::wregex reference(pattern, flags);
+            RegexEngine engine;
+            assert(engine.Compile(pattern, icase));
+            for (const wchar_t* subject : subjects) {
+                std::wstring text = subject;
+                bool expected = std::regex_search(text, reference);
+                assert(engine.Search(text.data(), text.size()) == expected);
+                std::string utf8;
+                TextCodec::AppendAsUtf8(text.data(), text.size(), utf8);
+                assert(engine.SearchUtf8((const uint8_t*)utf8.data(), utf8.size()) == expected);
+                std::vector<uint8_t> be;
+                TextCodec::AppendAsUtf16(text.data(), text.size(), true, be);
+                assert(engine.SearchUtf16(be.data(), be.size(), true) == expected);
+            }
+        }
+    }
+    
+    // Unsupported constructs are left to std::wregex
+    RegexEngine engine;
+    assert(!engine.Compile(L"(a)\\1", false));
+    assert(!engine.Compile(L"a(?=b)", false));
+    assert(!engine.Compile(L"\\bword", false));
+    assert(!engine.Compile(L"(ab", false));
+    
+    // So are bounds past the repeat limit, which std::wregex still reads as bounds, not literals
+    assert(!engine.Compile(L"x{12345}", false) && !engine.Compile(L"x{99999999999,}", false));
+    assert(!engine.Compile(L"x{1,12345}", false));
+    assert(std::regex_search(std::wstring(L"xxy"), std::wregex(L"x{1,12345}y")));
+    
+    // Catastrophic backtracking for a backtracking matcher is linear here
+    assert(engine.Compile(L"(a+)+b", false));
+    std::string as(100000, 'a');
+    assert(!engine.SearchUtf8((const uint8_t*)as.data(), as.size()));
+    assert(engine.GetDfaStateCount() < 16);
+    
+    // Regex search over a document agrees with the std::wregex scan
+    std::string content = "code,city\nA-17,Z\xC3\xBCrich\nb-2,Bern\nC-300,Gen\xC3\xA8ve\nx,\"Quoted, city\"\n";
+    CreateDummyFile(L"test_regex_search.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_regex_search.csv");
+    CsvDocument::SearchOptions options;
+    options.mode = CsvDocument::SearchMode::Regex;
+    options.includeStart = true;
+    size_t r = 0, c = 0;
+    assert(doc.Search(L"^[a-z]-\\d+$", r, c, options) && r == 1 && c == 0); // Case-insensitive by default
+    options.matchCase = true;
+    r = 0; c = 0;
+    assert(doc.Search(L"^[a-z]-\\d+$", r, c, options) && r == 2 && c == 0);
+    r = 0; c = 0;
+    assert(doc.Search(L"\u00e8ve$", r, c, options) && r == 3 && c == 1);
+    r = 0; c = 0;
+    assert(doc.Search(L"d, c", r, c, options) && r == 4 && c == 1);
+    r = 0; c = 0;
+    assert(doc.Search(L"(\\w)\\1", r, c, options) && r == 3 && c == 0); // "300" via std::wregex
+    r = 0; c = 0;
+    assert(doc.Search(L"^[A-C]-\\d{1,12345}$", r, c, options) && r == 1 && c == 0);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestCaseFolding()
+{
+    std::cout << "Testing Case Folding..." << std::endl;
+    
+    // Simple case folding, one unit to one unit
+    assert(CaseFold::Fold(L'A') == L'a' && CaseFold::Fold(L'a') == L'a' && CaseFold::Fold(L'1') == L'1');
+    assert(CaseFold::Fold(L'\u00C9') == L'\u00E9');
+    assert(CaseFold::Fold(L'\u212A') == L'k'); // KELVIN SIGN
+    assert(CaseFold::Fold(L'\u017F') == L's'); // LONG S
+    assert(CaseFold::Fold(L'\u03A3') == L'\u03C3' && CaseFold::Fold(L'\u03C2') == L'\u03C3'); // Sigma, final sigma
+    assert(CaseFold::Fold(L'\u1E9E') == L'\u00DF'); // Capital sharp s (status S)
+    assert(CaseFold::Fold(L'\u0130') == L'\u0130'); // Dotted I folds only with full/Turkic folding
+    assert(CaseFold::Fold(L'\u0101') == L'\u0101' && CaseFold::Fold(L'\u0100') == L'\u0101');
+    assert(!CaseFold::HasVariants(L'1') && !CaseFold::HasVariants(L'\u4E2D'));
+    assert(CaseFold::HasVariants(L'a') && CaseFold::HasVariants(L'\u00E9') && CaseFold::HasVariants(L'k'));
+    assert(CaseFold::HasOnlyAsciiVariants(L'a') && CaseFold::HasOnlyAsciiVariants(L'1'));
+    assert(!CaseFold::HasOnlyAsciiVariants(L'k') && !CaseFold::HasOnlyAsciiVariants(L's'));
+    assert(!CaseFold::HasOnlyAsciiVariants(L'\u00E9'));
+    
+    // Block folding matches unit by unit, with and without non-ASCII units in a block
+    std::wstring mixed;
+    const wchar_t alphabet[] = L"AbZz@[`{09 \u00C0\u00DE\u0178\u0391\u03C2\u0410\u212A\uFF21";
+    for (int i = 0; i < 500; ++i) mixed += alphabet[(i * 7 + i / 13) % (sizeof(alphabet) / sizeof(wchar_t) - 1)];
+    mixed += std::wstring(40, L'Q');
+    std::wstring folded = CaseFold::Folded(mixed);
+    assert(folded.size() == mixed.size());
+    for (size_t i = 0; i < mixed.size(); ++i) assert(folded[i] == CaseFold::Fold(mixed[i]));
+    
+    // ASCII-caseless byte kernel against a plain scan
+    std::string hay;
+    for (int i = 0; i < 300; ++i) hay += "xX-aAbB{[@`"[(i * 5 + i / 7) % 11];
+    const uint8_t* data = (const uint8_t*)hay.data();
+    for (const char* needle : { "ab", "xa", "b{", "-a@", "aab", "xxx" }) {
+        size_t n = strlen(needle);
+        std::vector<uint8_t> mask(n);
+        for (size_t j = 0; j < n; ++j) mask[j] = (needle[j] >= 'a' && needle[j] <= 'z') ? 0x20 : 0;
+        size_t first = hay.size(), last = hay.size();
+        for (size_t i = 0; i + n <= hay.size(); ++i) {
+            bool match = true;
+            for (size_t j = 0; j < n; ++j) match = match && (char)tolower(hay[i + j]) == needle[j] && (hay[i + j] == needle[j] || mask[j]);
+            if (match) { if (first == hay.size()) first = i; last = i; }
+        }
+        assert(SimdScan::FindSubstring(data, hay.size(), (const uint8_t*)needle, n, mask.data()) == first);
+        assert(SimdScan::FindLastSubstring(data, hay.size(), (const uint8_t*)needle, n, mask.data()) == last);
+    }
+    
+    // Document search ignoring case: ASCII letters go through the byte-level scan, other cased text
+    // (and 'k', which KELVIN SIGN folds to) through the folded cells
+    std::string content = "id,word\n1,Kelvin\n2,\xE2\x84\xAA" "elvin\n3,\xC3\x89" "cole\n4,\xC3\xA9" "COLE\n"
+                          "5,Stra\xC3\x9F" "e\n6,STRASSE\n7,\xCF\x83\xCE\xB9\xCF\x82\n8,\xCE\xA3\xCE\x99\xCE\xA3\n9,Foo fOO\n";
+    CreateDummyFile(L"test_casefold.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_casefold.csv");
+    auto findAll = [&](const std::wstring& query, CsvDocument::SearchMode mode) {
+        CsvDocument::SearchOptions options;
+        options.mode = mode;
+        options.includeStart = true;
+        std::vector<size_t> rows;
+        size_t r = 0, c = 0;
+        while (doc.Search(query, r, c, options)) {
+            rows.push_back(r);
+            options.includeStart = false;
+        }
+        return rows;
+    };
+    typedef std::vector<size_t> Rows;
+    assert((findAll(L"KELVIN", CsvDocument::SearchMode::Contains) == Rows{ 1, 2 }));
+    assert((findAll(L"ELVIN", CsvDocument::SearchMode::Contains) == Rows{ 1, 2 }));
+    assert((findAll(L"\u00E9cole", CsvDocument::SearchMode::Contains) == Rows{ 3, 4 }));
+    assert((findAll(L"stra\u00DF", CsvDocument::SearchMode::Contains) == Rows{ 5 }));
+    assert((findAll(L"STRASSE", CsvDocument::SearchMode::Exact) == Rows{ 6 }));
+    assert((findAll(L"\u03C3\u03B9\u03C3", CsvDocument::SearchMode::Exact) == Rows{ 7, 8 }));
+    assert((findAll(L"OO F", CsvDocument::SearchMode::Contains) == Rows{ 9 }));
+    
+    // Caseless replace keeps the text around each occurrence
+    CsvDocument::SearchOptions options;
+    size_t r = 9, c = 1;
+    assert(doc.Replace(L"o", L"0", r, c, options));
+    assert(doc.GetRowCells(9)[1] == L"F00 f00");
+    r = 3; c = 1;
+    assert(doc.Replace(L"\u00C9COLE", L"school", r, c, options));
+    assert(doc.GetRowCells(3)[1] == L"school");
+    assert(doc.ReplaceAll(L"\u00C9cole", L"school", options) == 1);
+    assert(doc.GetRowCells(4)[1] == L"school");
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+// All (row, col, start) occurrences of an ASCII query, from the decoded cells
+std::vector<CsvDocument::Match> ReferenceMatches(CsvDocument& doc, const std::wstring& query, bool matchCase)
+{
+    auto fold = [&](std::wstring text) {
+        if (!matchCase) for (auto& ch : text) ch = towlower(ch);
+        return text;
+    };
+    std::wstring needle = fold(query);
+    std::vector<CsvDocument::Match> matches;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) {
+        auto cells = doc.GetRowCells(r);
+        for (size_t c = 0; c < cells.size(); ++c) {
+            std::wstring text = fold(cells[c]);
+            for (size_t pos = text.find(needle); pos != std::wstring::npos; pos = text.find(needle, pos + needle.size())) {
+                CsvDocument::Match match;
+                match.row = r;
+                match.col = c;
+                match.start = pos;
+                match.length = needle.size();
+                matches.push_back(match);
+            }
+        }
+    }
+    return matches;
+}
+
+bool SameMatches(const std::vector<CsvDocument::Match>& a, const std::vector<CsvDocument::Match>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].start != b[i].start || a[i].length != b[i].length) return false;
+    }
+    return true;
+}
+
+void TestFindAll()
+{
+    std::cout << "Testing Find All..." << std::endl;
+    
+    std::string content = "id,text,more\n";
+    for (int r = 1; r < 20000; ++r) {
+        std::string text = (r % 997 == 0) ? "aNeedle and needle" : (r % 1500 == 7) ? "NEEDLE" : "hay";
+        content += std::to_string(r) + "," + text + "," + (r % 4001 == 3 ? "\"needle, quoted\"" : "x") + "\n";
+    }
+    CreateDummyFile(L"test_find_all.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_find_all.csv");
+    
+    CsvDocument::SearchOptions options;
+    std::atomic<size_t> lastProgress(0);
+    std::atomic<int> completions(0);
+    std::atomic<bool> scanning(true);
+    assert(doc.StartFindAll(L"needle", options, [&](size_t count) {
+        assert(!scanning || count >= lastProgress.load()); // The scan only adds matches
+        lastProgress = count;
+    }, [&]() { completions++; }));
+    assert(doc.IsFindAllFor(L"needle", options));
+    doc.WaitForFindAll();
+    assert(doc.IsFindAllComplete() && completions == 1);
+    std::vector<CsvDocument::Match> expected = ReferenceMatches(doc, L"needle", false);
+    assert(doc.GetMatchCount() == expected.size() && lastProgress == expected.size());
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), expected));
+    assert(doc.GetMatches(997, 1).size() == 2 && doc.GetMatches(997, 1)[1].start == 12);
+    scanning = false;
+    
+    // Next and previous agree with the linear scan
+    for (bool forward : { true, false }) {
+        CsvDocument::SearchOptions searchOptions;
+        searchOptions.forward = forward;
+        for (size_t startRow : { (size_t)0, (size_t)996, (size_t)997, (size_t)4004, (size_t)19999 }) {
+            for (size_t startCol : { (size_t)0, (size_t)1, (size_t)2 }) {
+                size_t r = startRow, c = startCol, refR = startRow, refC = startCol;
+                bool found = doc.FindMatch(r, c, forward);
+                assert(found == doc.Search(L"needle", refR, refC, searchOptions));
+                if (found) assert(r == refR && c == refC);
+            }
+        }
+    }
+    
+    // Edits patch the list in place
+    doc.UpdateCell(5, 1, L"needle needle");
+    doc.DeleteRow(997);
+    std::vector<std::wstring> inserted = { L"x", L"needle" };
+    doc.InsertRow(10, inserted);
+    assert(doc.IsFindAllComplete());
+    expected = ReferenceMatches(doc, L"needle", false);
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), expected));
+    
+    // Edits while the scan runs, and changes that rebuild the index
+    assert(doc.StartFindAll(L"Needle", options));
+    doc.UpdateCell(15000, 2, L"late needle");
+    doc.UpdateCell(2, 2, L"early needle");
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"needle", false)));
+    doc.Undo();
+    doc.WaitForFindAll();
+    assert(doc.IsFindAllComplete());
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"needle", false)));
+    
+    // Case-sensitive and regex spans
+    options.matchCase = true;
+    assert(doc.StartFindAll(L"NEEDLE", options));
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"NEEDLE", true)));
+    options.mode = CsvDocument::SearchMode::Regex;
+    assert(!doc.StartFindAll(L"(", options));
+    assert(!doc.IsFindAllFor(L"NEEDLE", options) && doc.GetMatchCount() == 0);
+    doc.UpdateCell(1, 1, L"a12b345");
+    assert(doc.StartFindAll(L"\\d{2,}|^\\d$", options));
+    doc.WaitForFindAll();
+    auto spans = doc.GetMatches(1, 1);
+    assert(spans.size() == 3 && spans[0].col == 0 && spans[1].start == 1 && spans[1].length == 2 &&
+           spans[2].start == 4 && spans[2].length == 3);
+    
+    doc.StopFindAll();
+    assert(doc.GetMatchCount() == 0 && !doc.IsFindAllComplete());
+    size_t r = 0, c = 0;
+    assert(!doc.FindMatch(r, c, true));
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestSearchAsYouType()
+{
+    std::cout << "Testing search as you type..." << std::endl;
+    
+    std::string content = "id,text\n";
+    for (int r = 1; r < 30000; ++r) {
+        std::string text = (r % 7 == 0) ? "NEst" : (r % 11 == 0) ? "a needle, nearly" : (r % 13 == 0) ? "Needlework" : "none";
+        content += std::to_string(r) + "," + text + "\n";
+    }
+    CreateDummyFile(L"test_type_search.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_type_search.csv");
+    
+    // Each keystroke supersedes the scan before it; the last one settles on the full list
+    CsvDocument::SearchOptions options;
+    std::wstring typed;
+    for (wchar_t ch : std::wstring(L"needle")) {
+        typed += ch;
+        assert(doc.StartFindAll(typed, options));
+    }
+    doc.WaitForFindAll();
+    assert(doc.IsFindAllComplete());
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"needle", false)));
+    
+    // Refining a complete list, then a finished one
+    assert(doc.StartFindAll(L"ne", options));
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"ne", false)));
+    assert(doc.StartFindAll(L"nee", options));
+    doc.WaitForFindAll();
+    assert(doc.IsFindAllComplete());
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"nee", false)));
+    assert(doc.StartFindAll(L"needlew", options));
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"needlew", false)));
+    
+    // Edits while candidates are pending fall back to scanning
+    assert(doc.StartFindAll(L"n", options));
+    doc.WaitForFindAll();
+    assert(doc.StartFindAll(L"ne", options));
+    doc.UpdateCell(20000, 1, L"one needle");
+    doc.DeleteRow(14);
+    std::vector<std::wstring> inserted = { L"x", L"NEEDLE" };
+    doc.InsertRow(3, inserted);
+    assert(doc.StartFindAll(L"nee", options));
+    doc.UpdateCell(29000, 1, L"needless");
+    doc.WaitForFindAll();
+    assert(doc.IsFindAllComplete());
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"nee", false)));
+    
+    // Deleting a character, changing case sensitivity or the mode rescans
+    assert(doc.StartFindAll(L"ne", options));
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"ne", false)));
+    options.matchCase = true;
+    assert(doc.StartFindAll(L"Nee", options));
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"Nee", true)));
+    options.mode = CsvDocument::SearchMode::Exact;
+    assert(doc.StartFindAll(L"NEst", options));
+    doc.WaitForFindAll();
+    size_t exact = 0;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) exact += doc.GetRowCells(r)[1] == L"NEst";
+    assert(doc.GetMatchCount() == exact && exact > 4000);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+// Matches of each of 'patterns' (ASCII), from the decoded cells
+std::vector<std::vector<CsvDocument::Match>> ReferenceManyMatches(CsvDocument& doc, const std::vector<std::wstring>& patterns,
+                                                                  bool matchCase, bool exact)
+{
+    auto fold = [&](std::wstring text) {
+        if (!matchCase) for (auto& ch : text) ch = towlower(ch);
+        return text;
+    };
+    std::vector<std::vector<CsvDocument::Match>> hits(patterns.size());
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) {
+        auto cells = doc.GetRowCells(r);
+        for (size_t c = 0; c < cells.size(); ++c) {
+            std::wstring text = fold(cells[c]);
+            for (size_t p = 0; p < patterns.size(); ++p) {
+                std::wstring needle = fold(patterns[p]);
+                CsvDocument::Match match;
+                match.row = r;
+                match.col = c;
+                match.length = needle.size();
+                if (needle.empty()) continue;
+                if (exact) {
+                    if (text == needle) hits[p].push_back(match);
+                    continue;
+                }
+                for (size_t pos = text.find(needle); pos != std::wstring::npos; pos = text.find(needle, pos + needle.size())) {
+                    match.start = pos;
+                    hits[p].push_back(match);
+                }
+            }
+        }
+    }
+    return hits;
+}
+
+void TestSearchMany()
+{
+    std::cout << "Testing multi-pattern search..." << std::endl;
+    
+    // Automaton: overlapping patterns, and a text fed in two parts
+    auto bytes = [](const char* text) { return std::vector<uint8_t>(text, text + strlen(text)); };
+    AhoCorasick automaton;
+    automaton.Build({ bytes("he"), bytes("she"), bytes("his"), bytes("hers") });
+    std::vector<std::pair<size_t, uint32_t>> found;
+    auto onHit = [&](size_t end, uint32_t pattern) { found.emplace_back(end, pattern); };
+    uint32_t state = 0;
+    automaton.Scan((const uint8_t*)"ush", 3, state, onHit);
+    automaton.Scan((const uint8_t*)"ers his", 7, state, onHit);
+    assert((found == std::vector<std::pair<size_t, uint32_t>>{ { 1, 1 }, { 1, 0 }, { 3, 3 }, { 7, 2 } }));
+    uint8_t lower[256];
+    for (int b = 0; b < 256; ++b) lower[b] = (uint8_t)tolower(b);
+    automaton.Build({ bytes("ab") }, lower);
+    found.clear();
+    state = 0;
+    automaton.Scan((const uint8_t*)"xAbaB", 5, state, onHit);
+    assert(found.size() == 2 && found[0].first == 3 && found[1].first == 5);
+    
+    std::string content = "id,key,note\n";
+    for (int r = 1; r < 10000; ++r) {
+        int key = (r * 7919) % 100003;
+        std::string note = (r % 9 == 0) ? "see v" + std::to_string(key % 500) + " and V" + std::to_string(key % 500) : "\"x, y\"";
+        content += std::to_string(r) + ",V" + std::to_string(key) + "," + note + "\n";
+    }
+    CreateDummyFile(L"test_search_many.csv", content);
+    
+    // Keys that occur, keys that do not, prefixes of one another, a duplicate and an empty pattern
+    std::vector<std::wstring> patterns;
+    for (int i = 0; i < 300; ++i) patterns.push_back(L"v" + std::to_wstring((i * 7919 * 13) % 100003));
+    for (int i = 0; i < 20; ++i) patterns.push_back(L"v" + std::to_wstring(i));
+    patterns.push_back(L"V1");
+    patterns.push_back(L"V1");
+    patterns.push_back(L"");
+    patterns.push_back(L"and");
+    
+    for (bool wide : { false, true }) {
+        CsvDocument doc;
+        if (wide) {
+            CsvDocument utf8;
+            utf8.Load(L"test_search_many.csv");
+            std::wstring text;
+            for (size_t r = 0; r < utf8.GetRowCount(); ++r) {
+                std::vector<uint8_t> raw = utf8.GetRowRaw(r);
+                text += utf8.DecodeCell(std::string_view((const char*)raw.data(), raw.size())) + L"\n";
+            }
+            std::vector<uint8_t> bytes = { 0xFF, 0xFE };
+            TextCodec::AppendAsUtf16(text.data(), text.size(), false, bytes);
+            CreateDummyFile(L"test_search_many16.csv", std::string(bytes.begin(), bytes.end()));
+            doc.Load(L"test_search_many16.csv");
+        } else {
+            doc.Load(L"test_search_many.csv");
+        }
+        doc.UpdateCell(5000, 1, L"V12 edited v12"); // Hits in the add buffer too
+        
+        for (int mode = 0; mode < 4; ++mode) {
+            CsvDocument::SearchOptions options;
+            options.matchCase = (mode & 1) != 0;
+            options.mode = (mode & 2) ? CsvDocument::SearchMode::Exact : CsvDocument::SearchMode::Contains;
+            auto expected = ReferenceManyMatches(doc, patterns, options.matchCase, (mode & 2) != 0);
+            for (unsigned threads : { 1u, 4u }) {
+                doc.SetSearchThreadCount(threads);
+                std::vector<std::vector<CsvDocument::Match>> hits;
+                assert(doc.SearchMany(patterns, options, hits));
+                assert(hits.size() == patterns.size());
+                for (size_t p = 0; p < patterns.size(); ++p) assert(SameMatches(hits[p], expected[p]));
+            }
+        }
+    }
+    
+    // A pattern with a quote cannot be matched in the raw bytes: every cell is decoded instead
+    CsvDocument doc;
+    doc.Load(L"test_search_many.csv");
+    std::vector<std::wstring> quoted = { L"\"", L"v12", L"x, y" };
+    std::vector<std::vector<CsvDocument::Match>> hits;
+    CsvDocument::SearchOptions options;
+    assert(doc.SearchMany(quoted, options, hits));
+    auto expected = ReferenceManyMatches(doc, quoted, false, false);
+    assert(hits[0].empty() && !hits[1].empty());
+    for (size_t p = 0; p < quoted.size(); ++p) assert(SameMatches(hits[p], expected[p]));
+    
+    options.mode = CsvDocument::SearchMode::Regex;
+    assert(!doc.SearchMany(quoted, options, hits));
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestScopedSearch()
+{
+    std::cout << "Testing scoped search..." << std::endl;
+    
+    // 150 columns, so scopes past the field checkpoint interval resume from checkpoints
+    std::string content;
+    for (int r = 0; r < 9000; ++r) {
+        for (int c = 0; c < 150; ++c) {
+            if (c > 0) content += ",";
+            content += ((r * 31 + c * 17) % 97 == 0) ? "a Needle" : ((r + c) % 53 == 0) ? "\"needle, q\"" : "hay";
+        }
+        content += "\n";
+    }
+    CreateDummyFile(L"test_scoped_search.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_scoped_search.csv");
+    doc.SetSearchThreadCount(4);
+    
+    typedef std::vector<CsvDocument::CellRange> Scope;
+    auto range = [](size_t firstRow, size_t lastRow, size_t firstCol, size_t lastCol) {
+        CsvDocument::CellRange cells;
+        cells.firstRow = firstRow;
+        cells.lastRow = lastRow;
+        cells.firstCol = firstCol;
+        cells.lastCol = lastCol;
+        return cells;
+    };
+    std::vector<Scope> scopes = {
+        { range(0, SIZE_MAX, 3, 3) },                                // A column
+        { range(0, SIZE_MAX, 100, 101), range(0, SIZE_MAX, 7, 7) },  // Column set, past the checkpoints
+        { range(1000, 4999, 0, SIZE_MAX) },                          // Row range
+        { range(10, 20, 5, 60), range(8500, 8999, 140, 149) },       // Selections
+        { range(20000, 30000, 0, SIZE_MAX) },                        // Past the end
+    };
+    
+    for (const Scope& scope : scopes) {
+        auto inScope = [&](size_t r, size_t c) {
+            for (const auto& cells : scope) {
+                if (r >= cells.firstRow && r <= cells.lastRow && c >= cells.firstCol && c <= cells.lastCol) return true;
+            }
+            return false;
+        };
+        std::vector<CsvDocument::Match> expected;
+        for (const auto& match : ReferenceMatches(doc, L"needle", false)) {
+            if (inScope(match.row, match.col)) expected.push_back(match);
+        }
+        CsvDocument::SearchOptions options;
+        options.scope = scope;
+        
+        // Find All, and Search in both directions against it
+        assert(doc.StartFindAll(L"needle", options));
+        doc.WaitForFindAll();
+        assert(SameMatches(doc.GetMatches(0, SIZE_MAX), expected));
+        for (bool forward : { true, false }) {
+            options.forward = forward;
+            for (size_t startRow : { (size_t)0, (size_t)15, (size_t)3000, (size_t)8999 }) {
+                size_t r = startRow, c = 50, refR = startRow, refC = 50;
+                bool found = doc.Search(L"needle", r, c, options);
+                bool expectedFound = doc.FindMatch(refR, refC, forward);
+                assert(found == expectedFound);
+                if (found) assert(r == refR && c == refC);
+            }
+        }
+        
+        std::vector<std::vector<CsvDocument::Match>> hits;
+        assert(doc.SearchMany({ L"needle" }, options, hits));
+        assert(SameMatches(hits[0], expected));
+    }
+    doc.StopFindAll();
+    
+    // Replacing stays inside the scope
+    CsvDocument::SearchOptions options;
+    options.scope = scopes[0];
+    size_t inColumn = 0;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) inColumn += doc.GetRowCells(r)[3].find(L"eedle") != std::wstring::npos;
+    assert(doc.ReplaceAll(L"needle", L"pin", options) == (int)inColumn);
+    assert(ReferenceMatches(doc, L"pin", false).size() == inColumn);
+    size_t r = 0, c = 4;
+    assert(!doc.Replace(L"needle", L"pin", r, c, options));
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestBatchReplace()
+{
+    std::cout << "Testing batched Replace All..." << std::endl;
+    
+    std::string content = "id,text,more\r\n";
+    for (int r = 1; r < 30000; ++r) {
+        std::string text = (r % 3 == 0) ? "a Needle and needle" : (r % 7 == 0) ? "\"needle, quoted\"" : "hay";
+        content += std::to_string(r) + "," + text + "," + (r % 5 == 0 ? "needle" : "x") + "\r\n";
+    }
+    CreateDummyFile(L"test_batch_replace.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_batch_replace.csv");
+    doc.SetSearchThreadCount(4);
+    
+    std::vector<std::vector<std::wstring>> original;
+    for (size_t r = 0; r < doc.GetRowCount(); ++r) original.push_back(doc.GetRowCells(r));
+    auto replaced = [](std::wstring text, const std::wstring& with) {
+        std::wstring lower = text;
+        for (auto& ch : lower) ch = towlower(ch);
+        std::wstring result;
+        size_t last = 0;
+        for (size_t pos = lower.find(L"needle"); pos != std::wstring::npos; pos = lower.find(L"needle", last)) {
+            result += text.substr(last, pos - last) + with;
+            last = pos + 6;
+        }
+        return result + text.substr(last);
+    };
+    
+    // Cancelled part way: nothing changes
+    CsvDocument::SearchOptions options;
+    CancellationToken cancel;
+    int calls = 0;
+    assert(doc.ReplaceAll(L"needle", L"pin", options, [&](float) { if (++calls == 2) cancel.Cancel(); }, cancel) == 0);
+    assert(calls >= 2 && !doc.CanUndo());
+    assert(doc.GetRowCells(3) == original[3]);
+    
+    // A replacement that needs quoting; Find All follows the edit
+    assert(doc.StartFindAll(L"\"x\"", options));
+    float lastProgress = 0.0f;
+    size_t expectedCells = 0;
+    for (const auto& cells : original) {
+        for (const auto& cell : cells) expectedCells += replaced(cell, L"") != cell;
+    }
+    int count = doc.ReplaceAll(L"NEEDLE", L"pin, \"x\"", options, [&](float progress) {
+        assert(progress >= lastProgress);
+        lastProgress = progress;
+    });
+    assert(count == (int)expectedCells && lastProgress == 1.0f);
+    assert(doc.GetRowCount() == original.size());
+    for (size_t r = 0; r < original.size(); ++r) {
+        auto cells = doc.GetRowCells(r);
+        assert(cells.size() == original[r].size());
+        for (size_t c = 0; c < cells.size(); ++c) assert(cells[c] == replaced(original[r][c], L"pin, \"x\""));
+    }
+    doc.WaitForFindAll();
+    assert(SameMatches(doc.GetMatches(0, SIZE_MAX), ReferenceMatches(doc, L"\"x\"", false)));
+    doc.StopFindAll();
+    
+    // Later edits and row insertions still find their rows
+    doc.UpdateCell(29998, 2, L"last");
+    std::vector<std::wstring> row = { L"new", L"row" };
+    doc.InsertRow(15000, row);
+    assert(doc.GetRowCells(29999)[2] == L"last" && doc.GetRowCells(15000)[1] == L"row");
+    
+    // Two undo steps (the row insertion, then the whole Replace All) restore everything
+    doc.Undo();
+    doc.Undo();
+    assert(!doc.CanUndo());
+    for (size_t r = 0; r < original.size(); ++r) assert(doc.GetRowCells(r) == original[r]);
+    
+    // Regex with captures, inside a scope
+    options.mode = CsvDocument::SearchMode::Regex;
+    CsvDocument::CellRange column;
+    column.firstCol = column.lastCol = 0;
+    options.scope = { column };
+    assert(doc.ReplaceAll(L"^(\\d+)7$", L"<$1>", options) == 2999);
+    assert(doc.GetRowCells(17)[0] == L"<1>" && doc.GetRowCells(18)[0] == L"18");
+    assert(doc.GetRowCells(17)[2] == original[17][2]);
+    
+    std::cout << "  Passed." << std::endl;
+}
+
+void TestReplaceToFile()
+{
+    std::cout << "Testing Replace All into a new file..." << std::endl;
+    auto readFile = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+    
+    // Small writes fill the buffer, larger ones go past it
+    {
+        BufferedWriter writer(8);
+        assert(writer.Open(L"test_buffered_writer.bin"));
+        std::string expected;
+        for (size_t length : { 3, 5, 1, 20, 7, 8, 2 }) {
+            std::string part(length, (char)('a' + expected.size() % 26));
+            expected += part;
+            assert(writer.Write((const uint8_t*)part.data(), part.size()));
+        }
+        assert(writer.Close());
+        assert(readFile("test_buffered_writer.bin") == expected);
+    }
+    
+    // Large enough for several chunks; a BOM before row 0
+    std::string content = "\xEF\xBB\xBFid,text,more\r\n";
+    for (int r = 1; r < 250000; ++r) {
+        std::string text = (r % 3 == 0) ? "a Needle and needle" : (r % 7 == 0) ? "\"needle, quoted\"" : "hay";
+        content += std::to_string(r) + "," + text + "," + (r % 5 == 0 ? "needle" : "x") + "\r\n";
+    }
+    content += "last,needle,row"; // No line ending
+    CreateDummyFile(L"test_replace_to_file.csv", content);
+    CsvDocument doc;
+    doc.Load(L"test_replace_to_file.csv");
+    doc.SetSearchThreadCount(4);
+    doc.UpdateCell(10, 1, L"edited needle"); // Part of the stream comes from the add buffer
+    std::vector<std::wstring> row10 = doc.GetRowCells(10);
+    const size_t rowCount = doc.GetRowCount();
+    
+    // The same bytes as replacing in place and saving
+    CsvDocument::SearchOptions options;
+    float lastProgress = 0.0f;
+    int count = doc.ReplaceAllToFile(L"NEEDLE", L"pin, \"x\"", options, L"test_replace_to_file_out.csv", false, [&](float progress) {
+        assert(progress >= lastProgress);
+        lastProgress = progress;
+    });
+    assert(count > 0 && lastProgress == 1.0f);
+    assert(doc.GetRowCells(10) == row10);
+    CsvDocument inPlace;
+    inPlace.Load(L"test_replace_to_file.csv");
+    inPlace.UpdateCell(10, 1, L"edited needle");
+    assert(inPlace.ReplaceAll(L"NEEDLE", L"pin, \"x\"", options) == count);
+    inPlace.Save(L"test_replace_in_place.csv");
+    assert(readFile("test_replace_to_file_out.csv") == readFile("test_replace_in_place.csv"));
+    
+    // Cancelled: no file is left behind and the document is unchanged
+    CancellationToken cancel;
+    int calls = 0;
+    assert(doc.ReplaceAllToFile(L"needle", L"pin", options, L"test_replace_cancelled.csv", false,
+                                [&](float) { if (++calls == 1) cancel.Cancel(); }, cancel) == -1);
+    assert(!std::ifstream("test_replace_cancelled.csv").good());
+    assert(doc.GetRowCells(10) == row10);
+    
+    // Reopened: the document is now the new file
+    CsvDocument::CellRange column;
+    column.firstCol = column.lastCol = 2;
+    options.scope = { column };
+    count = doc.ReplaceAllToFile(L"needle", L"pin", options, L"test_replace_reopened.csv", true);
+    assert(count == 49999 && doc.GetRowCount() == rowCount);
+    assert(doc.GetRowCells(5)[2] == L"pin" && doc.GetRowCells(6)[1] == L"a Needle and needle");
+    assert(doc.GetRowCells(rowCount - 1)[1] == L"needle" && doc.GetRowCells(10)[1] == L"edited needle");
+    // The history belonged to the old file
+    assert(!doc.CanUndo());
+    std::vector<std::wstring> row0 = doc.GetRowCells(0);
+    doc.Undo();
+    assert(doc.GetRowCells(0) == row0 && doc.GetRowCells(10)[1] == L"edited needle");
+    
+    std::cout << "  Passed." << std::endl;
+}
+
 int main() {
     TestMemoryMapping(); 
     TestPieceTable();
@@ -826,6 +2507,31 @@ int main() {
     TestLocalization();
     TestExport();
     TestImport();
+    TestAsyncLoad();
+    TestHeadTailOpen();
+    TestSeekByFraction();
+    TestColumnStats();
+    TestRowView();
+    TestParsedRow();
+    TestRowCache();
+    TestPrefetch();
+    TestColumnRange();
+    TestFieldCheckpoints();
+    TestInPlaceCellUpdate();
+    TestTextCodec();
+    TestEncodingDetection();
+    TestUtf16FastPath();
+    TestDialects();
+    TestByteSearch();
+    TestParallelSearch();
+    TestRegexEngine();
+    TestCaseFolding();
+    TestFindAll();
+    TestSearchAsYouType();
+    TestSearchMany();
+    TestScopedSearch();
+    TestBatchReplace();
+    TestReplaceToFile();
     
     std::cout << "All Tests Passed!" << std::endl;
     return 0;